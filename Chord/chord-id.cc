@@ -0,0 +1,41 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/chord-id.h"
+
+#include <openssl/sha.h>
+#include <stdio.h>
+
+ChordId
+ChordId::Hash (const std::string &data)
+{
+  uint8_t digest[CHORD_ID_SIZE];
+  SHA1 ((const unsigned char*) data.c_str (), data.size (), digest);
+  return FromBytes (digest);
+}
+
+std::string
+ChordId::ToString () const
+{
+  uint8_t bytes[CHORD_ID_SIZE];
+  ToBytes (bytes);
+  char out[3 * CHORD_ID_SIZE + 1];
+  for (int i = 0; i < CHORD_ID_SIZE; i++)
+    {
+      snprintf (out + i * 3, 4, "%02x ", bytes[i]);
+    }
+  return std::string (out);
+}
@@ -0,0 +1,215 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CHORD_ID_H
+#define CHORD_ID_H
+
+#include <stdint.h>
+#include <string>
+#include <ostream>
+
+// Size of a ring identifier on the wire (SHA-1 digest)
+#define CHORD_ID_SIZE 20
+// Bits in a ring identifier, and so entries in the finger table
+#define CHORD_ID_BITS 160
+
+/**
+ * \brief Position on the 160-bit Chord ring.
+ *
+ * Held as big-endian 64/64/32-bit words so comparisons and modular
+ * arithmetic work a word at a time without branching. All arithmetic is
+ * modulo 2^160; everything except hashing is inline.
+ */
+class ChordId
+{
+  public:
+    ChordId ()
+      : m_high (0), m_middle (0), m_low (0)
+    {
+    }
+
+    ChordId (uint64_t high, uint64_t middle, uint32_t low)
+      : m_high (high), m_middle (middle), m_low (low)
+    {
+    }
+
+    /**
+     * \returns the SHA-1 digest of data as a ring position.
+     */
+    static ChordId Hash (const std::string &data);
+
+    /**
+     * \param bytes CHORD_ID_SIZE big-endian bytes.
+     */
+    static ChordId FromBytes (const uint8_t *bytes)
+    {
+      return ChordId (ReadWord64 (bytes), ReadWord64 (bytes + 8),
+                      (uint32_t) ReadWord64 (bytes + 12));
+    }
+
+    void ToBytes (uint8_t *bytes) const
+    {
+      WriteWord64 (bytes, m_high);
+      WriteWord64 (bytes + 8, m_middle);
+      for (int i = 0; i < 4; i++)
+        {
+          bytes[16 + i] = (uint8_t) (m_low >> (24 - 8 * i));
+        }
+    }
+
+    /**
+     * \returns 2^exponent, for exponent below 160.
+     */
+    static ChordId PowerOfTwo (uint32_t exponent)
+    {
+      uint64_t bit = (uint64_t) 1 << (exponent & 63);
+      // Select the word holding the bit without branching
+      uint64_t inLow = (exponent < 32);
+      uint64_t inMiddle = (exponent >= 32) & (exponent < 96);
+      uint64_t inHigh = (exponent >= 96);
+      return ChordId ((((uint64_t) 1 << ((exponent - 96) & 63)) & (0 - inHigh)),
+                      (((uint64_t) 1 << ((exponent - 32) & 63)) & (0 - inMiddle)),
+                      (uint32_t) (bit & (0 - inLow)));
+    }
+
+    /**
+     * \returns negative, zero or positive as this is below, equal to or
+     * above other as an unsigned integer.
+     */
+    int Compare (const ChordId &other) const
+    {
+      int high = (m_high > other.m_high) - (m_high < other.m_high);
+      int middle = (m_middle > other.m_middle) - (m_middle < other.m_middle);
+      int low = (m_low > other.m_low) - (m_low < other.m_low);
+      // The first nonzero word decides
+      return high + (high == 0) * (middle + (middle == 0) * low);
+    }
+
+    bool operator== (const ChordId &other) const
+    {
+      return ((m_high ^ other.m_high) | (m_middle ^ other.m_middle) | (m_low ^ other.m_low)) == 0;
+    }
+    bool operator!= (const ChordId &other) const { return !(*this == other); }
+    bool operator< (const ChordId &other) const { return Compare (other) < 0; }
+    bool operator<= (const ChordId &other) const { return Compare (other) <= 0; }
+    bool operator> (const ChordId &other) const { return Compare (other) > 0; }
+    bool operator>= (const ChordId &other) const { return Compare (other) >= 0; }
+
+    ChordId operator+ (const ChordId &other) const
+    {
+      uint64_t low = (uint64_t) m_low + other.m_low;
+      uint64_t middle = m_middle + other.m_middle;
+      uint64_t carryMiddle = (middle < m_middle);
+      uint64_t middleCarried = middle + (low >> 32);
+      carryMiddle += (middleCarried < middle);
+      return ChordId (m_high + other.m_high + carryMiddle, middleCarried, (uint32_t) low);
+    }
+
+    ChordId operator- (const ChordId &other) const
+    {
+      uint64_t borrowLow = (m_low < other.m_low);
+      uint64_t middle = m_middle - other.m_middle;
+      uint64_t borrowMiddle = (m_middle < other.m_middle) | (middle < borrowLow);
+      return ChordId (m_high - other.m_high - borrowMiddle, middle - borrowLow,
+                      m_low - other.m_low);
+    }
+
+    /**
+     * \returns the bitwise exclusive or, used to combine digests.
+     */
+    ChordId operator^ (const ChordId &other) const
+    {
+      return ChordId (m_high ^ other.m_high, m_middle ^ other.m_middle, m_low ^ other.m_low);
+    }
+
+    /**
+     * \returns this + 2^exponent, the start of finger exponent.
+     */
+    ChordId AddPowerOfTwo (uint32_t exponent) const
+    {
+      return *this + PowerOfTwo (exponent);
+    }
+
+    /**
+     * \returns the low 32 bits, a well spread hash since ids are digests.
+     */
+    uint32_t GetHash32 () const
+    {
+      return m_low;
+    }
+
+    /**
+     * \returns the clockwise distance from this to other.
+     */
+    ChordId Distance (const ChordId &other) const
+    {
+      return other - *this;
+    }
+
+    /**
+     * \returns true if this lies in (from, to), or (from, to] when
+     * rightClosed, going clockwise. (a, a] is the whole ring and (a, a)
+     * the ring without a.
+     */
+    bool InInterval (const ChordId &from, const ChordId &to, bool rightClosed) const
+    {
+      ChordId offset = from.Distance (*this);
+      ChordId span = from.Distance (to);
+      bool zeroOffset = (offset == ChordId ());
+      bool zeroSpan = (span == ChordId ());
+      int cmp = offset.Compare (span);
+      bool inside = (!zeroOffset) & ((cmp < 0) | (rightClosed & (cmp == 0)));
+      bool wholeRing = zeroSpan & (rightClosed | (!zeroOffset));
+      return inside | wholeRing;
+    }
+
+    /**
+     * \returns the digest as space separated hex bytes, as printed by
+     * RINGSTATE.
+     */
+    std::string ToString () const;
+
+  private:
+    static uint64_t ReadWord64 (const uint8_t *bytes)
+    {
+      uint64_t word = 0;
+      for (int i = 0; i < 8; i++)
+        {
+          word = (word << 8) | bytes[i];
+        }
+      return word;
+    }
+
+    static void WriteWord64 (uint8_t *bytes, uint64_t word)
+    {
+      for (int i = 0; i < 8; i++)
+        {
+          bytes[i] = (uint8_t) (word >> (56 - 8 * i));
+        }
+    }
+
+    uint64_t m_high;
+    uint64_t m_middle;
+    uint32_t m_low;
+};
+
+static inline std::ostream& operator<< (std::ostream& os, const ChordId& id)
+{
+  os << id.ToString ();
+  return os;
+}
+
+#endif
@@ -0,0 +1,163 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/chord-location-cache.h"
+
+ChordLocationCache::ChordLocationCache ()
+  : m_capacity (0)
+{
+}
+
+void
+ChordLocationCache::SetCapacity (uint32_t capacity)
+{
+  m_capacity = capacity;
+  while (m_entries.size () > m_capacity)
+    {
+      Evict ();
+    }
+}
+
+uint32_t
+ChordLocationCache::GetCapacity () const
+{
+  return m_capacity;
+}
+
+void
+ChordLocationCache::Insert (const ChordNodeDescriptor &predecessor, const ChordNodeDescriptor &owner)
+{
+  if (m_capacity == 0 || !predecessor.IsValid () || !owner.IsValid () || predecessor == owner)
+    {
+      return;
+    }
+  std::map<ChordId, Entry>::iterator iter = m_entries.find (owner.id);
+  if (iter != m_entries.end ())
+    {
+      // Keep the reference bit of an entry that is only being refreshed
+      iter->second.predecessor = predecessor;
+      iter->second.owner = owner;
+      return;
+    }
+  if (m_entries.size () >= m_capacity)
+    {
+      Evict ();
+    }
+  Entry entry;
+  entry.predecessor = predecessor;
+  entry.owner = owner;
+  entry.referenced = false;
+  m_entries.insert (std::make_pair (owner.id, entry));
+}
+
+bool
+ChordLocationCache::Lookup (const ChordId &key, Entry &entry)
+{
+  if (m_entries.empty ())
+    {
+      return false;
+    }
+  std::map<ChordId, Entry>::iterator iter = m_entries.lower_bound (key);
+  if (iter == m_entries.end ())
+    {
+      // Wrap around zero
+      iter = m_entries.begin ();
+    }
+  if (!key.InInterval (iter->second.predecessor.id, iter->second.owner.id, true))
+    {
+      return false;
+    }
+  iter->second.referenced = true;
+  entry = iter->second;
+  return true;
+}
+
+void
+ChordLocationCache::Invalidate (const ChordNodeDescriptor &node)
+{
+  std::map<ChordId, Entry>::iterator iter = m_entries.begin ();
+  while (iter != m_entries.end ())
+    {
+      const Entry &entry = iter->second;
+      if (entry.owner == node || entry.predecessor == node
+          || node.id.InInterval (entry.predecessor.id, entry.owner.id, false))
+        {
+          m_entries.erase (iter++);
+        }
+      else
+        {
+          iter++;
+        }
+    }
+}
+
+void
+ChordLocationCache::Erase (const ChordId &key)
+{
+  if (m_entries.empty ())
+    {
+      return;
+    }
+  std::map<ChordId, Entry>::iterator iter = m_entries.lower_bound (key);
+  if (iter == m_entries.end ())
+    {
+      iter = m_entries.begin ();
+    }
+  if (key.InInterval (iter->second.predecessor.id, iter->second.owner.id, true))
+    {
+      m_entries.erase (iter);
+    }
+}
+
+uint32_t
+ChordLocationCache::GetSize () const
+{
+  return m_entries.size ();
+}
+
+void
+ChordLocationCache::Clear ()
+{
+  m_entries.clear ();
+}
+
+void
+ChordLocationCache::Evict ()
+{
+  if (m_entries.empty ())
+    {
+      return;
+    }
+  // Every entry is passed at most twice: once to clear its bit, once to evict
+  std::map<ChordId, Entry>::iterator iter = m_entries.lower_bound (m_hand);
+  while (true)
+    {
+      if (iter == m_entries.end ())
+        {
+          iter = m_entries.begin ();
+        }
+      if (!iter->second.referenced)
+        {
+          break;
+        }
+      iter->second.referenced = false;
+      iter++;
+    }
+  std::map<ChordId, Entry>::iterator next = iter;
+  next++;
+  m_hand = (next == m_entries.end ()) ? m_entries.begin ()->first : next->first;
+  m_entries.erase (iter);
+}
@@ -0,0 +1,84 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CHORD_LOCATION_CACHE_H
+#define CHORD_LOCATION_CACHE_H
+
+#include "ns3/chord-id.h"
+#include "ns3/chord-node-descriptor.h"
+
+#include <map>
+
+using namespace ns3;
+
+/**
+ * \brief Bounded cache of ring ranges and the nodes owning them.
+ *
+ * An entry records that the keys in (predecessor, owner] belong to owner, as
+ * learned from lookup answers and successor lists. Hits are not trusted: a
+ * lookup asks the cached predecessor first, which either confirms the owner in
+ * one hop or shows the entry to be stale. Entries are replaced in CLOCK order.
+ */
+class ChordLocationCache
+{
+  public:
+    struct Entry
+      {
+        ChordNodeDescriptor predecessor;
+        ChordNodeDescriptor owner;
+        // CLOCK reference bit, set on every hit
+        bool referenced;
+      };
+
+    ChordLocationCache ();
+
+    /**
+     * \brief Sets the maximum number of entries; 0 disables the cache.
+     */
+    void SetCapacity (uint32_t capacity);
+    uint32_t GetCapacity () const;
+
+    /**
+     * \brief Records that owner follows predecessor on the ring.
+     */
+    void Insert (const ChordNodeDescriptor &predecessor, const ChordNodeDescriptor &owner);
+    /**
+     * \returns true and the entry whose range holds key, if there is one.
+     */
+    bool Lookup (const ChordId &key, Entry &entry);
+    /**
+     * \brief Drops entries naming node, and the entry whose range node joined.
+     */
+    void Invalidate (const ChordNodeDescriptor &node);
+    /**
+     * \brief Drops the entry whose range holds key.
+     */
+    void Erase (const ChordId &key);
+
+    uint32_t GetSize () const;
+    void Clear ();
+
+  private:
+    void Evict ();
+
+    // Keyed by owner id, so the first entry at or after a key covers it
+    std::map<ChordId, Entry> m_entries;
+    uint32_t m_capacity;
+    // Owner id the CLOCK hand points at
+    ChordId m_hand;
+};
+
+#endif
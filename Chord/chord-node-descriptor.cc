@@ -0,0 +1,38 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/chord-node-descriptor.h"
+
+void
+ChordNodeDescriptor::Serialize (Buffer::Iterator &start) const
+{
+  uint8_t bytes[CHORD_ID_SIZE];
+  id.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  start.WriteHtonU32 (address.Get ());
+  start.WriteHtonU16 (port);
+}
+
+void
+ChordNodeDescriptor::Deserialize (Buffer::Iterator &start)
+{
+  uint8_t bytes[CHORD_ID_SIZE];
+  start.Read (bytes, CHORD_ID_SIZE);
+  id = ChordId::FromBytes (bytes);
+  address = Ipv4Address (start.ReadNtohU32 ());
+  port = start.ReadNtohU16 ();
+  socketAddress = InetSocketAddress (address, port);
+}
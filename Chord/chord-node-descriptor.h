@@ -0,0 +1,85 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CHORD_NODE_DESCRIPTOR_H
+#define CHORD_NODE_DESCRIPTOR_H
+
+#include "ns3/chord-id.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/buffer.h"
+
+#include <ostream>
+
+using namespace ns3;
+
+// Ring id, IPv4 address and port
+#define CHORD_NODE_DESCRIPTOR_SIZE (CHORD_ID_SIZE + 4 + 2)
+
+/**
+ * \brief Everything needed to place a node on the ring and reach it.
+ *
+ * Messages carry descriptors in a fixed CHORD_NODE_DESCRIPTOR_SIZE byte
+ * layout, so a receiver uses them as is without hashing node ids or
+ * resolving addresses. The socket address is built once, when the
+ * descriptor is made or read, so sending to a node costs no lookups.
+ */
+struct ChordNodeDescriptor
+{
+  ChordNodeDescriptor ()
+    : address (Ipv4Address::GetAny ()), port (0), socketAddress (address, port)
+  {
+  }
+
+  ChordNodeDescriptor (const ChordId &nodeId, Ipv4Address nodeAddress, uint16_t nodePort)
+    : id (nodeId), address (nodeAddress), port (nodePort), socketAddress (nodeAddress, nodePort)
+  {
+  }
+
+  /**
+   * \returns false for the default descriptor, which names no node.
+   */
+  bool IsValid () const
+  {
+    return port != 0;
+  }
+
+  bool operator== (const ChordNodeDescriptor &other) const
+  {
+    return id == other.id && address == other.address && port == other.port;
+  }
+  bool operator!= (const ChordNodeDescriptor &other) const
+  {
+    return !(*this == other);
+  }
+
+  void Serialize (Buffer::Iterator &start) const;
+  void Deserialize (Buffer::Iterator &start);
+
+  ChordId id;
+  Ipv4Address address;
+  uint16_t port;
+  // address:port, kept in step with them
+  InetSocketAddress socketAddress;
+};
+
+static inline std::ostream& operator<< (std::ostream& os, const ChordNodeDescriptor& node)
+{
+  os << node.address << ":" << node.port;
+  return os;
+}
+
+#endif
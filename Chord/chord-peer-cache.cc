@@ -0,0 +1,71 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/chord-peer-cache.h"
+
+ChordPeerCache::ChordPeerCache ()
+{
+}
+
+void
+ChordPeerCache::SetResolveCallback (ResolveCallback resolveFn)
+{
+  m_resolveFn = resolveFn;
+}
+
+const ChordPeerCache::Peer&
+ChordPeerCache::Lookup (const std::string &nodeId)
+{
+  std::map<std::string, Peer>::iterator iter = m_peers.find (nodeId);
+  if (iter == m_peers.end ())
+    {
+      Peer peer;
+      peer.nodeId = nodeId;
+      peer.id = ChordId::Hash (nodeId);
+      peer.address = Ipv4Address::GetAny ();
+      iter = m_peers.insert (std::make_pair (nodeId, peer)).first;
+    }
+  // Failed resolutions are retried on every lookup until one succeeds
+  if (iter->second.address == Ipv4Address::GetAny () && !m_resolveFn.IsNull ())
+    {
+      iter->second.address = m_resolveFn (nodeId);
+    }
+  return iter->second;
+}
+
+const ChordId&
+ChordPeerCache::GetId (const std::string &nodeId)
+{
+  return Lookup (nodeId).id;
+}
+
+Ipv4Address
+ChordPeerCache::GetAddress (const std::string &nodeId)
+{
+  return Lookup (nodeId).address;
+}
+
+uint32_t
+ChordPeerCache::GetSize () const
+{
+  return m_peers.size ();
+}
+
+void
+ChordPeerCache::Clear ()
+{
+  m_peers.clear ();
+}
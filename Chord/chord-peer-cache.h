@@ -0,0 +1,74 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CHORD_PEER_CACHE_H
+#define CHORD_PEER_CACHE_H
+
+#include "ns3/chord-id.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/callback.h"
+#include "ns3/ptr.h"
+
+#include <map>
+#include <string>
+
+using namespace ns3;
+
+/**
+ * \brief Ring id and address of every peer a node has heard of.
+ *
+ * Entries are filled the first time a node id is looked up, so SHA-1 and
+ * address resolution run once per peer instead of once per message. An
+ * address that did not resolve is not kept: it is resolved again on the
+ * next lookup. One cache is shared by GUSearch and its GUChord.
+ */
+class ChordPeerCache : public SimpleRefCount<ChordPeerCache>
+{
+  public:
+    struct Peer
+      {
+        std::string nodeId;
+        ChordId id;
+        Ipv4Address address;
+      };
+
+    typedef Callback <Ipv4Address, std::string> ResolveCallback;
+
+    ChordPeerCache ();
+
+    /**
+     * \brief Sets how node ids missing from the cache are turned into
+     * addresses.
+     */
+    void SetResolveCallback (ResolveCallback resolveFn);
+
+    /**
+     * \returns the cached entry for nodeId, creating it on first use. The
+     * reference stays valid until Clear ().
+     */
+    const Peer& Lookup (const std::string &nodeId);
+    const ChordId& GetId (const std::string &nodeId);
+    Ipv4Address GetAddress (const std::string &nodeId);
+
+    uint32_t GetSize () const;
+    void Clear ();
+
+  private:
+    std::map<std::string, Peer> m_peers;
+    ResolveCallback m_resolveFn;
+};
+
+#endif
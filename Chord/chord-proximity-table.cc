@@ -0,0 +1,210 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/chord-proximity-table.h"
+
+ChordProximityTable::ChordProximityTable ()
+  : m_capacity (0)
+{
+}
+
+void
+ChordProximityTable::SetCapacity (uint32_t capacity)
+{
+  m_capacity = capacity;
+}
+
+void
+ChordProximityTable::AddNode (const ChordNodeDescriptor &node)
+{
+  if (!node.IsValid () || m_capacity == 0)
+    {
+      return;
+    }
+  std::map<ChordId, ChordNodeDescriptor>::iterator iter = m_nodes.find (node.id);
+  if (iter != m_nodes.end ())
+    {
+      if (iter->second == node)
+        {
+          return;
+        }
+      EraseNode (iter);
+    }
+  if (m_nodes.size () >= m_capacity)
+    {
+      // Drop an unmeasured node, or else the slowest one
+      std::map<ChordId, ChordNodeDescriptor>::iterator victim = m_nodes.end ();
+      int64_t slowest = -1;
+      for (iter = m_nodes.begin (); iter != m_nodes.end (); iter++)
+        {
+          int64_t rtt;
+          if (!GetRtt (iter->second.address, rtt))
+            {
+              victim = iter;
+              break;
+            }
+          if (rtt > slowest)
+            {
+              slowest = rtt;
+              victim = iter;
+            }
+        }
+      EraseNode (victim);
+    }
+  std::map<Ipv4Address, Host>::iterator host = m_hosts.find (node.address);
+  if (host == m_hosts.end ())
+    {
+      MakeRoomForHost ();
+      Host unmeasured = { 0, false, 0 };
+      host = m_hosts.insert (std::make_pair (node.address, unmeasured)).first;
+    }
+  host->second.nodes++;
+  m_nodes.insert (std::make_pair (node.id, node));
+}
+
+void
+ChordProximityTable::RemoveNode (const ChordNodeDescriptor &node)
+{
+  std::map<ChordId, ChordNodeDescriptor>::iterator iter = m_nodes.find (node.id);
+  if (iter != m_nodes.end ())
+    {
+      EraseNode (iter);
+    }
+}
+
+void
+ChordProximityTable::EraseNode (std::map<ChordId, ChordNodeDescriptor>::iterator iter)
+{
+  std::map<Ipv4Address, Host>::iterator host = m_hosts.find (iter->second.address);
+  m_nodes.erase (iter);
+  if (host != m_hosts.end () && --host->second.nodes == 0)
+    {
+      // The estimate expires with the last node at the address
+      m_hosts.erase (host);
+    }
+}
+
+bool
+ChordProximityTable::MakeRoomForHost ()
+{
+  if (m_hosts.size () < m_capacity)
+    {
+      return true;
+    }
+  for (std::map<Ipv4Address, Host>::iterator host = m_hosts.begin (); host != m_hosts.end (); host++)
+    {
+      if (host->second.nodes == 0)
+        {
+          m_hosts.erase (host);
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+ChordProximityTable::AddSample (Ipv4Address address, Time rtt)
+{
+  if (m_capacity == 0)
+    {
+      return;
+    }
+  int64_t sample = rtt.GetMicroSeconds ();
+  std::map<Ipv4Address, Host>::iterator host = m_hosts.find (address);
+  if (host == m_hosts.end ())
+    {
+      // Kept for a node that may be added later, if there is room
+      if (MakeRoomForHost ())
+        {
+          Host measured = { sample, true, 0 };
+          m_hosts.insert (std::make_pair (address, measured));
+        }
+      return;
+    }
+  if (!host->second.measured)
+    {
+      host->second.rtt = sample;
+      host->second.measured = true;
+      return;
+    }
+  host->second.rtt += (sample - host->second.rtt) / 8;
+}
+
+bool
+ChordProximityTable::GetRtt (Ipv4Address address, int64_t &rtt) const
+{
+  std::map<Ipv4Address, Host>::const_iterator host = m_hosts.find (address);
+  if (host == m_hosts.end () || !host->second.measured)
+    {
+      return false;
+    }
+  rtt = host->second.rtt;
+  return true;
+}
+
+bool
+ChordProximityTable::GetRtt (Ipv4Address address, Time &rtt) const
+{
+  int64_t microSeconds;
+  if (!GetRtt (address, microSeconds))
+    {
+      return false;
+    }
+  rtt = MicroSeconds (microSeconds);
+  return true;
+}
+
+ChordNodeDescriptor
+ChordProximityTable::SelectNearest (const ChordId &from, const ChordId &to,
+                                    const ChordNodeDescriptor &fallback) const
+{
+  ChordNodeDescriptor best = fallback;
+  int64_t bestRtt = 0;
+  bool measured = GetRtt (fallback.address, bestRtt);
+  std::map<ChordId, ChordNodeDescriptor>::const_iterator iter;
+  for (iter = m_nodes.begin (); iter != m_nodes.end (); iter++)
+    {
+      if (iter->first != from && !iter->first.InInterval (from, to, false))
+        {
+          continue;
+        }
+      int64_t rtt;
+      if (!GetRtt (iter->second.address, rtt))
+        {
+          continue;
+        }
+      if (!measured || rtt < bestRtt)
+        {
+          best = iter->second;
+          bestRtt = rtt;
+          measured = true;
+        }
+    }
+  return best;
+}
+
+uint32_t
+ChordProximityTable::GetSize () const
+{
+  return m_nodes.size ();
+}
+
+void
+ChordProximityTable::Clear ()
+{
+  m_nodes.clear ();
+  m_hosts.clear ();
+}
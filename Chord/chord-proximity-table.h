@@ -0,0 +1,95 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CHORD_PROXIMITY_TABLE_H
+#define CHORD_PROXIMITY_TABLE_H
+
+#include "ns3/chord-id.h"
+#include "ns3/chord-node-descriptor.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/nstime.h"
+
+#include <map>
+
+using namespace ns3;
+
+/**
+ * \brief Smoothed round trip times of peers, and the ring nodes a finger may
+ * be chosen from.
+ *
+ * Estimates follow RFC 6298 (gain 1/8) and are kept per address, shared by
+ * all virtual nodes of a host. Known nodes are bounded; when full, the node
+ * without an estimate or with the slowest one is dropped. An estimate goes
+ * with the last node at its address, and estimates of addresses without
+ * known nodes are bounded by the same capacity.
+ */
+class ChordProximityTable
+{
+  public:
+    ChordProximityTable ();
+
+    void SetCapacity (uint32_t capacity);
+
+    /**
+     * \brief Makes node a finger candidate.
+     */
+    void AddNode (const ChordNodeDescriptor &node);
+    /**
+     * \brief Forgets node, e.g. after it failed, and its estimate unless
+     * another known node shares its address.
+     */
+    void RemoveNode (const ChordNodeDescriptor &node);
+    /**
+     * \brief Folds a round trip time measured to address into its estimate.
+     */
+    void AddSample (Ipv4Address address, Time rtt);
+    /**
+     * \returns true and the smoothed round trip time of address if measured.
+     */
+    bool GetRtt (Ipv4Address address, Time &rtt) const;
+    /**
+     * \returns the known node with id in [from, to) and the lowest round trip
+     * time, or fallback if no measured node is faster than it.
+     */
+    ChordNodeDescriptor SelectNearest (const ChordId &from, const ChordId &to,
+                                       const ChordNodeDescriptor &fallback) const;
+
+    uint32_t GetSize () const;
+    void Clear ();
+
+  private:
+    struct Host
+      {
+        // Smoothed round trip time in microseconds
+        int64_t rtt;
+        bool measured;
+        // Known nodes at this address
+        uint32_t nodes;
+      };
+
+    void EraseNode (std::map<ChordId, ChordNodeDescriptor>::iterator iter);
+    /**
+     * \returns false if the table is full of addresses with known nodes.
+     */
+    bool MakeRoomForHost ();
+    bool GetRtt (Ipv4Address address, int64_t &rtt) const;
+
+    std::map<ChordId, ChordNodeDescriptor> m_nodes;
+    std::map<Ipv4Address, Host> m_hosts;
+    uint32_t m_capacity;
+};
+
+#endif
@@ -0,0 +1,198 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/chord-stats.h"
+
+#include <algorithm>
+
+ChordStats::ChordStats ()
+{
+  Clear ();
+}
+
+void
+ChordStats::RecordLookup (uint32_t hops, Time latency)
+{
+  uint64_t milliSeconds = latency.GetMilliSeconds ();
+  m_lookups++;
+  m_totalHops += hops;
+  m_totalLatency += milliSeconds;
+  m_hops[std::min<uint32_t> (hops, CHORD_STATS_BUCKETS - 1)]++;
+  m_latency[LogBucket (milliSeconds)]++;
+}
+
+void
+ChordStats::RecordLookupFailure ()
+{
+  m_failures++;
+}
+
+void
+ChordStats::RecordTimeout ()
+{
+  m_timeouts++;
+}
+
+void
+ChordStats::RecordForwarded ()
+{
+  // Move this node to the next load bucket as it crosses a power of two
+  m_load[LogBucket (m_forwarded)]--;
+  m_forwarded++;
+  m_load[LogBucket (m_forwarded)]++;
+  m_maxForwarded = std::max (m_maxForwarded, m_forwarded);
+}
+
+void
+ChordStats::RecordReceived ()
+{
+  m_received++;
+}
+
+void
+ChordStats::Merge (const ChordStats &other)
+{
+  m_nodes += other.m_nodes;
+  m_lookups += other.m_lookups;
+  m_failures += other.m_failures;
+  m_timeouts += other.m_timeouts;
+  m_received += other.m_received;
+  m_forwarded += other.m_forwarded;
+  m_maxForwarded = std::max (m_maxForwarded, other.m_maxForwarded);
+  m_totalHops += other.m_totalHops;
+  m_totalLatency += other.m_totalLatency;
+  for (uint32_t i = 0; i < CHORD_STATS_BUCKETS; i++)
+    {
+      m_hops[i] += other.m_hops[i];
+      m_latency[i] += other.m_latency[i];
+      m_load[i] += other.m_load[i];
+    }
+}
+
+void
+ChordStats::Clear ()
+{
+  m_nodes = 1;
+  m_lookups = 0;
+  m_failures = 0;
+  m_timeouts = 0;
+  m_received = 0;
+  m_forwarded = 0;
+  m_maxForwarded = 0;
+  m_totalHops = 0;
+  m_totalLatency = 0;
+  for (uint32_t i = 0; i < CHORD_STATS_BUCKETS; i++)
+    {
+      m_hops[i] = 0;
+      m_latency[i] = 0;
+      m_load[i] = 0;
+    }
+  // A node that forwarded nothing
+  m_load[0] = 1;
+}
+
+void
+ChordStats::Print (std::ostream &os) const
+{
+  os << "Nodes: " << m_nodes << " Lookups: " << m_lookups << " Failed: " << m_failures
+     << " Timeouts: " << m_timeouts << "\n";
+  if (m_lookups > 0)
+    {
+      os << "Mean hops: " << (double) m_totalHops / m_lookups
+         << " Mean latency: " << (double) m_totalLatency / m_lookups << " ms\n";
+    }
+  os << "Received: " << m_received << " Forwarded: " << m_forwarded
+     << " Max forwarded by a node: " << m_maxForwarded << "\n";
+  PrintHistogram (os, "Hops", m_hops, false);
+  PrintHistogram (os, "Latency (ms)", m_latency, true);
+  PrintHistogram (os, "Nodes by forwarded messages", m_load, true);
+}
+
+void
+ChordStats::PrintHistogram (std::ostream &os, const char *name, const uint32_t *buckets, bool logScale)
+{
+  os << name << ":";
+  for (uint32_t i = 0; i < CHORD_STATS_BUCKETS; i++)
+    {
+      if (buckets[i] == 0)
+        {
+          continue;
+        }
+      // Log buckets start at the lowest value they hold
+      uint64_t low = (logScale && i > 0) ? ((uint64_t) 1 << (i - 1)) : i;
+      os << " " << low << ((i == CHORD_STATS_BUCKETS - 1) ? "+" : "") << "=" << buckets[i];
+    }
+  os << "\n";
+}
+
+uint32_t
+ChordStats::LogBucket (uint64_t value)
+{
+  uint32_t bucket = 0;
+  while (value > 0 && bucket < CHORD_STATS_BUCKETS - 1)
+    {
+      value >>= 1;
+      bucket++;
+    }
+  return bucket;
+}
+
+uint32_t
+ChordStats::GetSerializedSize (void) const
+{
+  return 7 * sizeof (uint32_t) + 2 * sizeof (uint64_t) + 3 * CHORD_STATS_BUCKETS * sizeof (uint32_t);
+}
+
+void
+ChordStats::Serialize (Buffer::Iterator &start) const
+{
+  start.WriteHtonU32 (m_nodes);
+  start.WriteHtonU32 (m_lookups);
+  start.WriteHtonU32 (m_failures);
+  start.WriteHtonU32 (m_timeouts);
+  start.WriteHtonU32 (m_received);
+  start.WriteHtonU32 (m_forwarded);
+  start.WriteHtonU32 (m_maxForwarded);
+  start.WriteHtonU64 (m_totalHops);
+  start.WriteHtonU64 (m_totalLatency);
+  for (uint32_t i = 0; i < CHORD_STATS_BUCKETS; i++)
+    {
+      start.WriteHtonU32 (m_hops[i]);
+      start.WriteHtonU32 (m_latency[i]);
+      start.WriteHtonU32 (m_load[i]);
+    }
+}
+
+uint32_t
+ChordStats::Deserialize (Buffer::Iterator &start)
+{
+  m_nodes = start.ReadNtohU32 ();
+  m_lookups = start.ReadNtohU32 ();
+  m_failures = start.ReadNtohU32 ();
+  m_timeouts = start.ReadNtohU32 ();
+  m_received = start.ReadNtohU32 ();
+  m_forwarded = start.ReadNtohU32 ();
+  m_maxForwarded = start.ReadNtohU32 ();
+  m_totalHops = start.ReadNtohU64 ();
+  m_totalLatency = start.ReadNtohU64 ();
+  for (uint32_t i = 0; i < CHORD_STATS_BUCKETS; i++)
+    {
+      m_hops[i] = start.ReadNtohU32 ();
+      m_latency[i] = start.ReadNtohU32 ();
+      m_load[i] = start.ReadNtohU32 ();
+    }
+  return GetSerializedSize ();
+}
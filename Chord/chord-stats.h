@@ -0,0 +1,88 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CHORD_STATS_H
+#define CHORD_STATS_H
+
+#include "ns3/nstime.h"
+#include "ns3/buffer.h"
+
+#include <stdint.h>
+#include <ostream>
+
+using namespace ns3;
+
+// Buckets of each histogram; the last one also takes everything above it
+#define CHORD_STATS_BUCKETS 16
+
+/**
+ * \brief Lookup efficiency and message load of a set of Chord nodes.
+ *
+ * A node records its own lookups and load; sets are combined with Merge (),
+ * which is how network-wide figures are aggregated up the snapshot tree.
+ * Hop counts are bucketed linearly, latencies (in ms) and per-node
+ * forwarded messages by powers of two, so the wire size is fixed.
+ */
+class ChordStats
+{
+  public:
+    /**
+     * \brief Statistics of a single node that has seen nothing yet.
+     */
+    ChordStats ();
+
+    void RecordLookup (uint32_t hops, Time latency);
+    void RecordLookupFailure ();
+    void RecordTimeout ();
+    /**
+     * \brief Counts a message handled on behalf of another node's lookup.
+     */
+    void RecordForwarded ();
+    void RecordReceived ();
+
+    void Merge (const ChordStats &other);
+    void Clear ();
+    void Print (std::ostream &os) const;
+
+    uint32_t GetSerializedSize (void) const;
+    void Serialize (Buffer::Iterator &start) const;
+    uint32_t Deserialize (Buffer::Iterator &start);
+
+  private:
+    /**
+     * \returns 0 for 0, else 1 + floor (log2 (value)), capped at the last
+     * bucket.
+     */
+    static uint32_t LogBucket (uint64_t value);
+    static void PrintHistogram (std::ostream &os, const char *name, const uint32_t *buckets, bool logScale);
+
+    uint32_t m_nodes;
+    uint32_t m_lookups;
+    uint32_t m_failures;
+    uint32_t m_timeouts;
+    uint32_t m_received;
+    uint32_t m_forwarded;
+    // Highest forwarded count of a single node
+    uint32_t m_maxForwarded;
+    uint64_t m_totalHops;
+    uint64_t m_totalLatency;
+    uint32_t m_hops[CHORD_STATS_BUCKETS];
+    uint32_t m_latency[CHORD_STATS_BUCKETS];
+    // Nodes by forwarded messages
+    uint32_t m_load[CHORD_STATS_BUCKETS];
+};
+
+#endif
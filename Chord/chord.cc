@@ -1,128 +1,218 @@
-#include "chord.h"
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/chord.h"
 
-using namespace ns3;
-using namespace std;
+#include <algorithm>
+#include <iterator>
 
-chord_node::chord_node(){
-	prev = NULL;
-	next = NULL;
-	key_id = 0;
-	node_id = 0;
-	is_root = false;
+ChordRing::ChordRing ()
+{
 }
 
-chord_node::chord_node(Ipv4Address ipadd, int key){
-	prev = NULL;
-	next = NULL;
-	int iphash = 0;
-	int keyhash= 0;
-	key_id = keyhash;
-	node_id = iphash;
-	is_root = false;
+bool
+ChordRing::Insert (const ChordId &id)
+{
+  std::vector<ChordId>::iterator iter = std::lower_bound (m_ids.begin (), m_ids.end (), id);
+  if (iter != m_ids.end () && *iter == id)
+    {
+      return false;
+    }
+  m_ids.insert (iter, id);
+  return true;
 }
-/*
-chord::chord(Ipv4Address ipadd, int key){
-	chord_node *main = new chord_node(ipadd,key);
-	//hash ipadd and hash key
-	lmnode = main;
+
+void
+ChordRing::Insert (const std::vector<ChordId> &ids)
+{
+  std::vector<ChordId> batch (ids);
+  std::sort (batch.begin (), batch.end ());
+  std::vector<ChordId> merged;
+  merged.reserve (m_ids.size () + batch.size ());
+  std::merge (m_ids.begin (), m_ids.end (), batch.begin (), batch.end (), std::back_inserter (merged));
+  merged.erase (std::unique (merged.begin (), merged.end ()), merged.end ());
+  m_ids.swap (merged);
 }
-*/
-/*
-chord_node chord::find_node(int id){
-	//find chord with node_id id
-	return new chord_node();
-}
-*/
-void chord_node::join(chord_node *node){
-	chord_node *current = this;
-	chord_node *main = node;
-	if(current->next == NULL)
-	{
-		current->next = main;
-		current->prev = main;
-		main->next = current;
-		main->prev = current;
-
-		// if node added is smaller than the 
-	}
-	else
-	{
-		while(current->node_id < node->node_id)
-		{
-			current = current->next;
-		}
-
-		main->next = current;
-		main->prev = current->prev;
-		current->prev = main;
-	}
+
+bool
+ChordRing::Erase (const ChordId &id)
+{
+  std::vector<ChordId>::iterator iter = std::lower_bound (m_ids.begin (), m_ids.end (), id);
+  if (iter == m_ids.end () || *iter != id)
+    {
+      return false;
+    }
+  m_ids.erase (iter);
+  return true;
 }
-/*
-void chord::join(chord_node* node){
-	chord_node * current = lmnode;
-	chord_node *main = node;
-	if(current->next == NULL)
-	{
-		current->next = main;
-		current->prev = main;
-		main->next = current;
-		main->prev = current;
-
-		// if node added is smaller than the 
-	}
-	else
-	{
-		while(current->node_id < node->node_id)
-		{
-			current = current->next;
-		}
-
-		main->next = current;
-		main->prev = current->prev;
-		current->prev = main;
-	}
-}
-*/
-void chord_node::leave_chord(){
-	chord_node *current = this;
-	current->prev->next = current->next;
-	current->next->prev = current->prev;
+
+void
+ChordRing::Erase (const std::vector<ChordId> &ids)
+{
+  std::vector<ChordId> batch (ids);
+  std::sort (batch.begin (), batch.end ());
+  // Compact the survivors in place in one pass over both arrays
+  uint32_t kept = 0;
+  uint32_t next = 0;
+  for (uint32_t i = 0; i < m_ids.size (); i++)
+    {
+      while (next < batch.size () && batch[next] < m_ids[i])
+        {
+          next++;
+        }
+      if (next < batch.size () && batch[next] == m_ids[i])
+        {
+          continue;
+        }
+      m_ids[kept++] = m_ids[i];
+    }
+  m_ids.resize (kept);
 }
-/*
-void chord::leave_chord(int id){
-	chord_node *current = lmnode;
-	while(current->node_id != id)
-	{
-		current = current->next;
-	}
-	if(current->node_id == id){
-		current->prev->next = current->next;
-		current->next->prev = current->prev;
-	} else{
-		cout << "FAIL" << endl;
-	}
-}
-*/
-void chord_node::stabilize(){
-	chord_node *current = this;
-	chord_node *tmp = current->next->prev;
-	if(tmp->node_id > current->node_id){
-		current->next = tmp;
-	}
-	tmp->notify(current);
+
+bool
+ChordRing::Contains (const ChordId &id) const
+{
+  return std::binary_search (m_ids.begin (), m_ids.end (), id);
+}
+
+uint32_t
+ChordRing::FindSuccessor (const ChordId &key) const
+{
+  uint32_t index = std::lower_bound (m_ids.begin (), m_ids.end (), key) - m_ids.begin ();
+  // Keys past the last member wrap around to the first
+  return index == m_ids.size () ? 0 : index;
+}
+
+void
+ChordRing::FindSuccessors (const std::vector<ChordId> &keys, std::vector<uint32_t> &owners) const
+{
+  owners.resize (keys.size ());
+  std::vector<ChordId>::const_iterator low = m_ids.begin ();
+  for (uint32_t i = 0; i < keys.size (); i++)
+    {
+      // Ascending keys only search what is left of the array
+      if (i > 0 && keys[i] < keys[i - 1])
+        {
+          low = m_ids.begin ();
+        }
+      low = std::lower_bound (low, m_ids.end (), keys[i]);
+      owners[i] = (low == m_ids.end ()) ? 0 : low - m_ids.begin ();
+    }
+}
+
+const ChordId&
+ChordRing::Successor (const ChordId &key) const
+{
+  return m_ids[FindSuccessor (key)];
+}
+
+const ChordId&
+ChordRing::Predecessor (const ChordId &id) const
+{
+  uint32_t index = std::lower_bound (m_ids.begin (), m_ids.end (), id) - m_ids.begin ();
+  return m_ids[(index == 0 ? m_ids.size () : index) - 1];
+}
+
+const ChordId&
+ChordRing::GetId (uint32_t index) const
+{
+  return m_ids[index];
+}
+
+uint32_t
+ChordRing::GetSize () const
+{
+  return m_ids.size ();
+}
+
+void
+ChordRing::Clear ()
+{
+  m_ids.clear ();
+}
+
+uint32_t
+ChordRing::CheckNode (const ChordId &self, const ChordId &pred, const ChordId &suc,
+                      const std::vector<ChordId> &successors, std::ostream &report) const
+{
+  if (!Contains (self))
+    {
+      report << self << ": not a member of the ring\n";
+      return 1;
+    }
+  uint32_t errors = 0;
+  uint32_t index = FindSuccessor (self);
+  const ChordId &expectedPred = Predecessor (self);
+  if (pred != expectedPred)
+    {
+      report << self << ": predecessor " << pred << ", expected " << expectedPred << "\n";
+      errors++;
+    }
+  const ChordId &expectedSuc = m_ids[(index + 1) % m_ids.size ()];
+  if (suc != expectedSuc)
+    {
+      report << self << ": successor " << suc << ", expected " << expectedSuc << "\n";
+      errors++;
+    }
+  for (uint32_t i = 0; i < successors.size () && i + 1 < m_ids.size (); i++)
+    {
+      const ChordId &expected = m_ids[(index + 1 + i) % m_ids.size ()];
+      if (successors[i] != expected)
+        {
+          report << self << ": successor list entry " << i << " " << successors[i] << ", expected " << expected << "\n";
+          errors++;
+        }
+    }
+  return errors;
+}
+
+bool
+ChordRing::CheckFinger (const ChordId &self, uint32_t index, const ChordId &finger) const
+{
+  if (!Contains (finger))
+    {
+      return false;
+    }
+  ChordId start = self.AddPowerOfTwo (index);
+  if (finger == Successor (start))
+    {
+      return true;
+    }
+  // (start - 1, end - 1] is [start, end); the last finger ends at self
+  ChordId one (0, 0, 1);
+  ChordId end = (index + 1 < CHORD_ID_BITS) ? self.AddPowerOfTwo (index + 1) : self;
+  return finger.InInterval (start - one, end - one, true);
+}
+
+void
+ChordRing::GenerateKeys (uint32_t count, uint64_t seed, std::vector<ChordId> &keys)
+{
+  // xorshift64*, whose state must not be zero
+  uint64_t state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+  keys.reserve (keys.size () + count);
+  for (uint32_t i = 0; i < count; i++)
+    {
+      uint64_t words[3];
+      for (uint32_t j = 0; j < 3; j++)
+        {
+          state ^= state >> 12;
+          state ^= state << 25;
+          state ^= state >> 27;
+          words[j] = state * 0x2545F4914F6CDD1DULL;
+        }
+      keys.push_back (ChordId (words[0], words[1], (uint32_t) (words[2] >> 32)));
+    }
 }
-/*
-void chord::stabilize(){
-	chord_node *current = lmnode;
-	chord_node *tmp = current->next->prev;
-	if(tmp->node_id > current->node_id){
-		current->next = tmp;
-	}
-	tmp->notify(current);
-}
-*/
-void chord_node::notify(chord_node* node){
-	if(node->prev == NULL || this->prev->node_id > node->node_id){
-		this->prev = node;
-	}
-}
\ No newline at end of file
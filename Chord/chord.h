@@ -1,42 +1,98 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
 #ifndef CHORD_H
 #define CHORD_H
 
+#include "ns3/chord-id.h"
 
-#include "ns3/ipv4-address.h"
-
-using namespace ns3;
-class chord_node{
-public:
-	chord_node *next;
-	chord_node *prev;
-	int key_id;
-	int node_id;
-	chord_node();
-	chord_node(Ipv4Address, int);
-	~chord_node();
-	chord_node(int);
-	void notify(chord_node *);
-	void join(chord_node*); //node_id (hashed ip address)
-	void stabilize();
-	void leave_chord(); // node_id (hashed ip address)
-	void chord_debug();
-	bool is_root;
+#include <stdint.h>
+#include <vector>
+#include <ostream>
 
-};
+/**
+ * \brief Ground truth of a Chord ring, independent of the simulator.
+ *
+ * Member ids are kept in one sorted contiguous array, so the successor of a
+ * key is a binary search and the predecessor and successor list of a member
+ * are its neighbours in the array. Batches of ids are inserted and erased
+ * with a single merge pass. The ring is used to check the pointers GUChord
+ * nodes have converged to, and to produce lookup workloads with their
+ * expected owners for benchmarks.
+ */
+class ChordRing
+{
+  public:
+    ChordRing ();
 
+    /**
+     * \returns false if id is already a member.
+     */
+    bool Insert (const ChordId &id);
+    void Insert (const std::vector<ChordId> &ids);
+    /**
+     * \returns false if id is not a member.
+     */
+    bool Erase (const ChordId &id);
+    void Erase (const std::vector<ChordId> &ids);
+    bool Contains (const ChordId &id) const;
 
-class chord{
-public:
-	chord_node *lmnode;
-	chord();
-	chord(Ipv4Address, int);
-	~chord();
-	void join(chord_node*); //node_id (hashed ip address)
-	void stabilize();
-	void leave_chord(int); // node_id (hashed ip address)
-	void chord_debug();
-	//chord_node find_node(int);
-};
+    /**
+     * \returns the index of the first member at or after key, going
+     * clockwise. The ring must not be empty.
+     */
+    uint32_t FindSuccessor (const ChordId &key) const;
+    /**
+     * \brief Finds the owner of each key; faster than one FindSuccessor
+     * per key when keys are sorted.
+     */
+    void FindSuccessors (const std::vector<ChordId> &keys, std::vector<uint32_t> &owners) const;
+    const ChordId& Successor (const ChordId &key) const;
+    /**
+     * \returns the member preceding id, which need not be a member.
+     */
+    const ChordId& Predecessor (const ChordId &id) const;
+
+    const ChordId& GetId (uint32_t index) const;
+    uint32_t GetSize () const;
+    void Clear ();
 
+    /**
+     * \brief Compares the pointers of member self with the ring and writes
+     * one line to report for each one that is wrong.
+     * \param successors Successor list, nearest first; shorter lists are
+     * only checked as far as they go.
+     * \returns the number of wrong pointers.
+     */
+    uint32_t CheckNode (const ChordId &self, const ChordId &pred, const ChordId &suc,
+                        const std::vector<ChordId> &successors, std::ostream &report) const;
+    /**
+     * \returns true if finger may be finger index of self: the successor of
+     * self + 2^index, or any member in [self + 2^index, self + 2^(index+1)).
+     */
+    bool CheckFinger (const ChordId &self, uint32_t index, const ChordId &finger) const;
+
+    /**
+     * \brief Appends count keys drawn uniformly from the ring by a
+     * xorshift generator, the same keys for the same seed.
+     */
+    static void GenerateKeys (uint32_t count, uint64_t seed, std::vector<ChordId> &keys);
+
+  private:
+    std::vector<ChordId> m_ids;
+};
 
-#endif
\ No newline at end of file
+#endif
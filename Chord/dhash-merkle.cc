@@ -0,0 +1,86 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/dhash-merkle.h"
+
+DHashMerkle::DHashMerkle (const DHashStore &store, const ChordId &from, const ChordId &to)
+  : m_store (store),
+    m_from (from),
+    m_to (to)
+{
+}
+
+void
+DHashMerkle::GetChildren (const ChordId &prefix, uint8_t depth, std::vector<ChordId> &digests,
+                          std::vector<uint32_t> &counts) const
+{
+  digests.resize (DHASH_MERKLE_FANOUT);
+  counts.resize (DHASH_MERKLE_FANOUT);
+  for (uint32_t i = 0; i < DHASH_MERKLE_FANOUT; i++)
+    {
+      m_store.GetDigest (m_from, m_to, GetChildPrefix (prefix, depth, i), depth + 1, digests[i], counts[i]);
+    }
+}
+
+std::vector<ChordId>
+DHashMerkle::GetKeys (const ChordId &prefix, uint8_t depth) const
+{
+  std::vector<ChordId> keys;
+  m_store.GetKeys (m_from, m_to, prefix, depth, keys);
+  return keys;
+}
+
+ChordId
+DHashMerkle::GetChildPrefix (const ChordId &prefix, uint8_t depth, uint32_t child)
+{
+  uint8_t bytes[CHORD_ID_SIZE];
+  prefix.ToBytes (bytes);
+  if (depth % 2 == 0)
+    {
+      bytes[depth / 2] = (bytes[depth / 2] & 0x0F) | (child << 4);
+    }
+  else
+    {
+      bytes[depth / 2] = (bytes[depth / 2] & 0xF0) | child;
+    }
+  return ChordId::FromBytes (bytes);
+}
+
+bool
+DHashMerkle::HasPrefix (const ChordId &key, const ChordId &prefix, uint8_t depth)
+{
+  uint8_t keyBytes[CHORD_ID_SIZE];
+  uint8_t prefixBytes[CHORD_ID_SIZE];
+  key.ToBytes (keyBytes);
+  prefix.ToBytes (prefixBytes);
+  for (uint8_t i = 0; i < depth / 2; i++)
+    {
+      if (keyBytes[i] != prefixBytes[i])
+        {
+          return false;
+        }
+    }
+  // An odd depth ends in the high digit of the next byte
+  return depth % 2 == 0 || (keyBytes[depth / 2] >> 4) == (prefixBytes[depth / 2] >> 4);
+}
+
+uint32_t
+DHashMerkle::GetDigit (const ChordId &key, uint8_t index)
+{
+  uint8_t bytes[CHORD_ID_SIZE];
+  key.ToBytes (bytes);
+  return (index % 2 == 0) ? (bytes[index / 2] >> 4) : (bytes[index / 2] & 0x0F);
+}
@@ -0,0 +1,69 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DHASH_MERKLE_H
+#define DHASH_MERKLE_H
+
+#include "ns3/chord-id.h"
+#include "ns3/dhash-store.h"
+
+#include <vector>
+
+// Children of a tree node, one per hex digit of the key
+#define DHASH_MERKLE_FANOUT 16
+// Hex digits in a key, the depth of the leaves
+#define DHASH_MERKLE_DEPTH (2 * CHORD_ID_SIZE)
+// Items below a node that are sent as is instead of descending further
+#define DHASH_SYNC_ITEMS 8
+
+/**
+ * \brief Merkle tree over the items a store holds in a key range.
+ *
+ * A tree node is named by the leading depth hex digits of its keys (prefix).
+ * Its digest is the XOR of the digests of the items below it, so two stores
+ * holding the same items agree on every node, and a replica only descends
+ * into the children whose digests differ. The tree is a view of the store,
+ * which keeps the digests of the upper levels as items come and go.
+ */
+class DHashMerkle
+{
+  public:
+    DHashMerkle (const DHashStore &store, const ChordId &from, const ChordId &to);
+
+    /**
+     * \brief Computes the digest and item count of each child of a node.
+     */
+    void GetChildren (const ChordId &prefix, uint8_t depth, std::vector<ChordId> &digests,
+                      std::vector<uint32_t> &counts) const;
+    /**
+     * \returns the keys below a node.
+     */
+    std::vector<ChordId> GetKeys (const ChordId &prefix, uint8_t depth) const;
+
+    static ChordId GetChildPrefix (const ChordId &prefix, uint8_t depth, uint32_t child);
+    static bool HasPrefix (const ChordId &key, const ChordId &prefix, uint8_t depth);
+    /**
+     * \returns hex digit index of key, most significant first.
+     */
+    static uint32_t GetDigit (const ChordId &key, uint8_t index);
+
+  private:
+    const DHashStore &m_store;
+    ChordId m_from;
+    ChordId m_to;
+};
+
+#endif
@@ -0,0 +1,340 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/dhash-store.h"
+
+#define STORE_NOT_FOUND 0xFFFFFFFF
+#define STORE_INITIAL_SIZE 64
+// Arena garbage tolerated before compacting, however little is live
+#define STORE_MIN_GARBAGE 4096
+
+DHashStore::DHashStore ()
+  : m_mask (STORE_INITIAL_SIZE - 1),
+    m_size (0),
+    m_liveBytes (0)
+{
+  m_slots.resize (STORE_INITIAL_SIZE);
+  for (uint32_t i = 0; i < m_slots.size (); i++)
+    {
+      m_slots[i].used = false;
+    }
+}
+
+void
+DHashStore::Put (const ChordId &key, const uint8_t *data, uint32_t size)
+{
+  uint32_t pos = Find (key);
+  if (pos != STORE_NOT_FOUND)
+    {
+      // The old value becomes garbage
+      m_liveBytes -= m_slots[pos].size;
+      UpdateDigests (key, m_slots[pos].digest, false);
+    }
+  else
+    {
+      // Keep the load factor at or below one half
+      if (2 * (m_size + 1) > m_mask + 1)
+        {
+          Grow ();
+        }
+      pos = key.GetHash32 () & m_mask;
+      while (m_slots[pos].used)
+        {
+          pos = (pos + 1) & m_mask;
+        }
+      m_slots[pos].key = key;
+      m_slots[pos].used = true;
+      m_size++;
+      m_keys.insert (key);
+    }
+  uint8_t keyBytes[CHORD_ID_SIZE];
+  key.ToBytes (keyBytes);
+  std::string item ((const char *) keyBytes, CHORD_ID_SIZE);
+  item.append ((const char *) data, size);
+  m_slots[pos].digest = ChordId::Hash (item);
+  UpdateDigests (key, m_slots[pos].digest, true);
+  m_slots[pos].offset = m_arena.size ();
+  m_slots[pos].size = size;
+  m_arena.insert (m_arena.end (), data, data + size);
+  m_liveBytes += size;
+  if (m_arena.size () - m_liveBytes > STORE_MIN_GARBAGE && m_arena.size () - m_liveBytes > m_liveBytes)
+    {
+      Compact ();
+    }
+}
+
+void
+DHashStore::Put (const ChordId &key, const std::string &value)
+{
+  Put (key, (const uint8_t *) value.data (), value.size ());
+}
+
+bool
+DHashStore::Get (const ChordId &key, Value &value) const
+{
+  uint32_t pos = Find (key);
+  if (pos == STORE_NOT_FOUND)
+    {
+      return false;
+    }
+  value.data = m_arena.empty () ? 0 : &m_arena[0] + m_slots[pos].offset;
+  value.size = m_slots[pos].size;
+  return true;
+}
+
+bool
+DHashStore::Contains (const ChordId &key) const
+{
+  return Find (key) != STORE_NOT_FOUND;
+}
+
+bool
+DHashStore::Remove (const ChordId &key)
+{
+  uint32_t pos = Find (key);
+  if (pos == STORE_NOT_FOUND)
+    {
+      return false;
+    }
+  m_liveBytes -= m_slots[pos].size;
+  m_size--;
+  UpdateDigests (key, m_slots[pos].digest, false);
+  m_keys.erase (key);
+  // Backward-shift deletion keeps probe chains intact without tombstones
+  uint32_t hole = pos;
+  uint32_t next = pos;
+  while (true)
+    {
+      next = (next + 1) & m_mask;
+      if (!m_slots[next].used)
+        {
+          break;
+        }
+      uint32_t home = m_slots[next].key.GetHash32 () & m_mask;
+      // Move the entry back unless its home lies cyclically in (hole, next]
+      bool inRange = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+      if (!inRange)
+        {
+          m_slots[hole] = m_slots[next];
+          hole = next;
+        }
+    }
+  m_slots[hole].used = false;
+  if (m_size == 0)
+    {
+      m_arena.clear ();
+    }
+  return true;
+}
+
+void
+DHashStore::GetItems (const ChordId &from, const ChordId &to, std::vector<Item> &items) const
+{
+  for (uint32_t i = 0; i < m_slots.size (); i++)
+    {
+      if (m_slots[i].used && m_slots[i].key.InInterval (from, to, true))
+        {
+          Item item;
+          item.key = m_slots[i].key;
+          item.digest = m_slots[i].digest;
+          items.push_back (item);
+        }
+    }
+}
+
+void
+DHashStore::GetDigest (const ChordId &from, const ChordId &to, const ChordId &prefix, uint8_t depth,
+                       ChordId &digest, uint32_t &count) const
+{
+  ChordId low = GetPrefixBound (prefix, depth, false);
+  ChordId high = GetPrefixBound (prefix, depth, true);
+  // A node wholly inside the range reads its kept digest
+  bool inside = low.InInterval (from, to, true) && high.InInterval (from, to, true)
+    && from.Distance (low) <= from.Distance (high);
+  if (inside && depth <= DHASH_STORE_DIGEST_DEPTH)
+    {
+      std::map<std::pair<uint8_t, ChordId>, Digest>::const_iterator iter =
+        m_digests.find (std::make_pair (depth, low));
+      if (iter == m_digests.end ())
+        {
+          digest = ChordId ();
+          count = 0;
+        }
+      else
+        {
+          digest = iter->second.digest;
+          count = iter->second.count;
+        }
+      return;
+    }
+  // Deeper or at the range's ends: only the keys below the node
+  digest = ChordId ();
+  count = 0;
+  for (std::set<ChordId>::const_iterator iter = m_keys.lower_bound (low);
+       iter != m_keys.end () && *iter <= high; iter++)
+    {
+      if (iter->InInterval (from, to, true))
+        {
+          digest = digest ^ m_slots[Find (*iter)].digest;
+          count++;
+        }
+    }
+}
+
+void
+DHashStore::GetKeys (const ChordId &from, const ChordId &to, const ChordId &prefix, uint8_t depth,
+                     std::vector<ChordId> &keys) const
+{
+  ChordId high = GetPrefixBound (prefix, depth, true);
+  for (std::set<ChordId>::const_iterator iter = m_keys.lower_bound (GetPrefixBound (prefix, depth, false));
+       iter != m_keys.end () && *iter <= high; iter++)
+    {
+      if (iter->InInterval (from, to, true))
+        {
+          keys.push_back (*iter);
+        }
+    }
+}
+
+uint32_t
+DHashStore::GetSize () const
+{
+  return m_size;
+}
+
+uint32_t
+DHashStore::GetBytes () const
+{
+  return m_liveBytes;
+}
+
+void
+DHashStore::Clear ()
+{
+  m_slots.assign (STORE_INITIAL_SIZE, Slot ());
+  for (uint32_t i = 0; i < m_slots.size (); i++)
+    {
+      m_slots[i].used = false;
+    }
+  m_mask = STORE_INITIAL_SIZE - 1;
+  m_size = 0;
+  m_arena.clear ();
+  m_liveBytes = 0;
+  m_keys.clear ();
+  m_digests.clear ();
+}
+
+uint32_t
+DHashStore::Find (const ChordId &key) const
+{
+  uint32_t pos = key.GetHash32 () & m_mask;
+  while (m_slots[pos].used)
+    {
+      if (m_slots[pos].key == key)
+        {
+          return pos;
+        }
+      pos = (pos + 1) & m_mask;
+    }
+  return STORE_NOT_FOUND;
+}
+
+void
+DHashStore::Grow ()
+{
+  std::vector<Slot> oldSlots;
+  oldSlots.swap (m_slots);
+  uint32_t capacity = (m_mask + 1) * 2;
+  m_slots.resize (capacity);
+  for (uint32_t i = 0; i < m_slots.size (); i++)
+    {
+      m_slots[i].used = false;
+    }
+  m_mask = capacity - 1;
+  for (uint32_t i = 0; i < oldSlots.size (); i++)
+    {
+      if (!oldSlots[i].used)
+        {
+          continue;
+        }
+      uint32_t pos = oldSlots[i].key.GetHash32 () & m_mask;
+      while (m_slots[pos].used)
+        {
+          pos = (pos + 1) & m_mask;
+        }
+      m_slots[pos] = oldSlots[i];
+    }
+}
+
+void
+DHashStore::UpdateDigests (const ChordId &key, const ChordId &digest, bool add)
+{
+  for (uint8_t depth = 0; depth <= DHASH_STORE_DIGEST_DEPTH; depth++)
+    {
+      std::pair<uint8_t, ChordId> node (depth, GetPrefixBound (key, depth, false));
+      std::map<std::pair<uint8_t, ChordId>, Digest>::iterator iter = m_digests.find (node);
+      if (iter == m_digests.end ())
+        {
+          Digest empty;
+          empty.count = 0;
+          iter = m_digests.insert (std::make_pair (node, empty)).first;
+        }
+      // XOR takes a digest out as it puts it in
+      iter->second.digest = iter->second.digest ^ digest;
+      if (add)
+        {
+          iter->second.count++;
+        }
+      else if (--iter->second.count == 0)
+        {
+          m_digests.erase (iter);
+        }
+    }
+}
+
+ChordId
+DHashStore::GetPrefixBound (const ChordId &prefix, uint8_t depth, bool highest)
+{
+  uint8_t bytes[CHORD_ID_SIZE];
+  prefix.ToBytes (bytes);
+  uint8_t fill = highest ? 0xFF : 0x00;
+  for (uint32_t i = depth / 2; i < CHORD_ID_SIZE; i++)
+    {
+      // An odd depth keeps the high digit of its first byte
+      uint8_t keep = (i == depth / 2 && depth % 2 == 1) ? 0xF0 : 0x00;
+      bytes[i] = (bytes[i] & keep) | (fill & ~keep);
+    }
+  return ChordId::FromBytes (bytes);
+}
+
+void
+DHashStore::Compact ()
+{
+  std::vector<uint8_t> arena;
+  arena.reserve (m_liveBytes);
+  for (uint32_t i = 0; i < m_slots.size (); i++)
+    {
+      if (!m_slots[i].used)
+        {
+          continue;
+        }
+      uint32_t offset = arena.size ();
+      arena.insert (arena.end (), m_arena.begin () + m_slots[i].offset,
+                    m_arena.begin () + m_slots[i].offset + m_slots[i].size);
+      m_slots[i].offset = offset;
+    }
+  m_arena.swap (arena);
+}
@@ -0,0 +1,149 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DHASH_STORE_H
+#define DHASH_STORE_H
+
+#include "ns3/chord-id.h"
+
+#include <vector>
+#include <string>
+#include <set>
+#include <map>
+
+// Levels of the key prefix tree whose digests are kept up to date
+#define DHASH_STORE_DIGEST_DEPTH 3
+
+/**
+ * \brief Key-value store of the keys a Chord node is responsible for.
+ *
+ * Keys are found through an open-addressing table with linear probing and
+ * backward-shift deletion. Values are appended to a single arena; removed and
+ * overwritten values are reclaimed by compacting it once garbage exceeds the
+ * live bytes. Each item keeps a SHA-1 digest of its key and value, which
+ * replicas compare to find items that differ.
+ *
+ * Keys are also kept in ring order, and the XOR of the item digests below
+ * each node of the top DHASH_STORE_DIGEST_DEPTH levels of the hex digit
+ * prefix tree is updated on every Put () and Remove (), so Merkle
+ * comparisons read digests instead of recomputing them from the items.
+ */
+class DHashStore
+{
+  public:
+    /**
+     * \brief View of a stored value. It points into the arena and stays valid
+     * until the next Put (), Remove () or Clear ().
+     */
+    struct Value
+      {
+        const uint8_t *data;
+        uint32_t size;
+
+        std::string ToString () const
+        {
+          return std::string ((const char *) data, size);
+        }
+      };
+
+    struct Item
+      {
+        ChordId key;
+        ChordId digest;
+      };
+
+    DHashStore ();
+
+    /**
+     * \brief Stores a copy of value under key, replacing any previous value.
+     */
+    void Put (const ChordId &key, const uint8_t *data, uint32_t size);
+    void Put (const ChordId &key, const std::string &value);
+    /**
+     * \returns true and a view of the value stored under key, without
+     * copying it.
+     */
+    bool Get (const ChordId &key, Value &value) const;
+    bool Contains (const ChordId &key) const;
+    /**
+     * \returns false if key was not stored.
+     */
+    bool Remove (const ChordId &key);
+
+    /**
+     * \brief Appends the keys in (from, to] and their digests to items.
+     */
+    void GetItems (const ChordId &from, const ChordId &to, std::vector<Item> &items) const;
+    /**
+     * \brief XOR of the digests of, and number of, the items in (from, to]
+     * whose keys start with the leading depth hex digits of prefix.
+     */
+    void GetDigest (const ChordId &from, const ChordId &to, const ChordId &prefix, uint8_t depth,
+                    ChordId &digest, uint32_t &count) const;
+    /**
+     * \brief Appends the keys in (from, to] that start with the leading
+     * depth hex digits of prefix, in ascending order.
+     */
+    void GetKeys (const ChordId &from, const ChordId &to, const ChordId &prefix, uint8_t depth,
+                  std::vector<ChordId> &keys) const;
+
+    uint32_t GetSize () const;
+    /**
+     * \returns the bytes of live values.
+     */
+    uint32_t GetBytes () const;
+    void Clear ();
+
+  private:
+    struct Slot
+      {
+        ChordId key;
+        ChordId digest;
+        uint32_t offset;
+        uint32_t size;
+        bool used;
+      };
+
+    struct Digest
+      {
+        ChordId digest;
+        uint32_t count;
+      };
+
+    uint32_t Find (const ChordId &key) const;
+    void Grow ();
+    void Compact ();
+    /**
+     * \brief Adds or takes out the digest of key in the tree nodes above it.
+     */
+    void UpdateDigests (const ChordId &key, const ChordId &digest, bool add);
+    /**
+     * \returns the lowest, or highest, key starting with the leading depth
+     * hex digits of prefix.
+     */
+    static ChordId GetPrefixBound (const ChordId &prefix, uint8_t depth, bool highest);
+
+    std::vector<Slot> m_slots;
+    uint32_t m_mask;
+    uint32_t m_size;
+    std::vector<uint8_t> m_arena;
+    uint32_t m_liveBytes;
+    std::set<ChordId> m_keys;
+    // Tree nodes down to DHASH_STORE_DIGEST_DEPTH, by depth and lowest key
+    std::map<std::pair<uint8_t, ChordId>, Digest> m_digests;
+};
+
+#endif
@@ -23,6 +23,8 @@ NS_LOG_COMPONENT_DEFINE ("GUChordMessage");
 NS_OBJECT_ENSURE_REGISTERED (GUChordMessage);
 
 GUChordMessage::GUChordMessage ()
+  : m_sourcePort (0),
+    m_destinationPort (0)
 {
 }
 
@@ -34,6 +36,8 @@ GUChordMessage::GUChordMessage (GUChordMessage::MessageType messageType, uint32_
 {
   m_messageType = messageType;
   m_transactionId = transactionId;
+  m_sourcePort = 0;
+  m_destinationPort = 0;
 }
 
 TypeId 
@@ -52,12 +56,31 @@ GUChordMessage::GetInstanceTypeId (void) const
   return GetTypeId ();
 }
 
+void
+GUChordMessage::SetPorts (uint16_t sourcePort, uint16_t destinationPort)
+{
+  m_sourcePort = sourcePort;
+  m_destinationPort = destinationPort;
+}
+
+uint16_t
+GUChordMessage::GetSourcePort () const
+{
+  return m_sourcePort;
+}
+
+uint16_t
+GUChordMessage::GetDestinationPort () const
+{
+  return m_destinationPort;
+}
+
 
 uint32_t
 GUChordMessage::GetSerializedSize (void) const
 {
-  // size of messageType, transaction id
-  uint32_t size = sizeof (uint8_t) + sizeof (uint32_t);
+  // size of messageType, transaction id, source and destination ports
+  uint32_t size = sizeof (uint8_t) + sizeof (uint32_t) + 2 * sizeof (uint16_t);
   switch (m_messageType)
     {
       case PING_REQ:
@@ -87,14 +110,54 @@ GUChordMessage::GetSerializedSize (void) const
       case NOTIFY_PRED:
       size += m_message.notifyPred.GetSerializedSize ();
         break;
-      // case DHASH_LOOK:
-      // size += m_message.dhashLook.GetSerializedSize ();
+      case DHASH_REQ:
+        size += m_message.dhashReq.GetSerializedSize ();
+      break;
       case JOIN_REQ:
         size += m_message.joinReq.GetSerializedSize ();
       break;
       case JOIN_RSP:
         size += m_message.joinRsp.GetSerializedSize ();
       break;
+      case LOOKUP_REQ:
+        size += m_message.lookupReq.GetSerializedSize ();
+      break;
+      case LOOKUP_RSP:
+        size += m_message.lookupRsp.GetSerializedSize ();
+      break;
+      case NEXT_HOP_REQ:
+        size += m_message.nextHopReq.GetSerializedSize ();
+      break;
+      case NEXT_HOP_RSP:
+        size += m_message.nextHopRsp.GetSerializedSize ();
+      break;
+      case SNAPSHOT_REQ:
+        size += m_message.snapshotReq.GetSerializedSize ();
+      break;
+      case SNAPSHOT_RSP:
+        size += m_message.snapshotRsp.GetSerializedSize ();
+      break;
+      case SNAPSHOT_RECORDS:
+        size += m_message.snapshotRecords.GetSerializedSize ();
+      break;
+      case DHASH_RSP:
+        size += m_message.dhashRsp.GetSerializedSize ();
+      break;
+      case MERKLE_REQ:
+        size += m_message.merkleReq.GetSerializedSize ();
+      break;
+      case MERKLE_RSP:
+        size += m_message.merkleRsp.GetSerializedSize ();
+      break;
+      case REPLICA_SYNC:
+        size += m_message.replicaSync.GetSerializedSize ();
+      break;
+      case HANDOFF_REQ:
+        size += m_message.handoffReq.GetSerializedSize ();
+      break;
+      case HANDOFF_RSP:
+        size += m_message.handoffRsp.GetSerializedSize ();
+      break;
       default:
         NS_ASSERT (false);
     }
@@ -107,6 +170,7 @@ GUChordMessage::Print (std::ostream &os) const
   os << "\n****GUChordMessage Dump****\n" ;
   os << "messageType: " << m_messageType << "\n";
   os << "transactionId: " << m_transactionId << "\n";
+  os << "ports: " << m_sourcePort << " -> " << m_destinationPort << "\n";
   os << "PAYLOAD:: \n";
   
   switch (m_messageType)
@@ -129,6 +193,8 @@ GUChordMessage::Serialize (Buffer::Iterator start) const
   Buffer::Iterator i = start;
   i.WriteU8 (m_messageType);
   i.WriteHtonU32 (m_transactionId);
+  i.WriteHtonU16 (m_sourcePort);
+  i.WriteHtonU16 (m_destinationPort);
 
   switch (m_messageType)
     {
@@ -159,15 +225,54 @@ GUChordMessage::Serialize (Buffer::Iterator start) const
       case NOTIFY_PRED:
         m_message.notifyPred.Serialize (i);
         break;
-      // case DHASH_LOOK:
-      //   m_message.dhashLook.Serialize (i);
-        // break;
+      case DHASH_REQ:
+        m_message.dhashReq.Serialize (i);
+        break;
       case JOIN_REQ:
         m_message.joinReq.Serialize (i);
         break;
       case JOIN_RSP:
         m_message.joinRsp.Serialize (i);
         break;
+      case LOOKUP_REQ:
+        m_message.lookupReq.Serialize (i);
+        break;
+      case LOOKUP_RSP:
+        m_message.lookupRsp.Serialize (i);
+        break;
+      case NEXT_HOP_REQ:
+        m_message.nextHopReq.Serialize (i);
+        break;
+      case NEXT_HOP_RSP:
+        m_message.nextHopRsp.Serialize (i);
+        break;
+      case SNAPSHOT_REQ:
+        m_message.snapshotReq.Serialize (i);
+        break;
+      case SNAPSHOT_RSP:
+        m_message.snapshotRsp.Serialize (i);
+        break;
+      case SNAPSHOT_RECORDS:
+        m_message.snapshotRecords.Serialize (i);
+        break;
+      case DHASH_RSP:
+        m_message.dhashRsp.Serialize (i);
+        break;
+      case MERKLE_REQ:
+        m_message.merkleReq.Serialize (i);
+        break;
+      case MERKLE_RSP:
+        m_message.merkleRsp.Serialize (i);
+        break;
+      case REPLICA_SYNC:
+        m_message.replicaSync.Serialize (i);
+        break;
+      case HANDOFF_REQ:
+        m_message.handoffReq.Serialize (i);
+        break;
+      case HANDOFF_RSP:
+        m_message.handoffRsp.Serialize (i);
+        break;
       default:
         NS_ASSERT (false);   
     }
@@ -180,8 +285,10 @@ GUChordMessage::Deserialize (Buffer::Iterator start)
   Buffer::Iterator i = start;
   m_messageType = (MessageType) i.ReadU8 ();
   m_transactionId = i.ReadNtohU32 ();
+  m_sourcePort = i.ReadNtohU16 ();
+  m_destinationPort = i.ReadNtohU16 ();
 
-  size = sizeof (uint8_t) + sizeof (uint32_t);
+  size = sizeof (uint8_t) + sizeof (uint32_t) + 2 * sizeof (uint16_t);
 
   switch (m_messageType)
     {
@@ -192,35 +299,74 @@ GUChordMessage::Deserialize (Buffer::Iterator start)
         size += m_message.pingRsp.Deserialize (i);
         break;
       case FIND_SUC_REQ:
-        m_message.findSucReq.Deserialize (i);
+        size += m_message.findSucReq.Deserialize (i);
         break;
       case FIND_SUC_RSP:
-        m_message.findSucRsp.Deserialize (i);
+        size += m_message.findSucRsp.Deserialize (i);
         break;
       case GET_PRED_SUC_REQ:
-        m_message.getPredSucReq.Deserialize (i);
+        size += m_message.getPredSucReq.Deserialize (i);
         break;
       case GET_PRED_SUC_RSP:
-        m_message.getPredSucRsp.Deserialize (i);
+        size += m_message.getPredSucRsp.Deserialize (i);
         break;
       case RINGSTATE:
-        m_message.ringstate.Deserialize (i);
+        size += m_message.ringstate.Deserialize (i);
         break;
       case NOTIFY_SUC:
-        m_message.notifySuc.Deserialize (i);
+        size += m_message.notifySuc.Deserialize (i);
         break;
       case NOTIFY_PRED:
-        m_message.notifyPred.Deserialize (i);
+        size += m_message.notifyPred.Deserialize (i);
+        break;
+      case DHASH_REQ:
+        size += m_message.dhashReq.Deserialize (i);
         break;
-      // case DHASH_LOOK:
-      //   m_message.dhashLook.Deserialize (i);
-      // break;
       case JOIN_REQ:
-        m_message.joinReq.Deserialize (i);
+        size += m_message.joinReq.Deserialize (i);
         break;
       case JOIN_RSP:
         size += m_message.joinRsp.Deserialize (i);
         break;
+      case LOOKUP_REQ:
+        size += m_message.lookupReq.Deserialize (i);
+        break;
+      case LOOKUP_RSP:
+        size += m_message.lookupRsp.Deserialize (i);
+        break;
+      case NEXT_HOP_REQ:
+        size += m_message.nextHopReq.Deserialize (i);
+        break;
+      case NEXT_HOP_RSP:
+        size += m_message.nextHopRsp.Deserialize (i);
+        break;
+      case SNAPSHOT_REQ:
+        size += m_message.snapshotReq.Deserialize (i);
+        break;
+      case SNAPSHOT_RSP:
+        size += m_message.snapshotRsp.Deserialize (i);
+        break;
+      case SNAPSHOT_RECORDS:
+        size += m_message.snapshotRecords.Deserialize (i);
+        break;
+      case DHASH_RSP:
+        size += m_message.dhashRsp.Deserialize (i);
+        break;
+      case MERKLE_REQ:
+        size += m_message.merkleReq.Deserialize (i);
+        break;
+      case MERKLE_RSP:
+        size += m_message.merkleRsp.Deserialize (i);
+        break;
+      case REPLICA_SYNC:
+        size += m_message.replicaSync.Deserialize (i);
+        break;
+      case HANDOFF_REQ:
+        size += m_message.handoffReq.Deserialize (i);
+        break;
+      case HANDOFF_RSP:
+        size += m_message.handoffRsp.Deserialize (i);
+        break;
       default:
         NS_ASSERT (false);
     }
@@ -335,60 +481,39 @@ GUChordMessage::GetPingRsp ()
   return m_message.pingRsp;
 }
 
-//
-// //
-
-
 uint32_t 
 GUChordMessage::FindSucRsp::GetSerializedSize (void) const
 {
   uint32_t size;
-  size = sizeof(uint16_t) + NodeId.length();
-  size += sizeof(uint16_t) + SNodeId.length();
-  size += sizeof(uint16_t) + PNodeId.length();
+  size = 3 * CHORD_NODE_DESCRIPTOR_SIZE;
   return size;
 }
 
 void
 GUChordMessage::FindSucRsp::Print (std::ostream &os) const
 {
-  os << "FindSucRsp:: Message: " << NodeId << "\n";
+  os << "FindSucRsp:: Node: " << Node << " SNode: " << SNode << " PNode: " << PNode << "\n";
 }
 
 void
 GUChordMessage::FindSucRsp::Serialize (Buffer::Iterator &start) const
 {
-  start.WriteU16 (NodeId.length ());
-  start.Write ((uint8_t *) (const_cast<char*> (NodeId.c_str())), NodeId.length());
-  start.WriteU16 (SNodeId.length ());
-  start.Write ((uint8_t *) (const_cast<char*> (SNodeId.c_str())), SNodeId.length());
-  start.WriteU16 (PNodeId.length ());
-  start.Write ((uint8_t *) (const_cast<char*> (PNodeId.c_str())), PNodeId.length());
+  Node.Serialize (start);
+  SNode.Serialize (start);
+  PNode.Serialize (start);
 }
 
 uint32_t
 GUChordMessage::FindSucRsp::Deserialize (Buffer::Iterator &start)
 {  
-  uint16_t length = start.ReadU16 ();
-  char* str = (char*) malloc (length);
-  start.Read ((uint8_t*)str, length);
-  NodeId = std::string (str, length);
-  free (str);
-  uint16_t Slength = start.ReadU16 ();
-  char* Sstr = (char*) malloc (Slength);
-  start.Read ((uint8_t*)Sstr, Slength);
-  SNodeId = std::string (Sstr, Slength);
-  free (Sstr);
-  uint16_t Plength = start.ReadU16 ();
-  char* Pstr = (char*) malloc (Plength);
-  start.Read ((uint8_t*)Pstr, Plength);
-  PNodeId = std::string (Pstr, Plength);
-  free (Pstr);
+  Node.Deserialize (start);
+  SNode.Deserialize (start);
+  PNode.Deserialize (start);
   return FindSucRsp::GetSerializedSize ();
 }
 
 void
-GUChordMessage::SetFindSucRsp (std::string NodeId, std::string SNodeId, std::string PNodeId)
+GUChordMessage::SetFindSucRsp (const ChordNodeDescriptor &Node, const ChordNodeDescriptor &SNode, const ChordNodeDescriptor &PNode)
 {
   if (m_messageType == 0)
     {
@@ -398,61 +523,49 @@ GUChordMessage::SetFindSucRsp (std::string NodeId, std::string SNodeId, std::str
     {
       NS_ASSERT (m_messageType == FIND_SUC_RSP);
     }
-  m_message.findSucRsp.NodeId = NodeId;
-  m_message.findSucRsp.SNodeId = SNodeId;
-  m_message.findSucRsp.PNodeId = PNodeId;
+  m_message.findSucRsp.Node = Node;
+  m_message.findSucRsp.SNode = SNode;
+  m_message.findSucRsp.PNode = PNode;
 }
 
 GUChordMessage::FindSucRsp
-GUChordMessage::GetFindSucRsp ()
+GUChordMessage::GetFindSucRsp()
 {
   return m_message.findSucRsp;
 }
 
 
-
 uint32_t 
 GUChordMessage::FindSucReq::GetSerializedSize (void) const
 {
   uint32_t size;
-  size = sizeof(uint16_t) + NodeId.length();
-  size += sizeof(uint16_t) + HNodeId.length();
+  size = 2 * CHORD_NODE_DESCRIPTOR_SIZE;
   return size;
 }
 
 void
 GUChordMessage::FindSucReq::Print (std::ostream &os) const
 {
-  os << "FindSucReq::Message: " << NodeId << "\n";
+  os << "FindSucReq:: Node: " << Node << " HNode: " << HNode << "\n";
 }
 
 void
 GUChordMessage::FindSucReq::Serialize (Buffer::Iterator &start) const
 {
-  start.WriteU16 (NodeId.length ());
-  start.Write ((uint8_t *) (const_cast<char*> (NodeId.c_str())), NodeId.length());
-  start.WriteU16 (HNodeId.length ());
-  start.Write ((uint8_t *) (const_cast<char*> (HNodeId.c_str())), HNodeId.length());
+  Node.Serialize (start);
+  HNode.Serialize (start);
 }
 
 uint32_t
 GUChordMessage::FindSucReq::Deserialize (Buffer::Iterator &start)
 {  
-  uint16_t length = start.ReadU16 ();
-  char* str = (char*) malloc (length);
-  start.Read ((uint8_t*)str, length);
-  NodeId = std::string (str, length);
-  free (str);
-  uint16_t Hlength = start.ReadU16 ();
-  char* Hstr = (char*) malloc (Hlength);
-  start.Read ((uint8_t*)Hstr, Hlength);
-  HNodeId = std::string (Hstr, Hlength);
-  free (Hstr);
+  Node.Deserialize (start);
+  HNode.Deserialize (start);
   return FindSucReq::GetSerializedSize ();
 }
 
 void
-GUChordMessage::SetFindSucReq (std::string NodeId, std::string HNodeId)
+GUChordMessage::SetFindSucReq (const ChordNodeDescriptor &Node, const ChordNodeDescriptor &HNode)
 {
   if (m_messageType == 0)
     {
@@ -462,52 +575,46 @@ GUChordMessage::SetFindSucReq (std::string NodeId, std::string HNodeId)
     {
       NS_ASSERT (m_messageType == FIND_SUC_REQ);
     }
-  m_message.findSucReq.NodeId = NodeId;
-  m_message.findSucReq.HNodeId = HNodeId;
+  m_message.findSucReq.Node = Node;
+  m_message.findSucReq.HNode = HNode;
 }
 
 GUChordMessage::FindSucReq
-GUChordMessage::GetFindSucReq ()
+GUChordMessage::GetFindSucReq()
 {
   return m_message.findSucReq;
 }
 
 
-
 uint32_t 
 GUChordMessage::GetPredSucReq::GetSerializedSize (void) const
 {
   uint32_t size;
-  size = sizeof(uint16_t) + NodeId.length();
+  size = CHORD_NODE_DESCRIPTOR_SIZE;
   return size;
 }
 
 void
 GUChordMessage::GetPredSucReq::Print (std::ostream &os) const
 {
-  os << "getPredSucReq:: Message: " << NodeId << "\n";
+  os << "GetPredSucReq:: Node: " << Node << "\n";
 }
 
 void
 GUChordMessage::GetPredSucReq::Serialize (Buffer::Iterator &start) const
 {
-  start.WriteU16 (NodeId.length ());
-  start.Write ((uint8_t *) (const_cast<char*> (NodeId.c_str())), NodeId.length());
+  Node.Serialize (start);
 }
 
 uint32_t
 GUChordMessage::GetPredSucReq::Deserialize (Buffer::Iterator &start)
 {  
-  uint16_t length = start.ReadU16 ();
-  char* str = (char*) malloc (length);
-  start.Read ((uint8_t*)str, length);
-  NodeId = std::string (str, length);
-  free (str);
+  Node.Deserialize (start);
   return GetPredSucReq::GetSerializedSize ();
 }
 
 void
-GUChordMessage::SetGetPredSucReq (std::string NodeId)
+GUChordMessage::SetGetPredSucReq (const ChordNodeDescriptor &Node)
 {
   if (m_messageType == 0)
     {
@@ -517,7 +624,7 @@ GUChordMessage::SetGetPredSucReq (std::string NodeId)
     {
       NS_ASSERT (m_messageType == GET_PRED_SUC_REQ);
     }
-  m_message.getPredSucReq.NodeId = NodeId;
+  m_message.getPredSucReq.Node = Node;
 }
 
 GUChordMessage::GetPredSucReq
@@ -527,41 +634,51 @@ GUChordMessage::GetGetPredSucReq()
 }
 
 
-
 uint32_t 
 GUChordMessage::GetPredSucRsp::GetSerializedSize (void) const
 {
   uint32_t size;
-  size = sizeof(uint16_t) + NodeId.length();
+  size = CHORD_NODE_DESCRIPTOR_SIZE + sizeof(uint8_t);
+  size += successors.size () * CHORD_NODE_DESCRIPTOR_SIZE;
   return size;
 }
 
 void
 GUChordMessage::GetPredSucRsp::Print (std::ostream &os) const
 {
-  os << "getPredSucRsp:: Message: " << NodeId << "\n";
+  os << "GetPredSucRsp:: PNode: " << PNode << " Successors:";
+  for (uint32_t i = 0; i < successors.size (); i++)
+    {
+      os << " " << successors[i];
+    }
+  os << "\n";
 }
 
 void
 GUChordMessage::GetPredSucRsp::Serialize (Buffer::Iterator &start) const
 {
-  start.WriteU16 (NodeId.length ());
-  start.Write ((uint8_t *) (const_cast<char*> (NodeId.c_str())), NodeId.length());
+  PNode.Serialize (start);
+  start.WriteU8 (successors.size ());
+  for (uint32_t i = 0; i < successors.size (); i++)
+    {
+      successors[i].Serialize (start);
+    }
 }
 
 uint32_t
 GUChordMessage::GetPredSucRsp::Deserialize (Buffer::Iterator &start)
 {  
-  uint16_t length = start.ReadU16 ();
-  char* str = (char*) malloc (length);
-  start.Read ((uint8_t*)str, length);
-  NodeId = std::string (str, length);
-  free (str);
+  PNode.Deserialize (start);
+  successors.resize (start.ReadU8 ());
+  for (uint32_t i = 0; i < successors.size (); i++)
+    {
+      successors[i].Deserialize (start);
+    }
   return GetPredSucRsp::GetSerializedSize ();
 }
 
 void
-GUChordMessage::SetGetPredSucRsp (std::string NodeId)
+GUChordMessage::SetGetPredSucRsp (const ChordNodeDescriptor &PNode, const std::vector<ChordNodeDescriptor> &successors)
 {
   if (m_messageType == 0)
     {
@@ -571,7 +688,8 @@ GUChordMessage::SetGetPredSucRsp (std::string NodeId)
     {
       NS_ASSERT (m_messageType == GET_PRED_SUC_RSP);
     }
-  m_message.getPredSucRsp.NodeId = NodeId;
+  m_message.getPredSucRsp.PNode = PNode;
+  m_message.getPredSucRsp.successors = successors;
 }
 
 GUChordMessage::GetPredSucRsp
@@ -585,36 +703,31 @@ uint32_t
 GUChordMessage::Ringstate::GetSerializedSize (void) const
 {
   uint32_t size;
-  size = sizeof(uint16_t) + NodeId.length();
+  size = CHORD_NODE_DESCRIPTOR_SIZE;
   return size;
 }
 
 void
 GUChordMessage::Ringstate::Print (std::ostream &os) const
 {
-  os << "Ringstate:: Message: " << NodeId << "\n";
+  os << "Ringstate:: Node: " << Node << "\n";
 }
 
 void
 GUChordMessage::Ringstate::Serialize (Buffer::Iterator &start) const
 {
-  start.WriteU16 (NodeId.length ());
-  start.Write ((uint8_t *) (const_cast<char*> (NodeId.c_str())), NodeId.length());
+  Node.Serialize (start);
 }
 
 uint32_t
 GUChordMessage::Ringstate::Deserialize (Buffer::Iterator &start)
 {  
-  uint16_t length = start.ReadU16 ();
-  char* str = (char*) malloc (length);
-  start.Read ((uint8_t*)str, length);
-  NodeId = std::string (str, length);
-  free (str);
+  Node.Deserialize (start);
   return Ringstate::GetSerializedSize ();
 }
 
 void
-GUChordMessage::SetRingstate (std::string NodeId)
+GUChordMessage::SetRingstate (const ChordNodeDescriptor &Node)
 {
   if (m_messageType == 0)
     {
@@ -624,7 +737,7 @@ GUChordMessage::SetRingstate (std::string NodeId)
     {
       NS_ASSERT (m_messageType == RINGSTATE);
     }
-  m_message.ringstate.NodeId = NodeId;
+  m_message.ringstate.Node = Node;
 }
 
 GUChordMessage::Ringstate
@@ -638,36 +751,31 @@ uint32_t
 GUChordMessage::NotifySuc::GetSerializedSize (void) const
 {
   uint32_t size;
-  size = sizeof(uint16_t) + NodeId.length();
+  size = CHORD_NODE_DESCRIPTOR_SIZE;
   return size;
 }
 
 void
 GUChordMessage::NotifySuc::Print (std::ostream &os) const
 {
-  os << "NotifySuc:: Message: " << NodeId<< "\n";
+  os << "NotifySuc:: Node: " << Node << "\n";
 }
 
 void
 GUChordMessage::NotifySuc::Serialize (Buffer::Iterator &start) const
 {
-  start.WriteU16 (NodeId.length ());
-  start.Write ((uint8_t *) (const_cast<char*> (NodeId.c_str())), NodeId.length());
+  Node.Serialize (start);
 }
 
 uint32_t
 GUChordMessage::NotifySuc::Deserialize (Buffer::Iterator &start)
 {  
-  uint16_t length = start.ReadU16 ();
-  char* str = (char*) malloc (length);
-  start.Read ((uint8_t*)str, length);
-  NodeId = std::string (str, length);
-  free (str);
+  Node.Deserialize (start);
   return NotifySuc::GetSerializedSize ();
 }
 
 void
-GUChordMessage::SetNotifySuc (std::string NodeId)
+GUChordMessage::SetNotifySuc (const ChordNodeDescriptor &Node)
 {
   if (m_messageType == 0)
     {
@@ -677,7 +785,7 @@ GUChordMessage::SetNotifySuc (std::string NodeId)
     {
       NS_ASSERT (m_messageType == NOTIFY_SUC);
     }
-  m_message.notifySuc.NodeId = NodeId;
+  m_message.notifySuc.Node = Node;
 }
 
 GUChordMessage::NotifySuc
@@ -686,40 +794,36 @@ GUChordMessage::GetNotifySuc()
   return m_message.notifySuc;
 }
 
+
 uint32_t 
 GUChordMessage::NotifyPred::GetSerializedSize (void) const
 {
   uint32_t size;
-  size = sizeof(uint16_t) + NodeId.length();
+  size = CHORD_NODE_DESCRIPTOR_SIZE;
   return size;
 }
 
 void
 GUChordMessage::NotifyPred::Print (std::ostream &os) const
 {
-  os << "NotifyPred:: Message: " << NodeId << "\n";
+  os << "NotifyPred:: Node: " << Node << "\n";
 }
 
 void
 GUChordMessage::NotifyPred::Serialize (Buffer::Iterator &start) const
 {
-  start.WriteU16 (NodeId.length ());
-  start.Write ((uint8_t *) (const_cast<char*> (NodeId.c_str())), NodeId.length());
+  Node.Serialize (start);
 }
 
 uint32_t
 GUChordMessage::NotifyPred::Deserialize (Buffer::Iterator &start)
 {  
-  uint16_t length = start.ReadU16 ();
-  char* str = (char*) malloc (length);
-  start.Read ((uint8_t*)str, length);
-  NodeId = std::string (str, length);
-  free (str);
+  Node.Deserialize (start);
   return NotifyPred::GetSerializedSize ();
 }
 
 void
-GUChordMessage::SetNotifyPred (std::string NodeId)
+GUChordMessage::SetNotifyPred (const ChordNodeDescriptor &Node)
 {
   if (m_messageType == 0)
     {
@@ -729,7 +833,7 @@ GUChordMessage::SetNotifyPred (std::string NodeId)
     {
       NS_ASSERT (m_messageType == NOTIFY_PRED);
     }
-  m_message.notifyPred.NodeId = NodeId;
+  m_message.notifyPred.Node = Node;
 }
 
 GUChordMessage::NotifyPred
@@ -738,48 +842,38 @@ GUChordMessage::GetNotifyPred()
   return m_message.notifyPred;
 }
 
+
 uint32_t 
 GUChordMessage::JoinRsp::GetSerializedSize (void) const
 {
   uint32_t size;
-  size = sizeof(uint16_t) + SNodeId.length();
-  size += sizeof(uint16_t) + PNodeId.length();
+  size = 2 * CHORD_NODE_DESCRIPTOR_SIZE;
   return size;
 }
 
 void
 GUChordMessage::JoinRsp::Print (std::ostream &os) const
 {
-  os << "JoinRsp::Message: " << SNodeId << "\n";
+  os << "JoinRsp:: SNode: " << SNode << " PNode: " << PNode << "\n";
 }
 
 void
 GUChordMessage::JoinRsp::Serialize (Buffer::Iterator &start) const
 {
-  start.WriteU16 (SNodeId.length ());
-  start.Write ((uint8_t *) (const_cast<char*> (SNodeId.c_str())), SNodeId.length());
-  start.WriteU16 (PNodeId.length ());
-  start.Write ((uint8_t *) (const_cast<char*> (PNodeId.c_str())), PNodeId.length());
+  SNode.Serialize (start);
+  PNode.Serialize (start);
 }
 
 uint32_t
 GUChordMessage::JoinRsp::Deserialize (Buffer::Iterator &start)
 {  
-  uint16_t length = start.ReadU16 ();
-  char* str = (char*) malloc (length);
-  start.Read ((uint8_t*)str, length);
-  SNodeId = std::string (str, length);
-  free (str);
-  uint16_t Hlength = start.ReadU16 ();
-  char* Hstr = (char*) malloc (Hlength);
-  start.Read ((uint8_t*)Hstr, Hlength);
-  PNodeId = std::string (Hstr, Hlength);
-  free (Hstr);
+  SNode.Deserialize (start);
+  PNode.Deserialize (start);
   return JoinRsp::GetSerializedSize ();
 }
 
 void
-GUChordMessage::SetJoinRsp (std::string NodeId,std::string HNodeId)
+GUChordMessage::SetJoinRsp (const ChordNodeDescriptor &SNode, const ChordNodeDescriptor &PNode)
 {
   if (m_messageType == 0)
     {
@@ -789,8 +883,8 @@ GUChordMessage::SetJoinRsp (std::string NodeId,std::string HNodeId)
     {
       NS_ASSERT (m_messageType == JOIN_RSP);
     }
-  m_message.joinRsp.SNodeId = NodeId;
-  m_message.joinRsp.PNodeId = HNodeId;
+  m_message.joinRsp.SNode = SNode;
+  m_message.joinRsp.PNode = PNode;
 }
 
 GUChordMessage::JoinRsp
@@ -799,39 +893,36 @@ GUChordMessage::GetJoinRsp()
   return m_message.joinRsp;
 }
 
+
 uint32_t 
 GUChordMessage::JoinReq::GetSerializedSize (void) const
 {
   uint32_t size;
-  size = sizeof(uint16_t) + NodeId.length();
+  size = CHORD_NODE_DESCRIPTOR_SIZE;
   return size;
 }
 
 void
 GUChordMessage::JoinReq::Print (std::ostream &os) const
 {
-  os << "JoinReq::Message: " << NodeId << "\n";
+  os << "JoinReq:: Node: " << Node << "\n";
 }
 
 void
 GUChordMessage::JoinReq::Serialize (Buffer::Iterator &start) const
 {
-  start.WriteU16 (NodeId.length ());
-  start.Write ((uint8_t *) (const_cast<char*> (NodeId.c_str())), NodeId.length());
+  Node.Serialize (start);
 }
 
 uint32_t
 GUChordMessage::JoinReq::Deserialize (Buffer::Iterator &start)
 {  
-  uint16_t length = start.ReadU16 ();
-  char* str = (char*) malloc (length);
-  start.Read ((uint8_t*)str, length);
-  NodeId = std::string (str, length);
+  Node.Deserialize (start);
   return JoinReq::GetSerializedSize ();
 }
 
 void
-GUChordMessage::SetJoinReq (std::string NodeId)
+GUChordMessage::SetJoinReq (const ChordNodeDescriptor &Node)
 {
   if (m_messageType == 0)
     {
@@ -841,7 +932,7 @@ GUChordMessage::SetJoinReq (std::string NodeId)
     {
       NS_ASSERT (m_messageType == JOIN_REQ);
     }
-  m_message.joinReq.NodeId = NodeId;
+  m_message.joinReq.Node = Node;
 }
 
 GUChordMessage::JoinReq
@@ -851,87 +942,968 @@ GUChordMessage::GetJoinReq()
 }
 
 
+/* LOOKUP_REQ */
+
+uint32_t 
+GUChordMessage::LookupReq::GetSerializedSize (void) const
+{
+  uint32_t size;
+  size = CHORD_ID_SIZE + CHORD_NODE_DESCRIPTOR_SIZE + sizeof(uint8_t);
+  return size;
+}
+
+void
+GUChordMessage::LookupReq::Print (std::ostream &os) const
+{
+  os << "LookupReq:: Node: " << Node << " Hops: " << (uint32_t) hops << "\n";
+}
+
+void
+GUChordMessage::LookupReq::Serialize (Buffer::Iterator &start) const
+{
+  uint8_t bytes[CHORD_ID_SIZE];
+  key.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  Node.Serialize (start);
+  start.WriteU8 (hops);
+}
+
+uint32_t
+GUChordMessage::LookupReq::Deserialize (Buffer::Iterator &start)
+{  
+  uint8_t bytes[CHORD_ID_SIZE];
+  start.Read (bytes, CHORD_ID_SIZE);
+  key = ChordId::FromBytes (bytes);
+  Node.Deserialize (start);
+  hops = start.ReadU8 ();
+  return LookupReq::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetLookupReq (const ChordId &key, const ChordNodeDescriptor &Node, uint8_t hops)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = LOOKUP_REQ;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == LOOKUP_REQ);
+    }
+  m_message.lookupReq.key = key;
+  m_message.lookupReq.Node = Node;
+  m_message.lookupReq.hops = hops;
+}
+
+GUChordMessage::LookupReq
+GUChordMessage::GetLookupReq()
+{
+  return m_message.lookupReq;
+}
+
+
+/* LOOKUP_RSP */
+
+uint32_t 
+GUChordMessage::LookupRsp::GetSerializedSize (void) const
+{
+  uint32_t size;
+  size = CHORD_ID_SIZE + 2 * CHORD_NODE_DESCRIPTOR_SIZE + sizeof(uint8_t);
+  return size;
+}
+
+void
+GUChordMessage::LookupRsp::Print (std::ostream &os) const
+{
+  os << "LookupRsp:: SNode: " << SNode << " PNode: " << PNode << " Hops: " << (uint32_t) hops << "\n";
+}
 
+void
+GUChordMessage::LookupRsp::Serialize (Buffer::Iterator &start) const
+{
+  uint8_t bytes[CHORD_ID_SIZE];
+  key.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  SNode.Serialize (start);
+  PNode.Serialize (start);
+  start.WriteU8 (hops);
+}
 
-// uint32_t 
-// GUChordMessage::DhashLook::GetSerializedSize (void) const
-// {
-//   uint32_t size;
-//   size = sizeof(uint16_t) + pingMessage.length();
-//   return size;
-// }
+uint32_t
+GUChordMessage::LookupRsp::Deserialize (Buffer::Iterator &start)
+{  
+  uint8_t bytes[CHORD_ID_SIZE];
+  start.Read (bytes, CHORD_ID_SIZE);
+  key = ChordId::FromBytes (bytes);
+  SNode.Deserialize (start);
+  PNode.Deserialize (start);
+  hops = start.ReadU8 ();
+  return LookupRsp::GetSerializedSize ();
+}
 
-// void
-// GUChordMessage::DhashLook::Print (std::ostream &os) const
-// {
-//   os << "FindSucReq:: Message: " << pingMessage << "\n";
-// }
+void
+GUChordMessage::SetLookupRsp (const ChordId &key, const ChordNodeDescriptor &SNode, const ChordNodeDescriptor &PNode, uint8_t hops)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = LOOKUP_RSP;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == LOOKUP_RSP);
+    }
+  m_message.lookupRsp.key = key;
+  m_message.lookupRsp.SNode = SNode;
+  m_message.lookupRsp.PNode = PNode;
+  m_message.lookupRsp.hops = hops;
+}
 
-// void
-// GUChordMessage::DhashLook::Serialize (Buffer::Iterator &start) const
-// {
-//   start.WriteU16 (pingMessage.length ());
-//   start.Write ((uint8_t *) (const_cast<char*> (pingMessage.c_str())), pingMessage.length());
-// }
+GUChordMessage::LookupRsp
+GUChordMessage::GetLookupRsp()
+{
+  return m_message.lookupRsp;
+}
 
-// uint32_t
-// GUChordMessage::DhashLook::Deserialize (Buffer::Iterator &start)
-// {  
-//   uint16_t length = start.ReadU16 ();
-//   char* str = (char*) malloc (length);
-//   start.Read ((uint8_t*)str, length);
-//   pingMessage = std::string (str, length);
-//   free (str);
-//   return FindSucReq::GetSerializedSize ();
-// }
+/* NEXT_HOP_REQ */
 
-// void
-// GUChordMessage::DhashLook (std::string pingMessage)
-// {
-//   if (m_messageType == 0)
-//     {
-//       m_messageType = FIND_SUC_REQ;
-//     }
-//   else
-//     {
-//       NS_ASSERT (m_messageType == FIND_SUC_REQ);
-//     }
-//   m_message.FindSucReq.pingMessage = pingMessage;
-// }
+uint32_t 
+GUChordMessage::NextHopReq::GetSerializedSize (void) const
+{
+  uint32_t size;
+  size = CHORD_ID_SIZE;
+  return size;
+}
 
-// GUChordMessage::DhashLook
-// GUChordMessage::GetDHashLook()
-// {
-//   return m_message.findSucReq;
-// }
+void
+GUChordMessage::NextHopReq::Print (std::ostream &os) const
+{
+  os << "NextHopReq:: Key: " << key << "\n";
+}
 
+void
+GUChordMessage::NextHopReq::Serialize (Buffer::Iterator &start) const
+{
+  uint8_t bytes[CHORD_ID_SIZE];
+  key.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+}
 
+uint32_t
+GUChordMessage::NextHopReq::Deserialize (Buffer::Iterator &start)
+{  
+  uint8_t bytes[CHORD_ID_SIZE];
+  start.Read (bytes, CHORD_ID_SIZE);
+  key = ChordId::FromBytes (bytes);
+  return NextHopReq::GetSerializedSize ();
+}
 
+void
+GUChordMessage::SetNextHopReq (const ChordId &key)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = NEXT_HOP_REQ;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == NEXT_HOP_REQ);
+    }
+  m_message.nextHopReq.key = key;
+}
 
+GUChordMessage::NextHopReq
+GUChordMessage::GetNextHopReq()
+{
+  return m_message.nextHopReq;
+}
 
+/* NEXT_HOP_RSP */
 
+uint32_t 
+GUChordMessage::NextHopRsp::GetSerializedSize (void) const
+{
+  uint32_t size;
+  size = CHORD_ID_SIZE + sizeof(uint8_t) + 2 * CHORD_NODE_DESCRIPTOR_SIZE + sizeof(uint8_t);
+  size += nodes.size () * CHORD_NODE_DESCRIPTOR_SIZE;
+  return size;
+}
 
 void
-GUChordMessage::SetMessageType (MessageType messageType)
+GUChordMessage::NextHopRsp::Print (std::ostream &os) const
 {
-  m_messageType = messageType;
+  os << "NextHopRsp:: Done: " << (uint32_t) done << " SNode: " << SNode << " PNode: " << PNode << " Nodes:";
+  for (uint32_t i = 0; i < nodes.size (); i++)
+    {
+      os << " " << nodes[i];
+    }
+  os << "\n";
+}
+
+void
+GUChordMessage::NextHopRsp::Serialize (Buffer::Iterator &start) const
+{
+  uint8_t bytes[CHORD_ID_SIZE];
+  key.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  start.WriteU8 (done);
+  SNode.Serialize (start);
+  PNode.Serialize (start);
+  start.WriteU8 (nodes.size ());
+  for (uint32_t i = 0; i < nodes.size (); i++)
+    {
+      nodes[i].Serialize (start);
+    }
+}
+
+uint32_t
+GUChordMessage::NextHopRsp::Deserialize (Buffer::Iterator &start)
+{  
+  uint8_t bytes[CHORD_ID_SIZE];
+  start.Read (bytes, CHORD_ID_SIZE);
+  key = ChordId::FromBytes (bytes);
+  done = start.ReadU8 ();
+  SNode.Deserialize (start);
+  PNode.Deserialize (start);
+  nodes.resize (start.ReadU8 ());
+  for (uint32_t i = 0; i < nodes.size (); i++)
+    {
+      nodes[i].Deserialize (start);
+    }
+  return NextHopRsp::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetNextHopRsp (const ChordId &key, uint8_t done, const ChordNodeDescriptor &SNode, const ChordNodeDescriptor &PNode, const std::vector<ChordNodeDescriptor> &nodes)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = NEXT_HOP_RSP;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == NEXT_HOP_RSP);
+    }
+  m_message.nextHopRsp.key = key;
+  m_message.nextHopRsp.done = done;
+  m_message.nextHopRsp.SNode = SNode;
+  m_message.nextHopRsp.PNode = PNode;
+  m_message.nextHopRsp.nodes = nodes;
+}
+
+GUChordMessage::NextHopRsp
+GUChordMessage::GetNextHopRsp()
+{
+  return m_message.nextHopRsp;
 }
 
-GUChordMessage::MessageType
-GUChordMessage::GetMessageType () const
+
+
+/* SNAPSHOT_REQ */
+
+void
+GUChordMessage::RingRecord::Serialize (Buffer::Iterator &start) const
 {
-  return m_messageType;
+  node.Serialize (start);
+  pred.Serialize (start);
+  suc.Serialize (start);
 }
 
 void
-GUChordMessage::SetTransactionId (uint32_t transactionId)
+GUChordMessage::RingRecord::Deserialize (Buffer::Iterator &start)
 {
-  m_transactionId = transactionId;
+  node.Deserialize (start);
+  pred.Deserialize (start);
+  suc.Deserialize (start);
 }
 
 uint32_t 
-GUChordMessage::GetTransactionId (void) const
+GUChordMessage::SnapshotReq::GetSerializedSize (void) const
+{
+  uint32_t size;
+  size = CHORD_ID_SIZE + sizeof(uint32_t) + CHORD_NODE_DESCRIPTOR_SIZE + sizeof(uint32_t) + sizeof(uint8_t);
+  return size;
+}
+
+void
+GUChordMessage::SnapshotReq::Print (std::ostream &os) const
+{
+  os << "SnapshotReq:: Limit: " << limit << " Budget: " << budget << " Initiator: " << initiator
+     << " SnapshotId: " << snapshotId << " StatsOnly: " << statsOnly << "\n";
+}
+
+void
+GUChordMessage::SnapshotReq::Serialize (Buffer::Iterator &start) const
+{
+  uint8_t bytes[CHORD_ID_SIZE];
+  limit.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  start.WriteHtonU32 (budget);
+  initiator.Serialize (start);
+  start.WriteHtonU32 (snapshotId);
+  start.WriteU8 (statsOnly);
+}
+
+uint32_t
+GUChordMessage::SnapshotReq::Deserialize (Buffer::Iterator &start)
+{  
+  uint8_t bytes[CHORD_ID_SIZE];
+  start.Read (bytes, CHORD_ID_SIZE);
+  limit = ChordId::FromBytes (bytes);
+  budget = start.ReadNtohU32 ();
+  initiator.Deserialize (start);
+  snapshotId = start.ReadNtohU32 ();
+  statsOnly = start.ReadU8 () != 0;
+  return SnapshotReq::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetSnapshotReq (const ChordId &limit, uint32_t budget, const ChordNodeDescriptor &initiator, uint32_t snapshotId, bool statsOnly)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = SNAPSHOT_REQ;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == SNAPSHOT_REQ);
+    }
+  m_message.snapshotReq.limit = limit;
+  m_message.snapshotReq.budget = budget;
+  m_message.snapshotReq.initiator = initiator;
+  m_message.snapshotReq.snapshotId = snapshotId;
+  m_message.snapshotReq.statsOnly = statsOnly;
+}
+
+GUChordMessage::SnapshotReq
+GUChordMessage::GetSnapshotReq()
 {
-  return m_transactionId;
+  return m_message.snapshotReq;
 }
 
+/* SNAPSHOT_RSP */
+
+uint32_t 
+GUChordMessage::SnapshotRsp::GetSerializedSize (void) const
+{
+  uint32_t size;
+  size = sizeof(uint32_t) + stats.GetSerializedSize ();
+  return size;
+}
+
+void
+GUChordMessage::SnapshotRsp::Print (std::ostream &os) const
+{
+  os << "SnapshotRsp:: Nodes: " << nodes << "\n";
+}
+
+void
+GUChordMessage::SnapshotRsp::Serialize (Buffer::Iterator &start) const
+{
+  start.WriteHtonU32 (nodes);
+  stats.Serialize (start);
+}
+
+uint32_t
+GUChordMessage::SnapshotRsp::Deserialize (Buffer::Iterator &start)
+{  
+  nodes = start.ReadNtohU32 ();
+  stats.Deserialize (start);
+  return SnapshotRsp::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetSnapshotRsp (uint32_t nodes, const ChordStats &stats)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = SNAPSHOT_RSP;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == SNAPSHOT_RSP);
+    }
+  m_message.snapshotRsp.nodes = nodes;
+  m_message.snapshotRsp.stats = stats;
+}
+
+GUChordMessage::SnapshotRsp
+GUChordMessage::GetSnapshotRsp()
+{
+  return m_message.snapshotRsp;
+}
+
+/* SNAPSHOT_RECORDS */
+
+uint32_t 
+GUChordMessage::SnapshotRecords::GetSerializedSize (void) const
+{
+  uint32_t size;
+  size = sizeof(uint8_t) + records.size () * 3 * CHORD_NODE_DESCRIPTOR_SIZE;
+  return size;
+}
+
+void
+GUChordMessage::SnapshotRecords::Print (std::ostream &os) const
+{
+  os << "SnapshotRecords:: Records: " << records.size () << "\n";
+}
+
+void
+GUChordMessage::SnapshotRecords::Serialize (Buffer::Iterator &start) const
+{
+  start.WriteU8 (records.size ());
+  for (uint32_t i = 0; i < records.size (); i++)
+    {
+      records[i].Serialize (start);
+    }
+}
+
+uint32_t
+GUChordMessage::SnapshotRecords::Deserialize (Buffer::Iterator &start)
+{  
+  uint8_t count = start.ReadU8 ();
+  valid = count <= SNAPSHOT_MAX_RECORDS;
+  records.clear ();
+  if (!valid)
+    {
+      return SnapshotRecords::GetSerializedSize ();
+    }
+  records.resize (count);
+  for (uint32_t i = 0; i < records.size (); i++)
+    {
+      records[i].Deserialize (start);
+    }
+  return SnapshotRecords::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetSnapshotRecords (const std::vector<RingRecord> &records)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = SNAPSHOT_RECORDS;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == SNAPSHOT_RECORDS);
+    }
+  // Callers split records into chunks; larger ones would not fit a datagram
+  NS_ASSERT (records.size () <= SNAPSHOT_MAX_RECORDS);
+  m_message.snapshotRecords.records = records;
+  m_message.snapshotRecords.valid = true;
+}
+
+GUChordMessage::SnapshotRecords
+GUChordMessage::GetSnapshotRecords()
+{
+  return m_message.snapshotRecords;
+}
+
+/* DHASH_REQ */
+
+uint32_t 
+GUChordMessage::DhashReq::GetSerializedSize (void) const
+{
+  uint32_t size;
+  size = sizeof(uint8_t) + CHORD_ID_SIZE + sizeof(uint16_t) + value.length ();
+  return size;
+}
+
+void
+GUChordMessage::DhashReq::Print (std::ostream &os) const
+{
+  os << "DhashReq:: Operation: " << (uint32_t) operation << " Key: " << key << " Value: " << value.length () << " bytes\n";
+}
+
+void
+GUChordMessage::DhashReq::Serialize (Buffer::Iterator &start) const
+{
+  start.WriteU8 (operation);
+  uint8_t bytes[CHORD_ID_SIZE];
+  key.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  NS_ASSERT (value.length () <= 0xFFFF);
+  start.WriteHtonU16 (value.length ());
+  start.Write ((const uint8_t *) value.data (), value.length ());
+}
+
+uint32_t
+GUChordMessage::DhashReq::Deserialize (Buffer::Iterator &start)
+{  
+  operation = start.ReadU8 ();
+  uint8_t bytes[CHORD_ID_SIZE];
+  start.Read (bytes, CHORD_ID_SIZE);
+  key = ChordId::FromBytes (bytes);
+  value.resize (start.ReadNtohU16 ());
+  if (!value.empty ())
+    {
+      start.Read ((uint8_t *) &value[0], value.length ());
+    }
+  return DhashReq::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetDhashReq (uint8_t operation, const ChordId &key, const std::string &value)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = DHASH_REQ;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == DHASH_REQ);
+    }
+  m_message.dhashReq.operation = operation;
+  m_message.dhashReq.key = key;
+  m_message.dhashReq.value = value;
+}
+
+GUChordMessage::DhashReq
+GUChordMessage::GetDhashReq()
+{
+  return m_message.dhashReq;
+}
+
+/* DHASH_RSP */
+
+uint32_t 
+GUChordMessage::DhashRsp::GetSerializedSize (void) const
+{
+  uint32_t size;
+  size = 2 * sizeof(uint8_t) + CHORD_ID_SIZE + sizeof(uint16_t) + value.length ();
+  return size;
+}
+
+void
+GUChordMessage::DhashRsp::Print (std::ostream &os) const
+{
+  os << "DhashRsp:: Operation: " << (uint32_t) operation << " Status: " << (uint32_t) status << " Key: " << key << " Value: " << value.length () << " bytes\n";
+}
+
+void
+GUChordMessage::DhashRsp::Serialize (Buffer::Iterator &start) const
+{
+  start.WriteU8 (operation);
+  start.WriteU8 (status);
+  uint8_t bytes[CHORD_ID_SIZE];
+  key.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  NS_ASSERT (value.length () <= 0xFFFF);
+  start.WriteHtonU16 (value.length ());
+  start.Write ((const uint8_t *) value.data (), value.length ());
+}
+
+uint32_t
+GUChordMessage::DhashRsp::Deserialize (Buffer::Iterator &start)
+{  
+  operation = start.ReadU8 ();
+  status = start.ReadU8 ();
+  uint8_t bytes[CHORD_ID_SIZE];
+  start.Read (bytes, CHORD_ID_SIZE);
+  key = ChordId::FromBytes (bytes);
+  value.resize (start.ReadNtohU16 ());
+  if (!value.empty ())
+    {
+      start.Read ((uint8_t *) &value[0], value.length ());
+    }
+  return DhashRsp::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetDhashRsp (uint8_t operation, uint8_t status, const ChordId &key, const uint8_t *value, uint32_t size)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = DHASH_RSP;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == DHASH_RSP);
+    }
+  m_message.dhashRsp.operation = operation;
+  m_message.dhashRsp.status = status;
+  m_message.dhashRsp.key = key;
+  m_message.dhashRsp.value.clear ();
+  if (size > 0)
+    {
+      m_message.dhashRsp.value.assign ((const char *) value, size);
+    }
+}
+
+GUChordMessage::DhashRsp
+GUChordMessage::GetDhashRsp()
+{
+  return m_message.dhashRsp;
+}
+
+/* MERKLE_REQ */
+
+uint32_t 
+GUChordMessage::MerkleReq::GetSerializedSize (void) const
+{
+  uint32_t size;
+  size = 3 * CHORD_ID_SIZE + sizeof(uint8_t) + sizeof(uint8_t) + digests.size () * CHORD_ID_SIZE;
+  return size;
+}
+
+void
+GUChordMessage::MerkleReq::Print (std::ostream &os) const
+{
+  os << "MerkleReq:: From: " << from << " To: " << to << " Prefix: " << prefix << " Depth: " << (uint32_t) depth << "\n";
+}
+
+void
+GUChordMessage::MerkleReq::Serialize (Buffer::Iterator &start) const
+{
+  uint8_t bytes[CHORD_ID_SIZE];
+  from.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  to.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  prefix.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  start.WriteU8 (depth);
+  start.WriteU8 (digests.size ());
+  for (uint32_t i = 0; i < digests.size (); i++)
+    {
+      digests[i].ToBytes (bytes);
+      start.Write (bytes, CHORD_ID_SIZE);
+    }
+}
+
+uint32_t
+GUChordMessage::MerkleReq::Deserialize (Buffer::Iterator &start)
+{  
+  uint8_t bytes[CHORD_ID_SIZE];
+  start.Read (bytes, CHORD_ID_SIZE);
+  from = ChordId::FromBytes (bytes);
+  start.Read (bytes, CHORD_ID_SIZE);
+  to = ChordId::FromBytes (bytes);
+  start.Read (bytes, CHORD_ID_SIZE);
+  prefix = ChordId::FromBytes (bytes);
+  depth = start.ReadU8 ();
+  digests.resize (start.ReadU8 ());
+  for (uint32_t i = 0; i < digests.size (); i++)
+    {
+      start.Read (bytes, CHORD_ID_SIZE);
+      digests[i] = ChordId::FromBytes (bytes);
+    }
+  return MerkleReq::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetMerkleReq (const ChordId &from, const ChordId &to, const ChordId &prefix, uint8_t depth, const std::vector<ChordId> &digests)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = MERKLE_REQ;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == MERKLE_REQ);
+    }
+  m_message.merkleReq.from = from;
+  m_message.merkleReq.to = to;
+  m_message.merkleReq.prefix = prefix;
+  m_message.merkleReq.depth = depth;
+  m_message.merkleReq.digests = digests;
+}
+
+GUChordMessage::MerkleReq
+GUChordMessage::GetMerkleReq()
+{
+  return m_message.merkleReq;
+}
+
+/* MERKLE_RSP */
+
+uint32_t 
+GUChordMessage::MerkleRsp::GetSerializedSize (void) const
+{
+  uint32_t size;
+  size = 3 * CHORD_ID_SIZE + sizeof(uint8_t) + sizeof(uint16_t);
+  return size;
+}
+
+void
+GUChordMessage::MerkleRsp::Print (std::ostream &os) const
+{
+  os << "MerkleRsp:: Prefix: " << prefix << " Depth: " << (uint32_t) depth << " Mismatches: " << mismatches << "\n";
+}
+
+void
+GUChordMessage::MerkleRsp::Serialize (Buffer::Iterator &start) const
+{
+  uint8_t bytes[CHORD_ID_SIZE];
+  from.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  to.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  prefix.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  start.WriteU8 (depth);
+  start.WriteHtonU16 (mismatches);
+}
+
+uint32_t
+GUChordMessage::MerkleRsp::Deserialize (Buffer::Iterator &start)
+{  
+  uint8_t bytes[CHORD_ID_SIZE];
+  start.Read (bytes, CHORD_ID_SIZE);
+  from = ChordId::FromBytes (bytes);
+  start.Read (bytes, CHORD_ID_SIZE);
+  to = ChordId::FromBytes (bytes);
+  start.Read (bytes, CHORD_ID_SIZE);
+  prefix = ChordId::FromBytes (bytes);
+  depth = start.ReadU8 ();
+  mismatches = start.ReadNtohU16 ();
+  return MerkleRsp::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetMerkleRsp (const ChordId &from, const ChordId &to, const ChordId &prefix, uint8_t depth, uint16_t mismatches)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = MERKLE_RSP;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == MERKLE_RSP);
+    }
+  m_message.merkleRsp.from = from;
+  m_message.merkleRsp.to = to;
+  m_message.merkleRsp.prefix = prefix;
+  m_message.merkleRsp.depth = depth;
+  m_message.merkleRsp.mismatches = mismatches;
+}
+
+GUChordMessage::MerkleRsp
+GUChordMessage::GetMerkleRsp()
+{
+  return m_message.merkleRsp;
+}
+
+/* REPLICA_SYNC */
+
+uint32_t 
+GUChordMessage::ReplicaSync::GetSerializedSize (void) const
+{
+  uint32_t size;
+  size = 3 * CHORD_ID_SIZE + sizeof(uint8_t) + sizeof(uint16_t);
+  for (uint32_t i = 0; i < items.size (); i++)
+    {
+      size += CHORD_ID_SIZE + sizeof(uint16_t) + items[i].value.length ();
+    }
+  return size;
+}
+
+void
+GUChordMessage::ReplicaSync::Print (std::ostream &os) const
+{
+  os << "ReplicaSync:: Prefix: " << prefix << " Depth: " << (uint32_t) depth << " Items: " << items.size () << "\n";
+}
+
+void
+GUChordMessage::ReplicaSync::Serialize (Buffer::Iterator &start) const
+{
+  uint8_t bytes[CHORD_ID_SIZE];
+  from.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  to.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  prefix.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  start.WriteU8 (depth);
+  start.WriteHtonU16 (items.size ());
+  for (uint32_t i = 0; i < items.size (); i++)
+    {
+      items[i].key.ToBytes (bytes);
+      start.Write (bytes, CHORD_ID_SIZE);
+      start.WriteHtonU16 (items[i].value.length ());
+      start.Write ((const uint8_t *) items[i].value.data (), items[i].value.length ());
+    }
+}
+
+uint32_t
+GUChordMessage::ReplicaSync::Deserialize (Buffer::Iterator &start)
+{  
+  uint8_t bytes[CHORD_ID_SIZE];
+  start.Read (bytes, CHORD_ID_SIZE);
+  from = ChordId::FromBytes (bytes);
+  start.Read (bytes, CHORD_ID_SIZE);
+  to = ChordId::FromBytes (bytes);
+  start.Read (bytes, CHORD_ID_SIZE);
+  prefix = ChordId::FromBytes (bytes);
+  depth = start.ReadU8 ();
+  items.resize (start.ReadNtohU16 ());
+  for (uint32_t i = 0; i < items.size (); i++)
+    {
+      start.Read (bytes, CHORD_ID_SIZE);
+      items[i].key = ChordId::FromBytes (bytes);
+      items[i].value.resize (start.ReadNtohU16 ());
+      if (!items[i].value.empty ())
+        {
+          start.Read ((uint8_t *) &items[i].value[0], items[i].value.length ());
+        }
+    }
+  return ReplicaSync::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetReplicaSync (const ChordId &from, const ChordId &to, const ChordId &prefix, uint8_t depth, const std::vector<DhashItem> &items)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = REPLICA_SYNC;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == REPLICA_SYNC);
+    }
+  m_message.replicaSync.from = from;
+  m_message.replicaSync.to = to;
+  m_message.replicaSync.prefix = prefix;
+  m_message.replicaSync.depth = depth;
+  m_message.replicaSync.items = items;
+}
+
+GUChordMessage::ReplicaSync
+GUChordMessage::GetReplicaSync()
+{
+  return m_message.replicaSync;
+}
+
+/* HANDOFF_REQ */
+
+uint32_t 
+GUChordMessage::HandoffReq::GetSerializedSize (void) const
+{
+  uint32_t size;
+  size = 2 * CHORD_ID_SIZE + sizeof(uint32_t) + sizeof(uint16_t);
+  for (uint32_t i = 0; i < items.size (); i++)
+    {
+      size += CHORD_ID_SIZE + sizeof(uint16_t) + items[i].value.length ();
+    }
+  return size;
+}
+
+void
+GUChordMessage::HandoffReq::Print (std::ostream &os) const
+{
+  os << "HandoffReq:: Offset: " << offset << " Items: " << items.size () << "\n";
+}
+
+void
+GUChordMessage::HandoffReq::Serialize (Buffer::Iterator &start) const
+{
+  uint8_t bytes[CHORD_ID_SIZE];
+  from.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  to.ToBytes (bytes);
+  start.Write (bytes, CHORD_ID_SIZE);
+  start.WriteHtonU32 (offset);
+  start.WriteHtonU16 (items.size ());
+  for (uint32_t i = 0; i < items.size (); i++)
+    {
+      items[i].key.ToBytes (bytes);
+      start.Write (bytes, CHORD_ID_SIZE);
+      start.WriteHtonU16 (items[i].value.length ());
+      start.Write ((const uint8_t *) items[i].value.data (), items[i].value.length ());
+    }
+}
+
+uint32_t
+GUChordMessage::HandoffReq::Deserialize (Buffer::Iterator &start)
+{  
+  uint8_t bytes[CHORD_ID_SIZE];
+  start.Read (bytes, CHORD_ID_SIZE);
+  from = ChordId::FromBytes (bytes);
+  start.Read (bytes, CHORD_ID_SIZE);
+  to = ChordId::FromBytes (bytes);
+  offset = start.ReadNtohU32 ();
+  items.resize (start.ReadNtohU16 ());
+  for (uint32_t i = 0; i < items.size (); i++)
+    {
+      start.Read (bytes, CHORD_ID_SIZE);
+      items[i].key = ChordId::FromBytes (bytes);
+      items[i].value.resize (start.ReadNtohU16 ());
+      if (!items[i].value.empty ())
+        {
+          start.Read ((uint8_t *) &items[i].value[0], items[i].value.length ());
+        }
+    }
+  return HandoffReq::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetHandoffReq (const ChordId &from, const ChordId &to, uint32_t offset, const std::vector<DhashItem> &items)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = HANDOFF_REQ;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == HANDOFF_REQ);
+    }
+  m_message.handoffReq.from = from;
+  m_message.handoffReq.to = to;
+  m_message.handoffReq.offset = offset;
+  m_message.handoffReq.items = items;
+}
+
+GUChordMessage::HandoffReq
+GUChordMessage::GetHandoffReq()
+{
+  return m_message.handoffReq;
+}
+
+/* HANDOFF_RSP */
+
+uint32_t 
+GUChordMessage::HandoffRsp::GetSerializedSize (void) const
+{
+  uint32_t size;
+  size = sizeof(uint16_t);
+  return size;
+}
+
+void
+GUChordMessage::HandoffRsp::Print (std::ostream &os) const
+{
+  os << "HandoffRsp:: Stored: " << stored << "\n";
+}
+
+void
+GUChordMessage::HandoffRsp::Serialize (Buffer::Iterator &start) const
+{
+  start.WriteHtonU16 (stored);
+}
+
+uint32_t
+GUChordMessage::HandoffRsp::Deserialize (Buffer::Iterator &start)
+{  
+  stored = start.ReadNtohU16 ();
+  return HandoffRsp::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetHandoffRsp (uint16_t stored)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = HANDOFF_RSP;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == HANDOFF_RSP);
+    }
+  m_message.handoffRsp.stored = stored;
+}
+
+GUChordMessage::HandoffRsp
+GUChordMessage::GetHandoffRsp()
+{
+  return m_message.handoffRsp;
+}
@@ -21,10 +21,27 @@
 #include "ns3/ipv4-address.h"
 #include "ns3/packet.h"
 #include "ns3/object.h"
+#include "ns3/chord-id.h"
+#include "ns3/chord-node-descriptor.h"
+#include "ns3/chord-stats.h"
+
+#include <vector>
 
 using namespace ns3;
 
 #define IPV4_ADDRESS_SIZE 4
+// Ring records per SNAPSHOT_RECORDS datagram, 78 bytes each
+#define SNAPSHOT_MAX_RECORDS 16
+// Largest UDP payload of an IPv4 datagram
+#define CHORD_MAX_DATAGRAM_SIZE 65507
+// Message header and the fields around a single item in the message that
+// carries the most of them, REPLICA_SYNC
+#define DHASH_ITEM_OVERHEAD (sizeof (uint8_t) + sizeof (uint32_t) + 2 * sizeof (uint16_t) \
+                             + 4 * CHORD_ID_SIZE + sizeof (uint8_t) + 2 * sizeof (uint16_t))
+// Largest DHash value: its length is a u16 on the wire, and a message
+// carrying it must fit in one datagram
+#define DHASH_MAX_VALUE_SIZE (CHORD_MAX_DATAGRAM_SIZE - DHASH_ITEM_OVERHEAD < 0xFFFF \
+                              ? CHORD_MAX_DATAGRAM_SIZE - DHASH_ITEM_OVERHEAD : 0xFFFF)
 
 class GUChordMessage : public Header
 {
@@ -44,12 +61,45 @@ class GUChordMessage : public Header
         RINGSTATE = 7,
         NOTIFY_SUC = 8,
         NOTIFY_PRED = 9,
-        DHASH_LOOK = 10, 
+        DHASH_REQ = 10,
         JOIN_REQ = 11,
         JOIN_RSP = 12,
+        LOOKUP_REQ = 13,
+        LOOKUP_RSP = 14,
+        NEXT_HOP_REQ = 15,
+        NEXT_HOP_RSP = 16,
+        SNAPSHOT_REQ = 17,
+        SNAPSHOT_RSP = 18,
+        DHASH_RSP = 19,
+        MERKLE_REQ = 20,
+        MERKLE_RSP = 21,
+        REPLICA_SYNC = 22,
+        HANDOFF_REQ = 23,
+        HANDOFF_RSP = 24,
+        SNAPSHOT_RECORDS = 25,
         // Define extra message types when needed       
       };
 
+    enum DhashOperation
+      {
+        DHASH_PUT = 1,
+        DHASH_GET = 2,
+        DHASH_DELETE = 3,
+        // Owner to replica copies of writes, not answered
+        DHASH_REPLICA_PUT = 4,
+        DHASH_REPLICA_DELETE = 5
+      };
+
+    enum DhashStatus
+      {
+        DHASH_OK = 0,
+        DHASH_NOT_FOUND = 1,
+        // Receiver is not the successor of the key
+        DHASH_NOT_OWNER = 2,
+        // No answer from the ring
+        DHASH_FAILED = 3
+      };
+
     GUChordMessage (GUChordMessage::MessageType messageType, uint32_t transactionId);
 
     /**
@@ -74,12 +124,33 @@ class GUChordMessage : public Header
      */
     uint32_t GetTransactionId () const;
 
+    /**
+     *  \brief Sets the ring positions the message is from and to; all
+     *  positions of a host share its socket, so the UDP ports cannot tell them
+     *  apart
+     *  \param sourcePort Port of the sending position
+     *  \param destinationPort Port of the receiving position
+     */
+    void SetPorts (uint16_t sourcePort, uint16_t destinationPort);
+
+    /**
+     *  \returns Port of the sending ring position
+     */
+    uint16_t GetSourcePort () const;
+
+    /**
+     *  \returns Port of the receiving ring position
+     */
+    uint16_t GetDestinationPort () const;
+
   private:
     /**
      *  \cond
      */
     MessageType m_messageType;
     uint32_t m_transactionId;
+    uint16_t m_sourcePort;
+    uint16_t m_destinationPort;
     /**
      *  \endcond
      */
@@ -117,8 +188,9 @@ class GUChordMessage : public Header
         uint32_t GetSerializedSize (void) const;
         void Serialize (Buffer::Iterator &start) const;
         uint32_t Deserialize (Buffer::Iterator &start);
-        std::string NodeId;
-        std::string HNodeId;
+        // Joining node, and the node it asked to join through
+        ChordNodeDescriptor Node;
+        ChordNodeDescriptor HNode;
       };
     struct FindSucRsp
       {
@@ -126,9 +198,9 @@ class GUChordMessage : public Header
         uint32_t GetSerializedSize (void) const;
         void Serialize (Buffer::Iterator &start) const;
         uint32_t Deserialize (Buffer::Iterator &start);
-        std::string NodeId;
-        std::string SNodeId;
-        std::string PNodeId;
+        ChordNodeDescriptor Node;
+        ChordNodeDescriptor SNode;
+        ChordNodeDescriptor PNode;
       };
     struct GetPredSucReq
       {
@@ -136,7 +208,8 @@ class GUChordMessage : public Header
         uint32_t GetSerializedSize (void) const;
         void Serialize (Buffer::Iterator &start) const;
         uint32_t Deserialize (Buffer::Iterator &start);
-        std::string NodeId;
+        // Stabilizing node, which doubles as a notify to the receiver
+        ChordNodeDescriptor Node;
       };
     struct GetPredSucRsp
       {
@@ -144,7 +217,9 @@ class GUChordMessage : public Header
         uint32_t GetSerializedSize (void) const;
         void Serialize (Buffer::Iterator &start) const;
         uint32_t Deserialize (Buffer::Iterator &start);
-        std::string NodeId;
+        ChordNodeDescriptor PNode;
+        // Responder's successor list, nearest first
+        std::vector<ChordNodeDescriptor> successors;
       };
       struct Ringstate
       {
@@ -152,7 +227,8 @@ class GUChordMessage : public Header
         uint32_t GetSerializedSize (void) const;
         void Serialize (Buffer::Iterator &start) const;
         uint32_t Deserialize (Buffer::Iterator &start);
-        std::string NodeId;
+        // Node that started the walk
+        ChordNodeDescriptor Node;
       };
     struct NotifySuc
       {
@@ -160,7 +236,7 @@ class GUChordMessage : public Header
         uint32_t GetSerializedSize (void) const;
         void Serialize (Buffer::Iterator &start) const;
         uint32_t Deserialize (Buffer::Iterator &start);
-        std::string NodeId;
+        ChordNodeDescriptor Node;
       };
       struct NotifyPred
       {
@@ -168,15 +244,96 @@ class GUChordMessage : public Header
         uint32_t GetSerializedSize (void) const;
         void Serialize (Buffer::Iterator &start) const;
         uint32_t Deserialize (Buffer::Iterator &start);
-        std::string NodeId;
+        ChordNodeDescriptor Node;
       };
-    struct DhashLook
+    struct DhashReq
       {
         void Print (std::ostream &os) const;
         uint32_t GetSerializedSize (void) const;
         void Serialize (Buffer::Iterator &start) const;
         uint32_t Deserialize (Buffer::Iterator &start);
-        std::string pingMessage;
+        uint8_t operation;
+        ChordId key;
+        // Only carried by DHASH_PUT
+        std::string value;
+      };
+    struct DhashRsp
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        uint8_t operation;
+        uint8_t status;
+        ChordId key;
+        // Only carried by a successful DHASH_GET
+        std::string value;
+      };
+    struct DhashItem
+      {
+        ChordId key;
+        std::string value;
+      };
+    // Owner's digests of the children of Merkle node (prefix, depth) over (from, to]
+    struct MerkleReq
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        ChordId from;
+        ChordId to;
+        ChordId prefix;
+        uint8_t depth;
+        std::vector<ChordId> digests;
+      };
+    struct MerkleRsp
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        ChordId from;
+        ChordId to;
+        ChordId prefix;
+        uint8_t depth;
+        // Bit i set when the replica disagrees on child i
+        uint16_t mismatches;
+      };
+    // Owner's items below a Merkle node; the replica drops any others there
+    struct ReplicaSync
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        ChordId from;
+        ChordId to;
+        ChordId prefix;
+        uint8_t depth;
+        std::vector<DhashItem> items;
+      };
+    // Chunk of the items of (from, to] moving to a new owner
+    struct HandoffReq
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        ChordId from;
+        ChordId to;
+        // Position of the first item in the whole transfer
+        uint32_t offset;
+        std::vector<DhashItem> items;
+      };
+    struct HandoffRsp
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        // Items of the chunk the new owner did not have yet
+        uint16_t stored;
       };
       struct JoinReq
       {
@@ -184,7 +341,7 @@ class GUChordMessage : public Header
         uint32_t GetSerializedSize (void) const;
         void Serialize (Buffer::Iterator &start) const;
         uint32_t Deserialize (Buffer::Iterator &start);
-        std::string NodeId;
+        ChordNodeDescriptor Node;
       };
       struct JoinRsp
       {
@@ -192,8 +349,104 @@ class GUChordMessage : public Header
         uint32_t GetSerializedSize (void) const;
         void Serialize (Buffer::Iterator &start) const;
         uint32_t Deserialize (Buffer::Iterator &start);
-        std::string SNodeId;
-        std::string PNodeId;
+        ChordNodeDescriptor SNode;
+        ChordNodeDescriptor PNode;
+      };
+      struct LookupReq
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        // Ring position being looked up
+        ChordId key;
+        // Node the response goes to
+        ChordNodeDescriptor Node;
+        uint8_t hops;
+      };
+      struct LookupRsp
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        ChordId key;
+        // Successor of key
+        ChordNodeDescriptor SNode;
+        // Node that answered, which precedes key
+        ChordNodeDescriptor PNode;
+        uint8_t hops;
+      };
+      struct NextHopReq
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        ChordId key;
+      };
+      struct NextHopRsp
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        ChordId key;
+        // Set when the responder is the predecessor of key
+        uint8_t done;
+        ChordNodeDescriptor SNode;
+        ChordNodeDescriptor PNode;
+        // Otherwise, the responder's closest nodes preceding key
+        std::vector<ChordNodeDescriptor> nodes;
+      };
+      // One node's view of its neighbours in a ring snapshot
+      struct RingRecord
+      {
+        void Serialize (Buffer::Iterator &start) const;
+        void Deserialize (Buffer::Iterator &start);
+        ChordNodeDescriptor node;
+        ChordNodeDescriptor pred;
+        ChordNodeDescriptor suc;
+      };
+      struct SnapshotReq
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        // Receiver covers the ids from itself up to, not including, limit
+        ChordId limit;
+        // Milliseconds the receiver may wait for its subtree
+        uint32_t budget;
+        // Node that started the snapshot and collects the ring records
+        ChordNodeDescriptor initiator;
+        // The initiator's id for the snapshot
+        uint32_t snapshotId;
+        // Set when the initiator wants statistics only, no ring records
+        bool statsOnly;
+      };
+      struct SnapshotRsp
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        // Records the responder's subtree sent to the initiator
+        uint32_t nodes;
+        // Statistics of the responder's subtree, merged
+        ChordStats stats;
+      };
+      // Ring records sent straight to the initiator of a snapshot
+      struct SnapshotRecords
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        // At most SNAPSHOT_MAX_RECORDS
+        std::vector<RingRecord> records;
+        // Not on the wire: false if the sender claimed more records
+        bool valid;
       };
 
 
@@ -209,9 +462,22 @@ class GUChordMessage : public Header
         NotifySuc notifySuc;
         NotifyPred notifyPred;
         Ringstate ringstate;
-        DhashLook dhashLook;
+        DhashReq dhashReq;
+        DhashRsp dhashRsp;
+        MerkleReq merkleReq;
+        MerkleRsp merkleRsp;
+        ReplicaSync replicaSync;
+        HandoffReq handoffReq;
+        HandoffRsp handoffRsp;
         JoinReq joinReq;
         JoinRsp joinRsp;
+        LookupReq lookupReq;
+        LookupRsp lookupRsp;
+        NextHopReq nextHopReq;
+        NextHopRsp nextHopRsp;
+        SnapshotReq snapshotReq;
+        SnapshotRsp snapshotRsp;
+        SnapshotRecords snapshotRecords;
       } m_message;
     
   public:
@@ -238,25 +504,51 @@ class GUChordMessage : public Header
     void SetPingRsp (std::string message);
 
     FindSucReq GetFindSucReq();
-    void SetFindSucReq(std::string,std::string);
+    void SetFindSucReq(const ChordNodeDescriptor &Node, const ChordNodeDescriptor &HNode);
     FindSucRsp GetFindSucRsp();
-    void SetFindSucRsp(std::string,std::string,std::string);
+    void SetFindSucRsp(const ChordNodeDescriptor &Node, const ChordNodeDescriptor &SNode, const ChordNodeDescriptor &PNode);
     GetPredSucReq GetGetPredSucReq();
-    void SetGetPredSucReq(std::string);
+    void SetGetPredSucReq(const ChordNodeDescriptor &Node);
     GetPredSucRsp GetGetPredSucRsp();
-    void SetGetPredSucRsp(std::string);
+    void SetGetPredSucRsp(const ChordNodeDescriptor &PNode, const std::vector<ChordNodeDescriptor> &successors);
     Ringstate GetRingstate();
-    void SetRingstate(std::string);
+    void SetRingstate(const ChordNodeDescriptor &Node);
     NotifySuc GetNotifySuc();
-    void SetNotifySuc(std::string);
+    void SetNotifySuc(const ChordNodeDescriptor &Node);
     NotifyPred GetNotifyPred();
-    void SetNotifyPred(std::string);
-    DhashLook GetDhashLook();
-    void SetDhashLook(std::string);
+    void SetNotifyPred(const ChordNodeDescriptor &Node);
+    DhashReq GetDhashReq();
+    void SetDhashReq(uint8_t operation, const ChordId &key, const std::string &value);
+    DhashRsp GetDhashRsp();
+    void SetDhashRsp(uint8_t operation, uint8_t status, const ChordId &key, const uint8_t *value, uint32_t size);
+    MerkleReq GetMerkleReq();
+    void SetMerkleReq(const ChordId &from, const ChordId &to, const ChordId &prefix, uint8_t depth, const std::vector<ChordId> &digests);
+    MerkleRsp GetMerkleRsp();
+    void SetMerkleRsp(const ChordId &from, const ChordId &to, const ChordId &prefix, uint8_t depth, uint16_t mismatches);
+    ReplicaSync GetReplicaSync();
+    void SetReplicaSync(const ChordId &from, const ChordId &to, const ChordId &prefix, uint8_t depth, const std::vector<DhashItem> &items);
+    HandoffReq GetHandoffReq();
+    void SetHandoffReq(const ChordId &from, const ChordId &to, uint32_t offset, const std::vector<DhashItem> &items);
+    HandoffRsp GetHandoffRsp();
+    void SetHandoffRsp(uint16_t stored);
     JoinReq GetJoinReq();
-    void SetJoinReq(std::string);
+    void SetJoinReq(const ChordNodeDescriptor &Node);
     JoinRsp GetJoinRsp();
-    void SetJoinRsp(std::string,std::string);
+    void SetJoinRsp(const ChordNodeDescriptor &SNode, const ChordNodeDescriptor &PNode);
+    LookupReq GetLookupReq();
+    void SetLookupReq(const ChordId &key, const ChordNodeDescriptor &Node, uint8_t hops);
+    LookupRsp GetLookupRsp();
+    void SetLookupRsp(const ChordId &key, const ChordNodeDescriptor &SNode, const ChordNodeDescriptor &PNode, uint8_t hops);
+    NextHopReq GetNextHopReq();
+    void SetNextHopReq(const ChordId &key);
+    NextHopRsp GetNextHopRsp();
+    void SetNextHopRsp(const ChordId &key, uint8_t done, const ChordNodeDescriptor &SNode, const ChordNodeDescriptor &PNode, const std::vector<ChordNodeDescriptor> &nodes);
+    SnapshotReq GetSnapshotReq();
+    void SetSnapshotReq(const ChordId &limit, uint32_t budget, const ChordNodeDescriptor &initiator, uint32_t snapshotId, bool statsOnly);
+    SnapshotRsp GetSnapshotRsp();
+    void SetSnapshotRsp(uint32_t nodes, const ChordStats &stats);
+    SnapshotRecords GetSnapshotRecords();
+    void SetSnapshotRecords(const std::vector<RingRecord> &records);
 
 
 
@@ -19,6 +19,7 @@
 
 #include "gu-chord.h"
 #include <stdio.h>
+#include <algorithm>
 
 #include "ns3/random-variable.h"
 #include "ns3/inet-socket-address.h"
@@ -36,16 +37,116 @@ GUChord::GetTypeId ()
                    UintegerValue (10001),
                    MakeUintegerAccessor (&GUChord::m_appPort),
                    MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("VirtualNodes",
+                   "Ring positions of this host, all served by one socket on AppPort; AppPort + i only tags position i inside messages",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&GUChord::m_virtualNodes),
+                   MakeUintegerChecker<uint16_t> (1))
     .AddAttribute ("PingTimeout",
                    "Timeout value for PING_REQ in milliseconds",
                    TimeValue (MilliSeconds (2000)),
                    MakeTimeAccessor (&GUChord::m_pingTimeout),
                    MakeTimeChecker ())
+    .AddAttribute ("PingRetries",
+                   "Number of PING_REQ retransmissions before a ping fails",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&GUChord::m_pingRetries),
+                   MakeUintegerChecker<uint8_t> ())
     .AddAttribute ("StabilizeTimeout",
-                   "Timeout value for Stabilization in milliseconds",
+                   "Longest stabilization period in milliseconds, reached while the ring is quiet",
                    TimeValue (MilliSeconds (100000)),
                    MakeTimeAccessor (&GUChord::m_stabilizeTimeout),
                    MakeTimeChecker ())
+    .AddAttribute ("StabilizeMinInterval",
+                   "Stabilization period in milliseconds right after churn",
+                   TimeValue (MilliSeconds (1000)),
+                   MakeTimeAccessor (&GUChord::m_stabilizeMinInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("FixFingersTimeout",
+                   "Interval between finger refreshes in milliseconds",
+                   TimeValue (MilliSeconds (5000)),
+                   MakeTimeAccessor (&GUChord::m_fixFingersTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("LookupTimeout",
+                   "Timeout value for LOOKUP_REQ in milliseconds",
+                   TimeValue (MilliSeconds (2000)),
+                   MakeTimeAccessor (&GUChord::m_lookupTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("SuccessorListSize",
+                   "Number of successors each node keeps for failover",
+                   UintegerValue (4),
+                   MakeUintegerAccessor (&GUChord::m_successorListSize),
+                   MakeUintegerChecker<uint8_t> (1))
+    .AddAttribute ("IterativeLookup",
+                   "Run finger and join lookups iteratively from the originator",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&GUChord::m_iterativeLookup),
+                   MakeBooleanChecker ())
+    .AddAttribute ("LookupAlpha",
+                   "Number of concurrent queries of an iterative lookup",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&GUChord::m_lookupAlpha),
+                   MakeUintegerChecker<uint8_t> (1))
+    .AddAttribute ("LookupHopTimeout",
+                   "Timeout value for each NEXT_HOP_REQ in milliseconds",
+                   TimeValue (MilliSeconds (500)),
+                   MakeTimeAccessor (&GUChord::m_lookupHopTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("LookupHopRetries",
+                   "Number of NEXT_HOP_REQ retransmissions before a node is skipped",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&GUChord::m_lookupHopRetries),
+                   MakeUintegerChecker<uint8_t> ())
+    .AddAttribute ("LocationCacheSize",
+                   "Number of ring ranges cached with their owners, 0 to disable",
+                   UintegerValue (64),
+                   MakeUintegerAccessor (&GUChord::m_locationCacheSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("SnapshotTimeout",
+                   "Time in milliseconds a SNAPSHOT initiator waits for the ring",
+                   TimeValue (MilliSeconds (8000)),
+                   MakeTimeAccessor (&GUChord::m_snapshotTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("ReplicationFactor",
+                   "Number of nodes holding each DHash item, the owner included",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&GUChord::m_replicationFactor),
+                   MakeUintegerChecker<uint8_t> (1))
+    .AddAttribute ("AntiEntropyInterval",
+                   "Period in milliseconds of Merkle comparisons with replicas",
+                   TimeValue (MilliSeconds (30000)),
+                   MakeTimeAccessor (&GUChord::m_antiEntropyInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("BatchWindow",
+                   "Time in milliseconds messages to one peer wait to share a datagram, 0 to send each at once",
+                   TimeValue (MilliSeconds (2)),
+                   MakeTimeAccessor (&GUChord::m_batchWindow),
+                   MakeTimeChecker ())
+    .AddAttribute ("BatchMaxSize",
+                   "Largest datagram in bytes that batched messages are packed into",
+                   UintegerValue (1400),
+                   MakeUintegerAccessor (&GUChord::m_batchMaxSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("HandoffChunkSize",
+                   "Bytes of items per chunk when a key range moves to a new owner, kept below BatchMaxSize",
+                   UintegerValue (1200),
+                   MakeUintegerAccessor (&GUChord::m_handoffChunkSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("HandoffWindow",
+                   "Unacknowledged chunks a key range transfer keeps in flight",
+                   UintegerValue (4),
+                   MakeUintegerAccessor (&GUChord::m_handoffWindow),
+                   MakeUintegerChecker<uint8_t> (1))
+    .AddAttribute ("ProximityFingers",
+                   "Fill each finger with the lowest latency node in its interval",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&GUChord::m_proximityFingers),
+                   MakeBooleanChecker ())
+    .AddAttribute ("ProximityTableSize",
+                   "Number of nodes kept as finger candidates",
+                   UintegerValue (128),
+                   MakeUintegerAccessor (&GUChord::m_proximityTableSize),
+                   MakeUintegerChecker<uint32_t> ())
 /*    .AddAttribute ("AuditFindSuccessorTimeout",
                    "Timeout value for FindSuccessor in milliseconds",
                    TimeValue (MilliSeconds (1000)),
@@ -57,12 +158,23 @@ GUChord::GetTypeId ()
 }
 
 GUChord::GUChord ()
-  : m_auditPingsTimer (Timer::CANCEL_ON_DESTROY), m_stabilizeTimer (Timer::CANCEL_ON_DESTROY)
+  : m_stabilizeTimer (Timer::CANCEL_ON_DESTROY),
+    m_fixFingersTimer (Timer::CANCEL_ON_DESTROY),
+    m_antiEntropyTimer (Timer::CANCEL_ON_DESTROY)
 {
+  m_position = 0;
+  m_nextLookupId = 0;
+  m_nextSnapshotId = 0;
+  m_checkPending = 0;
+  m_checkWrong = 0;
+  m_nextDhashId = 0;
+  m_nextHandoffId = 0;
   RandomVariable random;
   SeedManager::SetSeed (time (NULL));
   random = UniformVariable (0x00000000, 0xFFFFFFFF);
   m_currentTransactionId = random.GetInteger ();
+  m_addressDirectory = Create<NodeAddressDirectory> ();
+  m_sharedDirectory = false;
 }
 
 GUChord::~GUChord ()
@@ -90,17 +202,75 @@ GUChord::StartApplication (void)
     }  
   
   SetChordVerbose(true);
+  // Configure ping tracker
+  m_pingTracker.SetTimeout (m_pingTimeout);
+  m_pingTracker.SetCompletionCallback (MakeCallback (&GUChord::PingCompleted, this));
+  m_pingTracker.SetRetryCallback (MakeCallback (&GUChord::PingRetry, this));
+  // Configure lookup tracker
+  m_lookupTracker.SetTimeout (m_lookupTimeout);
+  m_lookupTracker.SetCompletionCallback (MakeCallback (&GUChord::LookupCompleted, this));
+  // Configure stabilize tracker
+  m_stabilizeTracker.SetTimeout (m_pingTimeout);
+  m_stabilizeTracker.SetCompletionCallback (MakeCallback (&GUChord::StabilizeCompleted, this));
+  m_stabilizeTracker.SetRetryCallback (MakeCallback (&GUChord::StabilizeRetry, this));
+  // Configure iterative lookup query tracker
+  m_queryTracker.SetTimeout (m_lookupHopTimeout);
+  m_queryTracker.SetCompletionCallback (MakeCallback (&GUChord::QueryCompleted, this));
+  m_queryTracker.SetRetryCallback (MakeCallback (&GUChord::QueryRetry, this));
+  // Configure DHash request tracker
+  m_dhashTracker.SetTimeout (m_pingTimeout);
+  m_dhashTracker.SetCompletionCallback (MakeCallback (&GUChord::DhashCompleted, this));
+  m_dhashTracker.SetRetryCallback (MakeCallback (&GUChord::DhashRetry, this));
+  // Configure handoff chunk tracker
+  m_handoffTracker.SetTimeout (m_pingTimeout);
+  m_handoffTracker.SetCompletionCallback (MakeCallback (&GUChord::HandoffCompleted, this));
+  m_handoffTracker.SetRetryCallback (MakeCallback (&GUChord::HandoffRetry, this));
+  m_locations.SetCapacity (m_locationCacheSize);
+  m_proximity.SetCapacity (m_proximityTableSize);
   // Configure timers
-  m_auditPingsTimer.SetFunction (&GUChord::AuditPings, this);
   m_stabilizeTimer.SetFunction(&GUChord::Stabilize, this);
-  // Start timers
-  m_auditPingsTimer.Schedule (m_pingTimeout);
+  m_fixFingersTimer.SetFunction (&GUChord::FixFingers, this);
+  m_antiEntropyTimer.SetFunction (&GUChord::AntiEntropy, this);
+  // Peer ids are shared with the application above when it provides a cache
+  if (m_peers == 0)
+    {
+      m_peers = Create<ChordPeerCache> ();
+      m_peers->SetResolveCallback (MakeCallback (&GUChord::ResolveNodeIpAddress, this));
+    }
+  std::string nodeId = ReverseLookup (m_local);
+  m_positions.assign (m_virtualNodes, RingPosition ());
+  for (uint32_t i = 0; i < m_positions.size (); i++)
+    {
+      RingPosition &position = m_positions[i];
+      if (i == 0)
+        {
+          position.self = ChordNodeDescriptor (m_peers->GetId (nodeId), m_local, m_appPort);
+        }
+      else
+        {
+          // Further positions of the same host hash its node id with their index
+          std::ostringstream name;
+          name << nodeId << "#" << i;
+          position.self = ChordNodeDescriptor (ChordId::Hash (name.str ()), m_local, m_appPort + i);
+        }
+      position.fingers.resize (CHORD_ID_BITS);
+      for (uint32_t j = 0; j < CHORD_ID_BITS; j++)
+        {
+          position.fingers[j].valid = false;
+        }
+      position.nextFinger = 0;
+      position.stabilizeProbe = 0;
+      position.stabilizeInterval = m_stabilizeMinInterval;
+    }
+  SelectPosition (0);
   // m_stabilizeTimer.Schedule(m_stabilizeTimeout);
 }
 
 void
 GUChord::StopApplication (void)
 {
+  // Messages waiting for their batch still go out
+  FlushQueues ();
   // Close socket
   if (m_socket)
     {
@@ -110,20 +280,22 @@ GUChord::StopApplication (void)
     }
 
   // Cancel timers
-  m_auditPingsTimer.Cancel ();
+  m_stabilizeTimer.Cancel ();
+  m_fixFingersTimer.Cancel ();
+  m_antiEntropyTimer.Cancel ();
 
-  m_pingTracker.clear ();
-}
-
-void
-GUChord::hashtostr(unsigned char* hval, std::string &str)
-{
-  char out[61];
-  for (int i = 0; i < 20; i++)
-  {
-    snprintf(out+i*3, 4, "%02x ", hval[i]);
-  }
-  str = out;
+  m_pingTracker.Clear ();
+  m_lookupTracker.Clear ();
+  m_stabilizeTracker.Clear ();
+  m_queryTracker.Clear ();
+  m_lookups.clear ();
+  m_locations.Clear ();
+  m_proximity.Clear ();
+  ClearSnapshots ();
+  m_dhashTracker.Clear ();
+  m_dhashRequests.clear ();
+  ClearHandoffs ();
+  m_store.Clear ();
 }
 
 void 
@@ -132,13 +304,15 @@ GUChord::createChord()
   //m_pred = stoi(g_nodeId);
   //m_suc = stoi(g_nodeId);
   //wwhat else we need?
-  m_stabilizeTimer.Schedule(m_stabilizeTimeout);
   // CHORD_LOG("here1" << std::endl);
-  m_pred = ReverseLookup(m_local);
-  m_suc = ReverseLookup(m_local);
-  SHA1((unsigned char*)m_pred.c_str(), m_pred.size(), m_pred_hash);
-  SHA1((unsigned char*)m_suc.c_str(), m_suc.size(), m_suc_hash);
-  SHA1((unsigned char*)m_suc.c_str(), m_suc.size(), m_my_hash);
+  SetPredecessor(m_position->self);
+  SetSuccessor(m_position->self);
+  InitFingers();
+  ResetStabilize ();
+  m_fixFingersTimer.Cancel ();
+  m_fixFingersTimer.Schedule (m_fixFingersTimeout);
+  m_antiEntropyTimer.Cancel ();
+  m_antiEntropyTimer.Schedule (JitteredInterval (m_antiEntropyInterval));
   // std::cout << "createChord called " << std::endl;
 
 }
@@ -148,65 +322,106 @@ GUChord::joinChord(std::string nodeNumber)
 {
   //send a findSucReq
   //actual joining done in finduscrsp?
-  SHA1((unsigned char*)ReverseLookup(m_local).c_str(), ReverseLookup(m_local).size(), m_my_hash);
-
+  const ChordPeerCache::Peer &peer = m_peers->Lookup (nodeNumber);
+  // Every host runs its first ring position, and its socket, on AppPort
+  ChordNodeDescriptor landmark = ChordNodeDescriptor (peer.id, peer.address, m_appPort);
+  if (m_iterativeLookup)
+    {
+      // Find our own successor through the landmark
+      StartLookup (m_position->self.id, JOIN_LOOKUP, 0, std::vector<ChordNodeDescriptor> (1, landmark));
+      return;
+    }
   uint32_t transactionId = GetNextTransactionId ();
-  Ptr<Packet> packet = Create<Packet> ();
   GUChordMessage message = GUChordMessage (GUChordMessage::JOIN_REQ, transactionId);
-  message.SetJoinReq (ReverseLookup(m_local));
-  packet->AddHeader (message);
-  m_socket->SendTo (packet, 0 , InetSocketAddress (ResolveNodeIpAddress(nodeNumber), m_appPort));
+  message.SetJoinReq (m_position->self);
+  SendMessage (message, landmark);
   // std::cout << "joinChord called" << std::endl;
 }
 
 void
 GUChord::startRingstate()
 {
-
-  std::string my;
-  std::string pre;
-  std::string suc;
-  hashtostr(m_my_hash, my);
-  hashtostr(m_pred_hash, pre);
-  hashtostr(m_suc_hash, suc);
-  CHORD_LOG ("Ringstate<" << my << ">: Pred<" << m_pred << ", " << pre << ">: Succ<" << m_suc << ", " << suc << ">");
+  CHORD_LOG ("Ringstate<" << m_position->self.id << ">: Pred<" << NodeName (m_position->pred) << ", " << m_position->pred.id << ">: Succ<" << NodeName (m_position->suc) << ", " << m_position->suc.id << ">");
   // std::cout <<  "Current NodeId: " << ReverseLookup(m_local) << std::endl;
   // std::cout <<  "Current IpAddress: " << m_local << std::endl;
-  // //std::cout <<  "Current Hash of NodeId: " << m_my_hash << std::endl;//Hash(ReverseLookup(m_local)) << std::endl);
   // std::cout <<  "Predecessor NodeId: " << m_pred << std::endl;
-  // std::cout <<  "Predecessor IpAddress: " << ResolveNodeIpAddress(m_pred) << std::endl;
-  // //std::cout <<  "Predecessor Hash of NodeId: "<< m_pred_hash<< std::endl;//Hash(m_pred) << std::endl);
   // std::cout <<  "Successor NodeId: " << m_suc << std::endl;
-  // std::cout <<  "Successor IpAddress: " << ResolveNodeIpAddress(m_suc) << std::endl;
   uint32_t transactionId = GetNextTransactionId ();
-  Ptr<Packet> packet = Create<Packet> ();
   GUChordMessage message = GUChordMessage (GUChordMessage::RINGSTATE, transactionId);
-  message.SetRingstate (ReverseLookup(m_local));
-  packet->AddHeader (message);
-  m_socket->SendTo (packet, 0 , InetSocketAddress (ResolveNodeIpAddress(m_suc), m_appPort));
+  message.SetRingstate (m_position->self);
+  SendMessage (message, m_position->suc);
 }
 
 void
 GUChord::nodeLeave()
 {
-  // std::cout << "node lave " << std::endl;
-  
-  m_suc = ReverseLookup(m_local);
-  m_pred = ReverseLookup(m_local);
-  memcpy(m_my_hash, m_suc_hash, 20);
-  memcpy(m_my_hash, m_pred_hash, 20);
-  uint32_t transactionId2 = GetNextTransactionId ();
-  Ptr<Packet> packet2 = Create<Packet> ();
-  GUChordMessage message2 = GUChordMessage (GUChordMessage::NOTIFY_PRED, transactionId2);
-  message2.SetNotifyPred (m_suc);
-  packet2->AddHeader (message2);
-  m_socket->SendTo (packet2, 0 , InetSocketAddress (ResolveNodeIpAddress(m_pred), m_appPort));
-  uint32_t transactionId = GetNextTransactionId ();
-  Ptr<Packet> packet = Create<Packet> ();
-  GUChordMessage message = GUChordMessage (GUChordMessage::NOTIFY_SUC, transactionId);
-  message.SetNotifySuc (m_pred);
-  packet->AddHeader (message);
-  m_socket->SendTo (packet, 0 , InetSocketAddress (ResolveNodeIpAddress(m_suc), m_appPort));
+  if (!m_position->suc.IsValid () || m_position->suc == m_position->self)
+    {
+      // Not in a ring, or alone in it
+      return;
+    }
+  // Splice ourselves out: our predecessor takes our successor and vice versa
+  GUChordMessage notifyPred = GUChordMessage (GUChordMessage::NOTIFY_PRED, GetNextTransactionId ());
+  notifyPred.SetNotifyPred (m_position->suc);
+  SendMessage (notifyPred, m_position->pred);
+  GUChordMessage notifySuc = GUChordMessage (GUChordMessage::NOTIFY_SUC, GetNextTransactionId ());
+  notifySuc.SetNotifySuc (m_position->pred);
+  SendMessage (notifySuc, m_position->suc);
+  // Nodes that miss the notifications fail over through their successor lists
+
+  // Our successor takes over our keys
+  StartHandoff (m_position->pred.id, m_position->self.id, m_position->suc, true);
+  bool last = (PositionsInRing () == 1);
+  if (last)
+    {
+      // Replica copies of other ranges go
+      std::vector<DHashStore::Item> copies;
+      m_store.GetItems (m_position->self.id, m_position->pred.id, copies);
+      for (uint32_t i = 0; i < copies.size (); i++)
+        {
+          m_store.Remove (copies[i].key);
+        }
+    }
+  CancelStabilizeProbe ();
+  m_position->suc = ChordNodeDescriptor ();
+  m_position->pred = ChordNodeDescriptor ();
+  m_position->successors.clear ();
+  for (uint32_t i = 0; i < CHORD_ID_BITS; i++)
+    {
+      m_position->fingers[i].valid = false;
+    }
+  if (!last)
+    {
+      // The other positions of the host share the store and trackers and
+      // stay in the ring; only our own lookups go
+      uint32_t position = GetPosition ();
+      std::map<uint32_t, IterativeLookup>::iterator iter = m_lookups.begin ();
+      while (iter != m_lookups.end ())
+        {
+          if (iter->second.position == position)
+            {
+              m_lookups.erase (iter++);
+            }
+          else
+            {
+              iter++;
+            }
+        }
+      return;
+    }
+  m_stabilizeTimer.Cancel ();
+  m_fixFingersTimer.Cancel ();
+  m_antiEntropyTimer.Cancel ();
+  m_stabilizeTracker.Clear ();
+  m_lookupTracker.Clear ();
+  m_queryTracker.Clear ();
+  m_lookups.clear ();
+  m_locations.Clear ();
+  m_proximity.Clear ();
+  ClearSnapshots ();
+  m_dhashTracker.Clear ();
+  m_dhashRequests.clear ();
+  // The store drains as the handoff is acknowledged
 }
 
 void
@@ -214,6 +429,9 @@ GUChord::ProcessCommand (std::vector<std::string> tokens)
 {
   std::vector<std::string>::iterator iterator = tokens.begin();
   std::string command = *iterator;
+  // Requests are issued from the first position; membership commands apply
+  // to every position, the first one (which creates the ring) before the rest
+  SelectPosition (0);
   if(command == "JOIN")
     {
       if(tokens.size() < 2)
@@ -226,13 +444,17 @@ GUChord::ProcessCommand (std::vector<std::string> tokens)
         std::string nodeNumber;
         sin >> nodeNumber;
         iterator++;
-        if(nodeNumber == ReverseLookup(m_local))
-        {
-          createChord();
-        }
-        else
+        for (uint32_t i = 0; i < m_positions.size (); i++)
         {
-          joinChord(nodeNumber);
+          SelectPosition (i);
+          if(nodeNumber == ReverseLookup(m_local) && i == 0)
+          {
+            createChord();
+          }
+          else
+          {
+            joinChord(nodeNumber);
+          }
         }
     }
   else if(command == "LEAVE")
@@ -242,7 +464,11 @@ GUChord::ProcessCommand (std::vector<std::string> tokens)
         ERROR_LOG ("Insufficient Parameters!");
         return;
       }
-      nodeLeave();
+      for (uint32_t i = 0; i < m_positions.size (); i++)
+        {
+          SelectPosition (i);
+          nodeLeave();
+        }
       //current node leaves the chord
     }
   else if(command == "RINGSTATE")
@@ -253,19 +479,93 @@ GUChord::ProcessCommand (std::vector<std::string> tokens)
         return;
       }
       //initiate ring output message
-      startRingstate();
+      for (uint32_t i = 0; i < m_positions.size (); i++)
+        {
+          SelectPosition (i);
+          startRingstate();
+        }
+    }
+  else if(command == "PUT" || command == "GET" || command == "DELETE")
+    {
+      if((command == "PUT" && tokens.size() < 3) || tokens.size() < 2)
+        {
+          ERROR_LOG ("Insufficient Parameters!");
+          return;
+        }
+      uint32_t requestId;
+      if (command == "PUT")
+        {
+          requestId = DhashPut (tokens[1], tokens[2]);
+        }
+      else if (command == "GET")
+        {
+          requestId = DhashGet (tokens[1]);
+        }
+      else
+        {
+          requestId = DhashDelete (tokens[1]);
+        }
+      CHORD_LOG ("DHash " << command << " " << tokens[1] << " started, Request: " << requestId);
+    }
+  else if(command == "SNAPSHOT")
+    {
+      StartSnapshot (false);
+    }
+  else if(command == "CHECK")
+    {
+      // CHECK [keys [seed]]: snapshot, check pointers, then benchmark lookups
+      uint32_t keys = 0;
+      uint64_t seed = 1;
+      if (tokens.size () > 1)
+        {
+          std::istringstream sin (tokens[1]);
+          sin >> keys;
+        }
+      if (tokens.size () > 2)
+        {
+          std::istringstream sin (tokens[2]);
+          sin >> seed;
+        }
+      StartSnapshot (false, true, keys, seed);
+    }
+  else if(command == "STATS")
+    {
+      if (tokens.size () > 1 && tokens[1] == "ALL")
+        {
+          // Network-wide, merged up the snapshot tree
+          StartSnapshot (true);
+        }
+      else if (tokens.size () > 1 && tokens[1] == "RESET")
+        {
+          m_stats.Clear ();
+        }
+      else
+        {
+          std::ostringstream report;
+          m_stats.Print (report);
+          CHORD_LOG ("Stats<" << ReverseLookup (m_local) << ">:\n" << report.str ());
+        }
     }
   else if(command == "INFO")
   {
-    std::cout << "ProcessRingstate" << std::endl;
-    std::cout <<  "Current NodeId: " << ReverseLookup(m_local) << std::endl;
-    std::cout <<  "Current IpAddress: " << m_local << std::endl;
-      //std::cout <<  "Current Hash of NodeId: " << m_my_hash << std::endl;//Hash(ReverseLookup(m_local)) << std::endl);
-    std::cout <<  "Predecessor NodeId: " << m_pred << std::endl;
-    std::cout <<  "Predecessor IpAddress: " << ResolveNodeIpAddress(m_pred) << std::endl;
-      //std::cout <<  "Predecessor Hash of NodeId: "<< m_pred_hash<< std::endl;//Hash(m_pred) << std::endl);
-    std::cout <<  "Successor NodeId: " << m_suc << std::endl;
-    std::cout <<  "Successor IpAddress: " << ResolveNodeIpAddress(m_suc) << std::endl;
+    for (uint32_t i = 0; i < m_positions.size (); i++)
+      {
+        SelectPosition (i);
+        std::cout << "ProcessRingstate" << std::endl;
+        std::cout <<  "Current NodeId: " << NodeName (m_position->self) << std::endl;
+        std::cout <<  "Current IpAddress: " << m_local << std::endl;
+        std::cout <<  "Predecessor NodeId: " << NodeName (m_position->pred) << std::endl;
+        std::cout <<  "Predecessor IpAddress: " << m_position->pred.address << std::endl;
+        std::cout <<  "Successor NodeId: " << NodeName (m_position->suc) << std::endl;
+        std::cout <<  "Successor IpAddress: " << m_position->suc.address << std::endl;
+        std::cout <<  "Successor List:";
+        for (uint32_t j = 0; j < m_position->successors.size (); j++)
+          {
+            std::cout << " " << NodeName (m_position->successors[j]);
+          }
+        std::cout << std::endl;
+        std::cout <<  "Location Cache: " << m_locations.GetSize () << " entries" << std::endl;
+      }
   }
 
 }
@@ -277,14 +577,11 @@ GUChord::SendPing (Ipv4Address destAddress, std::string pingMessage)
     {
       uint32_t transactionId = GetNextTransactionId ();
       CHORD_LOG ("Sending PING_REQ to Node: " << ReverseLookup(destAddress) << " IP: " << destAddress << " Message: " << pingMessage << " transactionId: " << transactionId);
-      Ptr<PingRequest> pingRequest = Create<PingRequest> (transactionId, Simulator::Now(), destAddress, pingMessage);
       // Add to ping-tracker
-      m_pingTracker.insert (std::make_pair (transactionId, pingRequest));
-      Ptr<Packet> packet = Create<Packet> ();
+      m_pingTracker.Track (transactionId, destAddress, pingMessage, m_pingRetries);
       GUChordMessage message = GUChordMessage (GUChordMessage::PING_REQ, transactionId);
       message.SetPingReq (pingMessage);
-      packet->AddHeader (message);
-      m_socket->SendTo (packet, 0 , InetSocketAddress (destAddress, m_appPort));
+      SendMessage (message, destAddress, m_appPort);
     }
   else
     {
@@ -302,11 +599,28 @@ GUChord::RecvMessage (Ptr<Socket> socket)
   Ptr<Packet> packet = socket->RecvFrom (sourceAddr);
   InetSocketAddress inetSocketAddr = InetSocketAddress::ConvertFrom (sourceAddr);
   Ipv4Address sourceAddress = inetSocketAddr.GetIpv4 ();
-  uint16_t sourcePort = inetSocketAddr.GetPort ();
-  //std::cout << "RecvMessage" << std::endl;
-  GUChordMessage message;
-  packet->RemoveHeader (message);
   //std::cout << "RecvMessage" << std::endl;
+  // A datagram carries one or more messages back to back, each naming the
+  // ring positions it is from and to
+  while (packet->GetSize () > 0)
+    {
+      GUChordMessage message;
+      packet->RemoveHeader (message);
+      m_stats.RecordReceived ();
+      uint32_t position = (uint16_t) (message.GetDestinationPort () - m_appPort);
+      if (position >= m_positions.size ())
+        {
+          DEBUG_LOG ("Dropping message to unknown port " << message.GetDestinationPort () << " from Node: " << ReverseLookup (sourceAddress));
+          continue;
+        }
+      SelectPosition (position);
+      ProcessMessage (message, sourceAddress, message.GetSourcePort ());
+    }
+}
+
+void
+GUChord::ProcessMessage (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
   // std::cout << message.GetMessageType() << std::endl;
   switch (message.GetMessageType ())
     {
@@ -343,8 +657,47 @@ GUChord::RecvMessage (Ptr<Socket> socket)
       case GUChordMessage::NOTIFY_PRED:
         ProcessNotifyPred (message, sourceAddress, sourcePort);
         break;
-      case GUChordMessage::DHASH_LOOK:
-        ProcessPingRsp (message, sourceAddress, sourcePort);
+      case GUChordMessage::LOOKUP_REQ:
+        ProcessLookupReq (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::LOOKUP_RSP:
+        ProcessLookupRsp (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::NEXT_HOP_REQ:
+        ProcessNextHopReq (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::NEXT_HOP_RSP:
+        ProcessNextHopRsp (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::SNAPSHOT_REQ:
+        ProcessSnapshotReq (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::SNAPSHOT_RSP:
+        ProcessSnapshotRsp (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::SNAPSHOT_RECORDS:
+        ProcessSnapshotRecords (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::DHASH_REQ:
+        ProcessDhashReq (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::DHASH_RSP:
+        ProcessDhashRsp (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::MERKLE_REQ:
+        ProcessMerkleReq (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::MERKLE_RSP:
+        ProcessMerkleRsp (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::REPLICA_SYNC:
+        ProcessReplicaSync (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::HANDOFF_REQ:
+        ProcessHandoffReq (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::HANDOFF_RSP:
+        ProcessHandoffRsp (message, sourceAddress, sourcePort);
         break;
       default:
         ERROR_LOG ("Unknown Message Type!");
@@ -352,181 +705,116 @@ GUChord::RecvMessage (Ptr<Socket> socket)
     }
 }
 
-bool
-GUChord::CompareHash(unsigned char* hash1, unsigned char* hash2)
+void
+GUChord::ProcessJoinReq(GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
 {
-  // returns true if rhs is bigger and false if lhs is bigger
-
-  for(int i = 0; i < 20; i++)
-  {
-    if(hash1[i]>hash2[i])
-      return true;
-  }
-  return false;
+  CHORD_LOG ("Received JOIN_REQ, From Node: " << ReverseLookup (sourceAddress) << " to node : " << NodeName (message.GetJoinReq().Node));
+  RouteFindSuc (message.GetJoinReq().Node, m_position->self, message.GetTransactionId());
 }
 
 void
-GUChord::ProcessJoinReq(GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+GUChord::ProcessFindSucReq(GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
 {
-  // std::cout << "ProcessJoinReq" << std::endl;
-  std::string fromNode = ReverseLookup (sourceAddress);
-  // std::cout << "From node : " << fromNode << std::endl;
-  Ipv4Address destAddress;
-  GUChordMessage resp;
-  CHORD_LOG ("Received JOIN_REQ, From Node: " << fromNode << " to node : " << message.GetJoinReq().NodeId);
-  if (ReverseLookup(m_local) == m_suc)
-  {
-    resp = GUChordMessage (GUChordMessage::JOIN_RSP, message.GetTransactionId());
-    resp.SetJoinRsp (ReverseLookup (m_local), ReverseLookup (m_local));
-    // std::cout << "ONLY ONE NODE" << std::endl;
-    Ptr<Packet> packet = Create<Packet> ();
-  //std::cout << "ProcessJoinReq" << std::endl;
-  packet->AddHeader (resp);
-  //std::cout << "ProcessJoinReq" << std::endl;
-  m_socket->SendTo (packet, 0 , InetSocketAddress (sourceAddress, sourcePort));
-  return;
-  }
-  else
-  {
-    resp = GUChordMessage (GUChordMessage::FIND_SUC_REQ, message.GetTransactionId());
-    resp.SetFindSucReq (message.GetJoinReq().NodeId, ReverseLookup(m_local));
-    destAddress = ResolveNodeIpAddress(m_suc);
-  }
-  Ptr<Packet> packet = Create<Packet> ();
-  //std::cout << "ProcessJoinReq" << std::endl;
-  packet->AddHeader (resp);
-  //std::cout << "ProcessJoinReq" << std::endl;
-  m_socket->SendTo (packet, 0 , InetSocketAddress (destAddress, m_appPort));
+  CHORD_LOG ("Received FindSucReq, From Node: " << ReverseLookup (sourceAddress) << " for node : " << NodeName (message.GetFindSucReq().Node));
+  RouteFindSuc (message.GetFindSucReq().Node, message.GetFindSucReq().HNode, message.GetTransactionId());
 }
 
 void
-GUChord::ProcessFindSucReq(GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+GUChord::RouteFindSuc (const ChordNodeDescriptor &node, const ChordNodeDescriptor &landmark, uint32_t transactionId)
 {
-  // std::cout << "ProcessFindSucReq" << std::endl;
-  Ipv4Address destAddress;
-  GUChordMessage resp;
-  std::string fromNode = ReverseLookup (sourceAddress);
-  // std::cout << fromNode << std::endl;
-  CHORD_LOG ("Received FindSucReq, From Node: " << fromNode << " for node : " << message.GetFindSucReq().NodeId);
-  unsigned char hash[20];
-  SHA1((unsigned char*)message.GetFindSucReq().NodeId.c_str(), message.GetFindSucReq().NodeId.size(), hash);
-  // std::cout << message.GetFindSucReq().NodeId << "   " << message.GetFindSucReq().HNodeId << "    " << ReverseLookup(m_local) << std::endl;
-  if(memcmp(hash,m_my_hash, 20) == 0)
+  if (!m_position->suc.IsValid ())
+    {
+      DEBUG_LOG ("Not in a ring, dropping join of node: " << NodeName (node));
+      return;
+    }
+  if (node.id == m_position->self.id)
   {
-    // std::cout << "I already exist in the chord" << std::endl;
+    // I already exist in the chord
     return;
   }
-  else if(memcmp(hash, m_my_hash, 20) > 0)
-  {
-    if(memcmp(m_my_hash, m_pred_hash, 20) > 0)
+  if (node.id.InInterval (m_position->self.id, m_position->suc.id, true))
     {
-      resp = GUChordMessage (GUChordMessage::JOIN_RSP, message.GetTransactionId());
-      resp.SetJoinRsp (ReverseLookup(m_local), m_suc);
-      destAddress = ResolveNodeIpAddress(message.GetFindSucReq().NodeId);  
-      m_pred = message.GetFindSucReq().NodeId;
-      // std::cout << "WHERE TO BE" << ReverseLookup(m_local) << "   " << m_pred << "   " << message.GetFindSucReq().NodeId<< std::endl;
+      // We are the joining node's predecessor; it splices itself in with NOTIFY_PRED/NOTIFY_SUC
+      GUChordMessage resp = GUChordMessage (GUChordMessage::JOIN_RSP, transactionId);
+      resp.SetJoinRsp (m_position->suc, m_position->self);
+      SendMessage (resp, node);
     }
-    else
+  else
     {
-      resp = GUChordMessage (GUChordMessage::FIND_SUC_REQ, message.GetTransactionId());
-      resp.SetFindSucReq (message.GetFindSucReq().NodeId, message.GetFindSucReq().HNodeId);
-      destAddress = ResolveNodeIpAddress(m_suc);
-      // std::cout << "GREATER THAN" << std::endl;
+      m_stats.RecordForwarded ();
+      GUChordMessage resp = GUChordMessage (GUChordMessage::FIND_SUC_REQ, transactionId);
+      resp.SetFindSucReq (node, landmark);
+      SendMessage (resp, ClosestPrecedingFinger (node.id));
     }
-  }
-  else
-  {
-    resp = GUChordMessage (GUChordMessage::JOIN_RSP, message.GetTransactionId());
-    resp.SetJoinRsp (ReverseLookup(m_local), m_pred);
-    destAddress = ResolveNodeIpAddress(message.GetFindSucReq().NodeId);
-    m_pred = message.GetFindSucReq().NodeId;
-  
-    SHA1((unsigned char*)m_pred.c_str(), m_pred.size(), m_pred_hash);
-    // std::cout << "LESS THAN" << std::endl;
-    
-  }
-  Ptr<Packet> packet = Create<Packet> ();
-  packet->AddHeader (resp);
-  m_socket->SendTo (packet, 0 , InetSocketAddress (destAddress, m_appPort));
 }
 
 void
 GUChord::ProcessFindSucRsp(GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
 {
   // std::cout << "ProcessFindSucRsp" << std::endl;
-  std::string fromNode = ReverseLookup (sourceAddress);
-  // std::cout << fromNode << std::endl;
-  CHORD_LOG ("Received FindSucRsp, From Node: " << fromNode << " to node : " << message.GetFindSucRsp().NodeId);
+  // std::cout << ReverseLookup (sourceAddress) << std::endl;
+  CHORD_LOG ("Received FindSucRsp, From Node: " << ReverseLookup (sourceAddress) << " to node : " << NodeName (message.GetFindSucRsp().Node));
   GUChordMessage resp = GUChordMessage (GUChordMessage::JOIN_RSP, message.GetTransactionId());
-  resp.SetJoinRsp (message.GetFindSucRsp().SNodeId, message.GetFindSucRsp().PNodeId);
-  Ptr<Packet> packet = Create<Packet> ();
-  packet->AddHeader (resp);
-  m_socket->SendTo (packet, 0 , InetSocketAddress (ResolveNodeIpAddress(message.GetFindSucRsp().NodeId), m_appPort));
+  resp.SetJoinRsp (message.GetFindSucRsp().SNode, message.GetFindSucRsp().PNode);
+  SendMessage (resp, message.GetFindSucRsp().Node);
 }
 
 void
 GUChord::ProcessJoinRsp(GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
 {
-  // std::cout << "ProcessJoinRsp" << std::endl;
-  std::string fromNode = ReverseLookup (sourceAddress);
-  // std::cout << fromNode << std::endl;
-  CHORD_LOG ("Received JOIN_RSP, From Node: " << fromNode << " to node : " << message.GetJoinRsp().SNodeId);
-  //Actually set successor to this one.
-  m_suc = message.GetJoinRsp().SNodeId;
-  m_pred = message.GetJoinRsp().PNodeId;
-  SHA1((unsigned char*)m_pred.c_str(), m_pred.size(), m_pred_hash);
-  SHA1((unsigned char*)m_suc.c_str(), m_suc.size(), m_suc_hash);
-  GUChordMessage resp = GUChordMessage (GUChordMessage::NOTIFY_PRED, message.GetTransactionId());
-  resp.SetNotifyPred(ReverseLookup(m_local));
-  Ptr<Packet> packet = Create<Packet> ();
-  packet->AddHeader (resp);
-  m_socket->SendTo (packet, 0 , InetSocketAddress (ResolveNodeIpAddress(m_pred), m_appPort));
+  CHORD_LOG ("Received JOIN_RSP, From Node: " << ReverseLookup (sourceAddress) << " to node : " << NodeName (message.GetJoinRsp().SNode));
+  CompleteJoin (message.GetJoinRsp().SNode, message.GetJoinRsp().PNode);
+}
+
+void
+GUChord::CompleteJoin (const ChordNodeDescriptor &successor, const ChordNodeDescriptor &predecessor)
+{
+  SetSuccessor (successor);
+  SetPredecessor (predecessor);
+  // Our predecessor takes us as its successor, our successor as its predecessor
+  GUChordMessage notifyPred = GUChordMessage (GUChordMessage::NOTIFY_PRED, GetNextTransactionId ());
+  notifyPred.SetNotifyPred(m_position->self);
+  SendMessage (notifyPred, m_position->pred);
+  GUChordMessage notifySuc = GUChordMessage (GUChordMessage::NOTIFY_SUC, GetNextTransactionId ());
+  notifySuc.SetNotifySuc(m_position->self);
+  SendMessage (notifySuc, m_position->suc);
+  // Fingers start out at the successor and are refined by FixFingers
+  InitFingers ();
+  m_fixFingersTimer.Cancel ();
+  m_fixFingersTimer.Schedule (m_fixFingersTimeout);
+  m_antiEntropyTimer.Cancel ();
+  m_antiEntropyTimer.Schedule (JitteredInterval (m_antiEntropyInterval));
+  // Successor list and failure detection ride on stabilization
+  ResetStabilize ();
 }
 
 void 
 GUChord::ProcessNotifyPred(GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
 {
   // std::cout << "ProcessNotifyPred" << std::endl;
-  std::string fromNode = ReverseLookup (sourceAddress);
-  CHORD_LOG ("Received NOTFY_PRED, From Node: " << fromNode << " to node : " << message.GetNotifyPred().NodeId);
+  CHORD_LOG ("Received NOTFY_PRED, From Node: " << ReverseLookup (sourceAddress) << " to node : " << NodeName (message.GetNotifyPred().Node));
+  // A node joined or left next to us, ranges around it are stale
+  m_locations.Invalidate (message.GetNotifyPred().Node);
   //Actually set successor to this one.
-  unsigned char hash[20];
-  SHA1((unsigned char*)message.GetNotifyPred().NodeId.c_str(), message.GetNotifyPred().NodeId.size(), hash);
-  // if(memcmp(m_suc_hash, hash, 20) > 0 || m_suc.empty())
-  // {
-    m_suc = message.GetNotifyPred().NodeId;
-    SHA1((unsigned char*)m_suc.c_str(), m_suc.size(), m_suc_hash);
-  if(m_pred == ReverseLookup(m_local))
+  SetSuccessor (message.GetNotifyPred().Node);
+  if(m_position->pred == m_position->self)
   {
-    m_pred = message.GetNotifyPred().NodeId;
-    SHA1((unsigned char*)m_pred.c_str(), m_pred.size(), m_pred_hash);
+    SetPredecessor (message.GetNotifyPred().Node);
   }
-  // }
 }
 
 void 
 GUChord::ProcessNotifySuc(GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
 {
   // std::cout << "ProcessNotifySuc" << std::endl;
-  std::string fromNode = ReverseLookup (sourceAddress);
-  CHORD_LOG ("Received NOTFY_SUC, From Node: " << fromNode << " to node : " << message.GetNotifySuc().NodeId);
+  CHORD_LOG ("Received NOTFY_SUC, From Node: " << ReverseLookup (sourceAddress) << " to node : " << NodeName (message.GetNotifySuc().Node));
+  m_locations.Invalidate (message.GetNotifySuc().Node);
   //Actually set successor to this one.
-  unsigned char hash[20];
-  SHA1((unsigned char*)message.GetNotifySuc().NodeId.c_str(), message.GetNotifySuc().NodeId.size(), hash);
-  // if(memcmp(m_pred_hash, hash, 20) < 0 || m_pred.empty())
-  // {
-  // std::cout << "ProcessNotifySuc" << std::endl;
-    m_pred = message.GetNotifySuc().NodeId;
-    SHA1((unsigned char*)m_pred.c_str(), m_pred.size(), m_pred_hash);
-  // }
-    // std::cout << "ProcessNotifySuc" << std::endl;
-    if(m_suc == ReverseLookup(m_local))
+  SetPredecessor (message.GetNotifySuc().Node);
+  if(m_position->suc == m_position->self)
     {
-      //std::cout << "ProcessNotifySuc" << std::endl;
-      m_suc = message.GetNotifySuc().NodeId;
-      SHA1((unsigned char*)m_suc.c_str(), m_suc.size(), m_suc_hash);
+      SetSuccessor (message.GetNotifySuc().Node);
     }
-    // std::cout << "ProcessNotifySuc" << std::endl;
 }
 
 void
@@ -534,46 +822,22 @@ GUChord::ProcessRingstate (GUChordMessage message, Ipv4Address sourceAddress, ui
 {
     // std::cout << "ProcessRingstate" << std::endl;
     // Use reverse lookup for ease of debug
-    std::string fromNode = ReverseLookup (sourceAddress);
-    CHORD_LOG ("Ringstate From Node: " << fromNode << ", At Node: " << message.GetRingstate().NodeId);
-    std::string my;
-  std::string pre;
-  std::string suc;
-  hashtostr(m_my_hash, my);
-  hashtostr(m_pred_hash, pre);
-  hashtostr(m_suc_hash, suc);
-    if(message.GetRingstate().NodeId != ReverseLookup(m_local))
+    CHORD_LOG ("Ringstate From Node: " << ReverseLookup (sourceAddress) << ", At Node: " << NodeName (message.GetRingstate().Node));
+    if(message.GetRingstate().Node != m_position->self)
     {
       // std::cout << "ProcessRingstate" << std::endl;
       // std::cout <<  "Current NodeId: " << ReverseLookup(m_local) << std::endl;
       // std::cout <<  "Current IpAddress: " << m_local << std::endl;
-      // //std::cout <<  "Current Hash of NodeId: " << m_my_hash << std::endl;//Hash(ReverseLookup(m_local)) << std::endl);
       // std::cout <<  "Predecessor NodeId: " << m_pred << std::endl;
-      // std::cout <<  "Predecessor IpAddress: " << ResolveNodeIpAddress(m_pred) << std::endl;
-      // //std::cout <<  "Predecessor Hash of NodeId: "<< m_pred_hash<< std::endl;//Hash(m_pred) << std::endl);
       // std::cout <<  "Successor NodeId: " << m_suc << std::endl;
-      // std::cout <<  "Successor IpAddress: " << ResolveNodeIpAddress(m_suc) << std::endl;
-      // //std::cout <<  "Successor Hash of NodeId: " << m_suc_hash<< std::endl;//Hash(m_suc << std::endl);
-      CHORD_LOG ("Ringstate<" << my << ">: Pred<" << m_pred << ", " << pre << ">: Succ<" << m_suc << ", " << suc << ">");
+      CHORD_LOG ("Ringstate<" << m_position->self.id << ">: Pred<" << NodeName (m_position->pred) << ", " << m_position->pred.id << ">: Succ<" << NodeName (m_position->suc) << ", " << m_position->suc.id << ">");
       GUChordMessage nextRing = GUChordMessage (GUChordMessage::RINGSTATE, message.GetTransactionId());
-      nextRing.SetRingstate (message.GetRingstate().NodeId);
-      Ptr<Packet> packet = Create<Packet> ();
-      packet->AddHeader (nextRing);
-      m_socket->SendTo (packet, 0 , InetSocketAddress (ResolveNodeIpAddress(m_suc), m_appPort));
+      nextRing.SetRingstate (message.GetRingstate().Node);
+      SendMessage (nextRing, m_position->suc);
     }
-    else if (ReverseLookup(m_local) == m_suc)
+    else if (m_position->self == m_position->suc)
     {
-      CHORD_LOG ("Ringstate<" << my << ">: Pred<" << m_pred << ", " << pre << ">: Succ<" << m_suc << ", " << suc << ">");
-      // std::cout << "ProcessRingstate" << std::endl;
-      // std::cout <<  "Current NodeId: " << ReverseLookup(m_local) << std::endl;
-      // std::cout <<  "Current IpAddress: " << m_local << std::endl;
-      // //std::cout <<  "Current Hash of NodeId: " << m_my_hash<< std::endl;//Hash(ReverseLookup(m_local)) << std::endl);
-      // std::cout <<  "Predecessor NodeId: " << m_pred << std::endl;
-      // std::cout <<  "Predecessor IpAddress: " << ResolveNodeIpAddress(m_pred) << std::endl;
-      // //std::cout <<  "Predecessor Hash of NodeId: "<< m_pred_hash <<std::endl;//Hash(m_pred) << std::endl);
-      // std::cout <<  "Successor NodeId: " << m_suc << std::endl;
-      // std::cout <<  "Successor IpAddress: " << ResolveNodeIpAddress(m_suc) << std::endl;
-      // //std::cout <<  "Successor Hash of NodeId: " << m_suc_hash<< std::endl;
+      CHORD_LOG ("Ringstate<" << m_position->self.id << ">: Pred<" << NodeName (m_position->pred) << ", " << m_position->pred.id << ">: Succ<" << NodeName (m_position->suc) << ", " << m_position->suc.id << ">");
     }
     // Send indication to application layer
     // m_pingRecvFn (sourceAddress, message.GetPingReq().pingMessage);
@@ -583,38 +847,73 @@ void
 GUChord::ProcessGetPredSucReq(GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
 {
   // std::cout << "ProcessPredSucReq" << std::endl;
-  std::string fromNode = ReverseLookup (sourceAddress);
-  CHORD_LOG ("Received PredSucReq, From Node: " << fromNode << " to node : " << message.GetGetPredSucReq().NodeId);
+  const ChordNodeDescriptor &caller = message.GetGetPredSucReq().Node;
+  CHORD_LOG ("Received PredSucReq, From Node: " << ReverseLookup (sourceAddress) << " to node : " << NodeName (caller));
+  // The request doubles as the caller's notify: take it as predecessor if it
+  // is closer than ours, or ours has stopped stabilizing with us
+  if (caller == m_position->pred)
+    {
+      m_position->predLastSeen = Simulator::Now ();
+    }
+  else if (!m_position->pred.IsValid () || m_position->pred == m_position->self
+           || caller.id.InInterval (m_position->pred.id, m_position->self.id, false)
+           || Simulator::Now () - m_position->predLastSeen > MilliSeconds (3 * m_stabilizeTimeout.GetMilliSeconds ()))
+    {
+      m_locations.Invalidate (caller);
+      SetPredecessor (caller);
+    }
+  if (m_position->suc == m_position->self)
+    {
+      SetSuccessor (caller);
+    }
+  // Answer with the updated predecessor; the caller is done if it is itself
   GUChordMessage resp = GUChordMessage (GUChordMessage::GET_PRED_SUC_RSP, message.GetTransactionId());
-  resp.SetGetPredSucRsp (m_pred);
-  Ptr<Packet> packet = Create<Packet> ();
-  packet->AddHeader (resp);
-  m_socket->SendTo (packet, 0 , InetSocketAddress (sourceAddress, sourcePort));
+  resp.SetGetPredSucRsp (m_position->pred, m_position->successors);
+  SendMessage (resp, sourceAddress, sourcePort);
 }
 
 void
 GUChord::ProcessGetPredSucRsp(GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
 {
   // std::cout << "ProcessPredSucRsp" << std::endl;
-  std::string fromNode = ReverseLookup (sourceAddress);
-  CHORD_LOG ("Received PredSucRsp, From Node: " << fromNode << " to node : " << message.GetGetPredSucRsp().NodeId);
-  unsigned char hash[20];
-  SHA1((unsigned char*)message.GetGetPredSucRsp().NodeId.c_str(), message.GetGetPredSucRsp().NodeId.size(), hash);
-  if(memcmp(hash,m_my_hash, 20) == 0)
+  const ChordNodeDescriptor &pred = message.GetGetPredSucRsp().PNode;
+  CHORD_LOG ("Received PredSucRsp, From Node: " << ReverseLookup (sourceAddress) << " to node : " << NodeName (pred));
+  const RequestTracker::Request *request = m_stabilizeTracker.Find (message.GetTransactionId ());
+  if (request == 0)
+    {
+      DEBUG_LOG ("Received stale PredSucRsp from Node: " << ReverseLookup (sourceAddress));
+      return;
+    }
+  bool fromSuccessor = (request->destinationAddress == m_position->suc.address && request->destinationPort == m_position->suc.port);
+  SampleRtt (*request);
+  m_stabilizeTracker.Complete (message.GetTransactionId ());
+  if (!fromSuccessor)
+    {
+      // The successor changed while the probe was in flight
+      return;
+    }
+  RefreshSuccessors (message.GetGetPredSucRsp().successors);
+  // Consecutive successors bound the ranges they own
+  for (uint32_t i = 0; i < m_position->successors.size (); i++)
+    {
+      m_proximity.AddNode (m_position->successors[i]);
+      if (i + 1 < m_position->successors.size ())
+        {
+          m_locations.Insert (m_position->successors[i], m_position->successors[i + 1]);
+        }
+    }
+  if (pred == m_position->self)
   {
-    // std::cout << "WORKING!!!" << std::endl;
+    // Our successor took us as its predecessor with the request itself
+    m_position->failedSuccessor = ChordNodeDescriptor ();
     return;
   }
-  else if(memcmp(hash, m_my_hash, 20) > 0)
-  {
-    m_suc = message.GetGetPredSucRsp().NodeId;
-    SHA1((unsigned char*)m_pred.c_str(), m_suc.size(), m_suc_hash);
-    GUChordMessage resp = GUChordMessage (GUChordMessage::NOTIFY_SUC, message.GetTransactionId());
-    resp.SetNotifySuc(ReverseLookup(m_local));
-    Ptr<Packet> packet = Create<Packet> ();
-    packet->AddHeader (resp);
-    m_socket->SendTo (packet, 0 , InetSocketAddress (ResolveNodeIpAddress(m_suc), m_appPort));
-  }
+  if (pred.IsValid () && pred != m_position->failedSuccessor && pred.id.InInterval (m_position->self.id, m_position->suc.id, false))
+    {
+      // A node joined between us and our successor; stabilize with it now
+      SetSuccessor (pred);
+      ProbeSuccessor ();
+    }
 }
 
 void
@@ -622,14 +921,11 @@ GUChord::ProcessPingReq (GUChordMessage message, Ipv4Address sourceAddress, uint
 {
 
     // Use reverse lookup for ease of debug
-    std::string fromNode = ReverseLookup (sourceAddress);
-    CHORD_LOG ("Received PING_REQ, From Node: " << fromNode << ", Message: " << message.GetPingReq().pingMessage);
+    CHORD_LOG ("Received PING_REQ, From Node: " << ReverseLookup (sourceAddress) << ", Message: " << message.GetPingReq().pingMessage);
     // Send Ping Response
     GUChordMessage resp = GUChordMessage (GUChordMessage::PING_RSP, message.GetTransactionId());
     resp.SetPingRsp (message.GetPingReq().pingMessage);
-    Ptr<Packet> packet = Create<Packet> ();
-    packet->AddHeader (resp);
-    m_socket->SendTo (packet, 0 , InetSocketAddress (sourceAddress, sourcePort));
+    SendMessage (resp, sourceAddress, sourcePort);
     // Send indication to application layer
     m_pingRecvFn (sourceAddress, message.GetPingReq().pingMessage);
 }
@@ -638,15 +934,13 @@ void
 GUChord::ProcessPingRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
 {
   // Remove from pingTracker
-  std::map<uint32_t, Ptr<PingRequest> >::iterator iter;
-  iter = m_pingTracker.find (message.GetTransactionId ());
-  if (iter != m_pingTracker.end ())
+  const RequestTracker::Request *request = m_pingTracker.Find (message.GetTransactionId ());
+  if (request != 0)
     {
-      std::string fromNode = ReverseLookup (sourceAddress);
-      CHORD_LOG ("Received PING_RSP, From Node: " << fromNode << ", Message: " << message.GetPingRsp().pingMessage);
-      m_pingTracker.erase (iter);
-      // Send indication to application layer
-      m_pingSuccessFn (sourceAddress, message.GetPingRsp().pingMessage);
+      SampleRtt (*request);
+      CHORD_LOG ("Received PING_RSP, From Node: " << ReverseLookup (sourceAddress) << ", Message: " << message.GetPingRsp().pingMessage);
+      // Indication to application layer is sent from PingCompleted
+      m_pingTracker.Complete (message.GetTransactionId ());
     }
   else
     {
@@ -655,27 +949,27 @@ GUChord::ProcessPingRsp (GUChordMessage message, Ipv4Address sourceAddress, uint
 }
 
 void
-GUChord::AuditPings ()
+GUChord::PingCompleted (const RequestTracker::Request &request, bool success)
 {
-  std::map<uint32_t, Ptr<PingRequest> >::iterator iter;
-  for (iter = m_pingTracker.begin () ; iter != m_pingTracker.end();)
+  // Send indication to application layer
+  if (success)
     {
-      Ptr<PingRequest> pingRequest = iter->second;
-      if (pingRequest->GetTimestamp().GetMilliSeconds() + m_pingTimeout.GetMilliSeconds() <= Simulator::Now().GetMilliSeconds())
-        {
-          DEBUG_LOG ("Ping expired. Message: " << pingRequest->GetPingMessage () << " Timestamp: " << pingRequest->GetTimestamp().GetMilliSeconds () << " CurrentTime: " << Simulator::Now().GetMilliSeconds ());
-          // Remove stale entries
-          m_pingTracker.erase (iter++);
-          // Send indication to application layer
-          m_pingFailureFn (pingRequest->GetDestinationAddress(), pingRequest->GetPingMessage ());
-        }
-      else
-        {
-          ++iter;
-        }
+      m_pingSuccessFn (request.destinationAddress, request.message);
+    }
+  else
+    {
+      DEBUG_LOG ("Ping expired. Message: " << request.message << " Timestamp: " << request.timestamp.GetMilliSeconds () << " CurrentTime: " << Simulator::Now().GetMilliSeconds ());
+      m_pingFailureFn (request.destinationAddress, request.message);
     }
-  // Rechedule timer
-  m_auditPingsTimer.Schedule (m_pingTimeout); 
+}
+
+void
+GUChord::PingRetry (const RequestTracker::Request &request)
+{
+  DEBUG_LOG ("Retrying PING_REQ to Node: " << ReverseLookup (request.destinationAddress) << " Attempt: " << (uint32_t) request.attempts << " transactionId: " << request.transactionId);
+  GUChordMessage message = GUChordMessage (GUChordMessage::PING_REQ, request.transactionId);
+  message.SetPingReq (request.message);
+  SendMessage (message, request.destinationAddress, m_appPort);
 }
 
 uint32_t
@@ -684,6 +978,38 @@ GUChord::GetNextTransactionId ()
   return m_currentTransactionId++;
 }
 
+void
+GUChord::SelectPosition (uint32_t index)
+{
+  m_position = &m_positions[index];
+}
+
+uint32_t
+GUChord::GetPosition () const
+{
+  return m_position - &m_positions[0];
+}
+
+bool
+GUChord::IsLocal (const ChordNodeDescriptor &node)
+{
+  return node.address == m_local && (uint16_t) (node.port - m_appPort) < m_positions.size ();
+}
+
+uint32_t
+GUChord::PositionsInRing ()
+{
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < m_positions.size (); i++)
+    {
+      if (m_positions[i].suc.IsValid ())
+        {
+          count++;
+        }
+    }
+  return count;
+}
+
 void
 GUChord::StopChord ()
 {
@@ -691,42 +1017,2120 @@ GUChord::StopChord ()
 }
 
 void
-GUChord::SetPingSuccessCallback (Callback <void, Ipv4Address, std::string> pingSuccessFn)
+GUChord::SendMessage (GUChordMessage &message, const ChordNodeDescriptor &node)
 {
-  m_pingSuccessFn = pingSuccessFn;
+  SendMessage (message, node.socketAddress);
+}
+
+void
+GUChord::SendMessage (GUChordMessage &message, Ipv4Address address, uint16_t port)
+{
+  SendMessage (message, InetSocketAddress (address, port));
+}
+
+namespace {
+
+bool
+IsResponse (GUChordMessage::MessageType type)
+{
+  switch (type)
+    {
+      case GUChordMessage::PING_RSP:
+      case GUChordMessage::FIND_SUC_RSP:
+      case GUChordMessage::GET_PRED_SUC_RSP:
+      case GUChordMessage::JOIN_RSP:
+      case GUChordMessage::LOOKUP_RSP:
+      case GUChordMessage::NEXT_HOP_RSP:
+      case GUChordMessage::SNAPSHOT_RSP:
+      case GUChordMessage::SNAPSHOT_RECORDS:
+      case GUChordMessage::DHASH_RSP:
+      case GUChordMessage::MERKLE_RSP:
+      case GUChordMessage::HANDOFF_RSP:
+        return true;
+      default:
+        return false;
+    }
 }
 
+}
 
 void
-GUChord::SetPingFailureCallback (Callback <void, Ipv4Address, std::string> pingFailureFn)
+GUChord::SendMessage (GUChordMessage &message, const InetSocketAddress &destination)
 {
-  m_pingFailureFn = pingFailureFn;
+  message.SetPorts (m_position->self.port, destination.GetPort ());
+  if (m_batchWindow.IsZero ())
+    {
+      Ptr<Packet> packet = Create<Packet> ();
+      packet->AddHeader (message);
+      m_socket->SendTo (packet, 0 , InetSocketAddress (destination.GetIpv4 (), m_appPort));
+      return;
+    }
+  uint32_t size = message.GetSerializedSize ();
+  uint32_t key = destination.GetIpv4 ().Get ();
+  std::map<uint32_t, SendQueue>::iterator iter = m_sendQueues.find (key);
+  if (iter != m_sendQueues.end () && iter->second.buffer.GetSize () + size > m_batchMaxSize)
+    {
+      // Full; start a new datagram
+      FlushQueue (key);
+      iter = m_sendQueues.end ();
+    }
+  if (iter == m_sendQueues.end ())
+    {
+      iter = m_sendQueues.insert (std::make_pair (key, SendQueue ())).first;
+      iter->second.flush = Simulator::Schedule (m_batchWindow, &GUChord::FlushQueue, this, key);
+    }
+  // Serialized in place; one packet is made per datagram, at flush time
+  Buffer &buffer = iter->second.buffer;
+  buffer.AddAtEnd (size);
+  Buffer::Iterator end = buffer.End ();
+  end.Prev (size);
+  message.Serialize (end);
+  if (IsResponse (message.GetMessageType ()))
+    {
+      FlushQueue (key);
+      return;
+    }
+  iter->second.transactionIds.push_back (message.GetTransactionId ());
 }
 
 void
-GUChord::SetPingRecvCallback (Callback <void, Ipv4Address, std::string> pingRecvFn)
+GUChord::FlushQueue (uint32_t address)
 {
-  m_pingRecvFn = pingRecvFn;
+  std::map<uint32_t, SendQueue>::iterator iter = m_sendQueues.find (address);
+  if (iter == m_sendQueues.end ())
+    {
+      return;
+    }
+  SendQueue &queue = iter->second;
+  queue.flush.Cancel ();
+  if (m_socket != 0)
+    {
+      Ptr<Packet> packet = Create<Packet> (queue.buffer.PeekData (), queue.buffer.GetSize ());
+      m_socket->SendTo (packet, 0 , InetSocketAddress (Ipv4Address (address), m_appPort));
+    }
+  // Round trips start now, not when the requests were queued; transaction
+  // ids are unique across the trackers
+  RequestTracker *trackers[] = { &m_pingTracker, &m_lookupTracker, &m_stabilizeTracker,
+                                 &m_queryTracker, &m_dhashTracker, &m_handoffTracker };
+  for (uint32_t i = 0; i < queue.transactionIds.size (); i++)
+    {
+      for (uint32_t j = 0; j < sizeof (trackers) / sizeof (trackers[0]); j++)
+        {
+          if (trackers[j]->MarkSent (queue.transactionIds[i]))
+            {
+              break;
+            }
+        }
+    }
+  m_sendQueues.erase (iter);
 }
 
-// void
-// GUChord::SetGUSearchCallback(Callback <void, uint32_t, bool, Ipv4Address> GUsearchFoundKey)
-// {
-//   m_GUsearchFoundKey = GUsearchFoundKey;
-// }
+void
+GUChord::FlushQueues ()
+{
+  while (!m_sendQueues.empty ())
+    {
+      FlushQueue (m_sendQueues.begin ()->first);
+    }
+}
 
 void
-GUChord::Stabilize()
+GUChord::TrackRequest (RequestTracker &tracker, uint32_t transactionId, const ChordNodeDescriptor &node,
+                       uint8_t retries, uint32_t context)
 {
-  // std::cout << "stabilize" << std::endl;
-  CHORD_LOG ("Calling stabilize");
-  uint32_t transactionId = GetNextTransactionId ();
-  GUChordMessage resp = GUChordMessage (GUChordMessage::GET_PRED_SUC_REQ, transactionId);
-  resp.SetGetPredSucReq (ReverseLookup(m_local));
-  Ptr<Packet> packet = Create<Packet> ();
-  packet->AddHeader (resp);
-  m_socket->SendTo (packet, 0 , InetSocketAddress (ResolveNodeIpAddress(m_suc), m_appPort));
-  m_stabilizeTimer.Schedule(m_stabilizeTimeout);
+  tracker.Track (transactionId, node.address, "", retries, context);
+  // Ring positions of one host share its address
+  tracker.SetDestinationPort (transactionId, node.port);
 }
 
+void
+GUChord::SampleRtt (const RequestTracker::Request &request)
+{
+  if (request.attempts == 1)
+    {
+      m_proximity.AddSample (request.destinationAddress, Simulator::Now () - request.lastSent);
+    }
+}
 
+std::string
+GUChord::NodeName (const ChordNodeDescriptor &node)
+{
+  if (!node.IsValid ())
+    {
+      return "-";
+    }
+  if (node.port == m_appPort)
+    {
+      return ReverseLookup (node.address);
+    }
+  // Further ring position of the host, named by its index
+  std::ostringstream name;
+  name << ReverseLookup (node.address) << "#" << (node.port - m_appPort);
+  return name.str ();
+}
+
+void
+GUChord::SetPeerCache (Ptr<ChordPeerCache> peers)
+{
+  m_peers = peers;
+}
+
+Ptr<ChordPeerCache>
+GUChord::GetPeerCache ()
+{
+  return m_peers;
+}
+
+void
+GUChord::SetAddressDirectory (Ptr<NodeAddressDirectory> directory)
+{
+  m_addressDirectory = directory;
+  m_sharedDirectory = true;
+}
+
+void
+GUChord::SetNodeAddressMap (std::map<uint32_t, Ipv4Address> nodeAddressMap)
+{
+  // Fallback for callers without a helper; a shared directory is not ours
+  // to change
+  if (!m_sharedDirectory)
+    {
+      m_addressDirectory->BuildNodes (nodeAddressMap);
+    }
+}
+
+void
+GUChord::SetAddressNodeMap (std::map<Ipv4Address, uint32_t> addressNodeMap)
+{
+  if (!m_sharedDirectory)
+    {
+      m_addressDirectory->BuildAddresses (addressNodeMap);
+    }
+}
+
+Ipv4Address
+GUChord::ResolveNodeIpAddress (std::string nodeId)
+{
+  return m_addressDirectory->Resolve (nodeId);
+}
+
+std::string
+GUChord::ReverseLookup (Ipv4Address ipv4Address)
+{
+  return m_addressDirectory->ReverseLookup (ipv4Address);
+}
+
+const ChordId&
+GUChord::GetRingId () const
+{
+  return m_position->self.id;
+}
+
+uint32_t
+GUChord::CheckRing (const ChordRing &ring)
+{
+  std::vector<ChordId> successors (m_position->successors.size ());
+  for (uint32_t i = 0; i < m_position->successors.size (); i++)
+    {
+      successors[i] = m_position->successors[i].id;
+    }
+  std::ostringstream report;
+  uint32_t errors = ring.CheckNode (m_position->self.id, m_position->pred.id, m_position->suc.id, successors, report);
+  for (uint32_t i = 0; i < CHORD_ID_BITS; i++)
+    {
+      if (m_position->fingers[i].valid && !ring.CheckFinger (m_position->self.id, i, m_position->fingers[i].node.id))
+        {
+          report << m_position->self.id << ": finger " << i << " " << m_position->fingers[i].node.id << "\n";
+          errors++;
+        }
+    }
+  if (errors > 0)
+    {
+      ERROR_LOG ("Ring check found " << errors << " wrong pointers\n" << report.str ());
+    }
+  return errors;
+}
+
+void
+GUChord::SetPingSuccessCallback (Callback <void, Ipv4Address, std::string> pingSuccessFn)
+{
+  m_pingSuccessFn = pingSuccessFn;
+}
+
+
+void
+GUChord::SetPingFailureCallback (Callback <void, Ipv4Address, std::string> pingFailureFn)
+{
+  m_pingFailureFn = pingFailureFn;
+}
+
+void
+GUChord::SetDhashCallback (DhashCallback dhashFn)
+{
+  m_dhashFn = dhashFn;
+}
+
+void
+GUChord::SetPingRecvCallback (Callback <void, Ipv4Address, std::string> pingRecvFn)
+{
+  m_pingRecvFn = pingRecvFn;
+}
+
+// void
+// GUChord::SetGUSearchCallback(Callback <void, uint32_t, bool, Ipv4Address> GUsearchFoundKey)
+// {
+//   m_GUsearchFoundKey = GUsearchFoundKey;
+// }
+
+void
+GUChord::Stabilize()
+{
+  // std::cout << "stabilize" << std::endl;
+  CHORD_LOG ("Calling stabilize");
+  for (uint32_t i = 0; i < m_positions.size (); i++)
+    {
+      SelectPosition (i);
+      RingPosition &position = *m_position;
+      if (!position.suc.IsValid () || position.nextStabilize > Simulator::Now ())
+        {
+          continue;
+        }
+      ProbeSuccessor ();
+      position.nextStabilize = Simulator::Now () + JitteredInterval (position.stabilizeInterval);
+      // Back off while nothing changes around this position
+      position.stabilizeInterval = MilliSeconds (2 * position.stabilizeInterval.GetMilliSeconds ());
+      if (position.stabilizeInterval > m_stabilizeTimeout)
+        {
+          position.stabilizeInterval = m_stabilizeTimeout;
+        }
+    }
+  ScheduleStabilize ();
+}
+
+void
+GUChord::ScheduleStabilize ()
+{
+  m_stabilizeTimer.Cancel ();
+  bool due = false;
+  Time next;
+  for (uint32_t i = 0; i < m_positions.size (); i++)
+    {
+      if (m_positions[i].suc.IsValid () && (!due || m_positions[i].nextStabilize < next))
+        {
+          next = m_positions[i].nextStabilize;
+          due = true;
+        }
+    }
+  if (due)
+    {
+      m_stabilizeTimer.Schedule (next > Simulator::Now () ? next - Simulator::Now () : Time ());
+    }
+}
+
+void
+GUChord::ProbeSuccessor ()
+{
+  // At most one probe at a time; a short period must not stack them up
+  const RequestTracker::Request *probe = m_stabilizeTracker.Find (m_position->stabilizeProbe);
+  if (probe != 0 && probe->context == GetPosition ())
+    {
+      return;
+    }
+  uint32_t transactionId = GetNextTransactionId ();
+  m_position->stabilizeProbe = transactionId;
+  TrackRequest (m_stabilizeTracker, transactionId, m_position->suc, m_pingRetries, GetPosition ());
+  GUChordMessage resp = GUChordMessage (GUChordMessage::GET_PRED_SUC_REQ, transactionId);
+  resp.SetGetPredSucReq (m_position->self);
+  SendMessage (resp, m_position->suc);
+}
+
+void
+GUChord::CancelStabilizeProbe ()
+{
+  const RequestTracker::Request *probe = m_stabilizeTracker.Find (m_position->stabilizeProbe);
+  if (probe != 0 && probe->context == GetPosition ())
+    {
+      m_stabilizeTracker.Cancel (m_position->stabilizeProbe);
+    }
+}
+
+void
+GUChord::ResetStabilize ()
+{
+  m_position->stabilizeInterval = m_stabilizeMinInterval;
+  m_position->nextStabilize = Simulator::Now () + JitteredInterval (m_stabilizeMinInterval);
+  ScheduleStabilize ();
+}
+
+void
+GUChord::ChurnObserved ()
+{
+  if (m_position->nextStabilize > Simulator::Now () + m_stabilizeMinInterval)
+    {
+      // Probe soon instead of at the end of a long quiet period
+      ResetStabilize ();
+      return;
+    }
+  m_position->stabilizeInterval = m_stabilizeMinInterval;
+}
+
+Time
+GUChord::JitteredInterval (Time interval)
+{
+  // Desynchronize stabilization of nodes that joined together
+  UniformVariable jitter (0.75, 1.25);
+  return MilliSeconds ((uint64_t) (interval.GetMilliSeconds () * jitter.GetValue ()));
+}
+
+void
+GUChord::StabilizeRetry (const RequestTracker::Request &request)
+{
+  DEBUG_LOG ("Retrying PredSucReq to Node: " << ReverseLookup (request.destinationAddress) << " Attempt: " << (uint32_t) request.attempts);
+  // A lost probe hints at churn; the retry itself is already the next probe
+  SelectPosition (request.context);
+  m_position->stabilizeInterval = m_stabilizeMinInterval;
+  GUChordMessage message = GUChordMessage (GUChordMessage::GET_PRED_SUC_REQ, request.transactionId);
+  message.SetGetPredSucReq (m_position->self);
+  // To the node the probe was for, which the answer is checked against
+  SendMessage (message, request.destinationAddress, request.destinationPort);
+}
+
+void
+GUChord::StabilizeCompleted (const RequestTracker::Request &request, bool success)
+{
+  SelectPosition (request.context);
+  if (!success && request.destinationAddress == m_position->suc.address && request.destinationPort == m_position->suc.port)
+    {
+      SuccessorFailed ();
+    }
+}
+
+void
+GUChord::SuccessorFailed ()
+{
+  ChordNodeDescriptor failed = m_position->suc;
+  ERROR_LOG ("Successor " << NodeName (failed) << " stopped responding");
+  m_locations.Invalidate (failed);
+  // Our next successor still names it as predecessor until it times out
+  m_position->failedSuccessor = failed;
+  m_proximity.RemoveNode (failed);
+  for (uint32_t i = 0; i < CHORD_ID_BITS; i++)
+    {
+      if (m_position->fingers[i].node == failed)
+        {
+          m_position->fingers[i].valid = false;
+        }
+    }
+  if (!m_position->successors.empty () && m_position->successors[0] == failed)
+    {
+      m_position->successors.erase (m_position->successors.begin ());
+    }
+  if (m_position->successors.empty ())
+    {
+      ERROR_LOG ("Successor list exhausted, node is alone in the ring");
+      SetSuccessor (m_position->self);
+      return;
+    }
+  SetSuccessor (m_position->successors[0]);
+  // Tell the new successor about us right away instead of waiting a period
+  ProbeSuccessor ();
+}
+
+
+
+
+void
+GUChord::SetSuccessor (const ChordNodeDescriptor &node)
+{
+  if (node == m_position->self)
+    {
+      m_position->successors.clear ();
+    }
+  else
+    {
+      std::vector<ChordNodeDescriptor>::iterator iter = std::find (m_position->successors.begin (), m_position->successors.end (), node);
+      if (iter != m_position->successors.end ())
+        {
+          m_position->successors.erase (m_position->successors.begin (), iter);
+        }
+      else
+        {
+          m_position->successors.insert (m_position->successors.begin (), node);
+          if (m_position->successors.size () > m_successorListSize)
+            {
+              m_position->successors.resize (m_successorListSize);
+            }
+        }
+    }
+  if (node != m_position->suc)
+    {
+      ChurnObserved ();
+      // A probe of the old successor would hold off probing the new one
+      CancelStabilizeProbe ();
+    }
+  m_position->suc = node;
+  // The first finger is always the successor
+  m_position->fingers[0].node = m_position->suc;
+  m_position->fingers[0].valid = true;
+}
+
+void
+GUChord::RefreshSuccessors (const std::vector<ChordNodeDescriptor> &successors)
+{
+  if (m_position->suc == m_position->self)
+    {
+      m_position->successors.clear ();
+      return;
+    }
+  std::vector<ChordNodeDescriptor> refreshed;
+  refreshed.push_back (m_position->suc);
+  for (uint32_t i = 0; i < successors.size () && refreshed.size () < m_successorListSize; i++)
+    {
+      // Small rings wrap around to us
+      if (successors[i] == m_position->self)
+        {
+          break;
+        }
+      if (std::find (refreshed.begin (), refreshed.end (), successors[i]) == refreshed.end ())
+        {
+          refreshed.push_back (successors[i]);
+        }
+    }
+  m_position->successors = refreshed;
+}
+
+void
+GUChord::SetPredecessor (const ChordNodeDescriptor &node)
+{
+  if (node != m_position->pred)
+    {
+      ChurnObserved ();
+      if (node.IsValid () && m_position->pred.IsValid () && node != m_position->self
+          && node.id.InInterval (m_position->pred.id, m_position->self.id, false))
+        {
+          // The new node took over (old predecessor, node] from us; we stay
+          // its first replica unless there are none
+          StartHandoff (m_position->pred.id, node.id, node, m_replicationFactor <= 1);
+        }
+    }
+  m_position->pred = node;
+  m_position->predLastSeen = Simulator::Now ();
+}
+
+void
+GUChord::InitFingers ()
+{
+  for (uint32_t i = 0; i < CHORD_ID_BITS; i++)
+    {
+      m_position->fingers[i].node = m_position->suc;
+      m_position->fingers[i].valid = true;
+    }
+  m_position->nextFinger = 1;
+}
+
+uint32_t
+GUChord::UpdateFingers (uint32_t index, const ChordNodeDescriptor &node)
+{
+  uint32_t next = index;
+  do
+    {
+      m_position->fingers[next].node = node;
+      m_position->fingers[next].valid = true;
+      next++;
+    }
+  while (next < CHORD_ID_BITS && m_position->self.id.AddPowerOfTwo (next).InInterval (m_position->self.id, node.id, true));
+  return next;
+}
+
+ChordNodeDescriptor
+GUChord::ClosestPrecedingFinger (const ChordId &key)
+{
+  for (int i = CHORD_ID_BITS - 1; i >= 0; i--)
+    {
+      if (m_position->fingers[i].valid && m_position->fingers[i].node.id.InInterval (m_position->self.id, key, false))
+        {
+          return m_position->fingers[i].node;
+        }
+    }
+  return m_position->suc;
+}
+
+void
+GUChord::FixFingers ()
+{
+  m_fixFingersTimer.Schedule (m_fixFingersTimeout);
+  for (uint32_t i = 0; i < m_positions.size (); i++)
+    {
+      SelectPosition (i);
+      if (m_position->suc.IsValid ())
+        {
+          FixNextFinger ();
+        }
+    }
+}
+
+void
+GUChord::FixNextFinger ()
+{
+  // Finger 0 is the successor, kept current by stabilization
+  if (m_position->nextFinger == 0)
+    {
+      m_position->nextFinger = 1;
+    }
+  uint32_t index = m_position->nextFinger;
+  ChordId start = m_position->self.id.AddPowerOfTwo (index);
+  if (start.InInterval (m_position->self.id, m_position->suc.id, true))
+    {
+      m_position->nextFinger = UpdateFingers (index, m_position->suc) % CHORD_ID_BITS;
+      return;
+    }
+  m_position->nextFinger = (index + 1) % CHORD_ID_BITS;
+
+  if (m_iterativeLookup)
+    {
+      StartLookup (start, FINGER_LOOKUP, index, ClosestPrecedingNodes (start, m_lookupAlpha));
+      return;
+    }
+  uint32_t transactionId = GetNextTransactionId ();
+  m_lookupTracker.Track (transactionId, m_local, start.ToString (), 0, index);
+  GUChordMessage message = GUChordMessage (GUChordMessage::LOOKUP_REQ, transactionId);
+  message.SetLookupReq (start, m_position->self, 0);
+  SendMessage (message, ClosestPrecedingFinger (start));
+}
+
+void
+GUChord::ProcessLookupReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  GUChordMessage::LookupReq lookup = message.GetLookupReq ();
+  if (!m_position->suc.IsValid () || lookup.hops == 0xFF)
+    {
+      DEBUG_LOG ("Dropping LOOKUP_REQ from Node: " << ReverseLookup (sourceAddress));
+      return;
+    }
+  if (lookup.key.InInterval (m_position->self.id, m_position->suc.id, true))
+    {
+      // Our successor owns the key: answer the originator directly
+      GUChordMessage resp = GUChordMessage (GUChordMessage::LOOKUP_RSP, message.GetTransactionId());
+      resp.SetLookupRsp (lookup.key, m_position->suc, m_position->self, lookup.hops + 1);
+      SendMessage (resp, lookup.Node);
+    }
+  else
+    {
+      m_stats.RecordForwarded ();
+      ChordNodeDescriptor next = ClosestPrecedingFinger (lookup.key);
+      ChordLocationCache::Entry cached;
+      if (m_locations.Lookup (lookup.key, cached) && cached.predecessor != m_position->self
+          && cached.predecessor.id.InInterval (next.id, lookup.key, false))
+        {
+          // A cached predecessor of key is closer than any finger; if the
+          // entry is stale it still precedes key and routes on from there
+          next = cached.predecessor;
+        }
+      GUChordMessage resp = GUChordMessage (GUChordMessage::LOOKUP_REQ, message.GetTransactionId());
+      resp.SetLookupReq (lookup.key, lookup.Node, lookup.hops + 1);
+      SendMessage (resp, next);
+    }
+}
+
+void
+GUChord::ProcessLookupRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  const RequestTracker::Request *request = m_lookupTracker.Find (message.GetTransactionId ());
+  if (request == 0)
+    {
+      DEBUG_LOG ("Received invalid LOOKUP_RSP!");
+      return;
+    }
+  GUChordMessage::LookupRsp lookup = message.GetLookupRsp ();
+  uint32_t index = request->context;
+  CHORD_LOG ("Received LOOKUP_RSP, From Node: " << ReverseLookup (sourceAddress) << " Finger: " << index << " Node: " << NodeName (lookup.SNode) << " Hops: " << (uint32_t) lookup.hops);
+  m_stats.RecordLookup (lookup.hops, Simulator::Now () - request->timestamp);
+  m_locations.Insert (lookup.PNode, lookup.SNode);
+  m_proximity.AddNode (lookup.PNode);
+  FingerFound (index, lookup.SNode);
+  m_lookupTracker.Complete (message.GetTransactionId ());
+}
+
+void
+GUChord::FingerFound (uint32_t index, const ChordNodeDescriptor &node)
+{
+  ChordNodeDescriptor chosen = node;
+  if (m_proximityFingers)
+    {
+      // Any node in [start, end) serves the finger; prefer the nearest one
+      ChordId start = m_position->self.id.AddPowerOfTwo (index);
+      ChordId end = (index + 1 < CHORD_ID_BITS) ? m_position->self.id.AddPowerOfTwo (index + 1) : m_position->self.id;
+      if (node.id == start || node.id.InInterval (start, end, false))
+        {
+          chosen = m_proximity.SelectNearest (start, end, node);
+        }
+    }
+  uint32_t next = UpdateFingers (index, chosen);
+  // Skip the fingers this answer already covered
+  if (m_position->nextFinger > index && m_position->nextFinger < next)
+    {
+      m_position->nextFinger = next % CHORD_ID_BITS;
+    }
+}
+
+void
+GUChord::LookupCompleted (const RequestTracker::Request &request, bool success)
+{
+  if (!success)
+    {
+      m_stats.RecordTimeout ();
+      m_stats.RecordLookupFailure ();
+      DEBUG_LOG ("Finger lookup expired. Finger: " << request.context << " Timestamp: " << request.timestamp.GetMilliSeconds () << " CurrentTime: " << Simulator::Now().GetMilliSeconds ());
+    }
+}
+
+/*
+ * Iterative lookups
+ */
+
+namespace {
+
+// Orders nodes by how closely they precede key
+struct CloserToKey
+{
+  CloserToKey (const ChordId &key)
+    : m_key (key)
+  {
+  }
+  bool operator() (const ChordNodeDescriptor &a, const ChordNodeDescriptor &b) const
+  {
+    return a.id.Distance (m_key) < b.id.Distance (m_key);
+  }
+  ChordId m_key;
+};
+
+}
+
+std::vector<ChordNodeDescriptor>
+GUChord::ClosestPrecedingNodes (const ChordId &key, uint32_t count)
+{
+  std::vector<ChordNodeDescriptor> nodes;
+  for (int i = CHORD_ID_BITS - 1; i >= 0 && nodes.size () < count; i--)
+    {
+      const Finger &finger = m_position->fingers[i];
+      if (finger.valid && finger.node.id.InInterval (m_position->self.id, key, false)
+          && std::find (nodes.begin (), nodes.end (), finger.node) == nodes.end ())
+        {
+          nodes.push_back (finger.node);
+        }
+    }
+  for (uint32_t i = 0; i < m_position->successors.size () && nodes.size () < count; i++)
+    {
+      if (m_position->successors[i].id.InInterval (m_position->self.id, key, false)
+          && std::find (nodes.begin (), nodes.end (), m_position->successors[i]) == nodes.end ())
+        {
+          nodes.push_back (m_position->successors[i]);
+        }
+    }
+  std::sort (nodes.begin (), nodes.end (), CloserToKey (key));
+  if (nodes.empty () && m_position->suc.IsValid ())
+    {
+      nodes.push_back (m_position->suc);
+    }
+  return nodes;
+}
+
+void
+GUChord::StartLookup (const ChordId &key, LookupPurpose purpose, uint32_t context,
+                      const std::vector<ChordNodeDescriptor> &nodes)
+{
+  uint32_t lookupId = m_nextLookupId++;
+  IterativeLookup &lookup = m_lookups[lookupId];
+  lookup.position = GetPosition ();
+  lookup.key = key;
+  lookup.purpose = purpose;
+  lookup.context = context;
+  lookup.inFlight = 0;
+  lookup.hops = 0;
+  lookup.started = Simulator::Now ();
+  AddCandidates (lookup, nodes, 0);
+  ChordLocationCache::Entry cached;
+  if (m_locations.Lookup (key, cached) && cached.predecessor != m_position->self)
+    {
+      // A live cached predecessor answers in one hop
+      lookup.cachedPredecessor = cached.predecessor;
+      std::vector<ChordNodeDescriptor>::iterator iter =
+        std::find (lookup.candidates.begin (), lookup.candidates.end (), cached.predecessor);
+      if (iter != lookup.candidates.end ())
+        {
+          lookup.candidates.erase (iter);
+        }
+      lookup.candidates.insert (lookup.candidates.begin (), cached.predecessor);
+      lookup.depths[cached.predecessor.id] = 0;
+    }
+  DispatchQueries (lookupId);
+}
+
+void
+GUChord::AddCandidates (IterativeLookup &lookup, const std::vector<ChordNodeDescriptor> &nodes, uint8_t depth)
+{
+  for (uint32_t i = 0; i < nodes.size (); i++)
+    {
+      const ChordNodeDescriptor &node = nodes[i];
+      if (!node.IsValid () || node == m_position->self || lookup.queried.count (node.id) > 0
+          || std::find (lookup.candidates.begin (), lookup.candidates.end (), node) != lookup.candidates.end ())
+        {
+          continue;
+        }
+      lookup.candidates.push_back (node);
+      lookup.depths[node.id] = depth;
+    }
+  std::sort (lookup.candidates.begin (), lookup.candidates.end (), CloserToKey (lookup.key));
+}
+
+void
+GUChord::DispatchQueries (uint32_t lookupId)
+{
+  std::map<uint32_t, IterativeLookup>::iterator iter = m_lookups.find (lookupId);
+  if (iter == m_lookups.end ())
+    {
+      return;
+    }
+  IterativeLookup &lookup = iter->second;
+  SelectPosition (lookup.position);
+  while (lookup.inFlight < m_lookupAlpha && !lookup.candidates.empty ())
+    {
+      ChordNodeDescriptor node = lookup.candidates.front ();
+      lookup.candidates.erase (lookup.candidates.begin ());
+      lookup.queried.insert (node.id);
+      uint32_t transactionId = GetNextTransactionId ();
+      TrackRequest (m_queryTracker, transactionId, node, m_lookupHopRetries, lookupId);
+      lookup.queryDepths[transactionId] = lookup.depths[node.id];
+      GUChordMessage message = GUChordMessage (GUChordMessage::NEXT_HOP_REQ, transactionId);
+      message.SetNextHopReq (lookup.key);
+      SendMessage (message, node);
+      lookup.inFlight++;
+    }
+  if (lookup.inFlight == 0)
+    {
+      FinishLookup (lookupId, false, ChordNodeDescriptor (), ChordNodeDescriptor ());
+    }
+}
+
+void
+GUChord::FinishLookup (uint32_t lookupId, bool success, const ChordNodeDescriptor &successor,
+                       const ChordNodeDescriptor &predecessor)
+{
+  std::map<uint32_t, IterativeLookup>::iterator iter = m_lookups.find (lookupId);
+  if (iter == m_lookups.end ())
+    {
+      return;
+    }
+  // Queries still in flight are ignored once the lookup is gone
+  IterativeLookup lookup = iter->second;
+  m_lookups.erase (iter);
+  SelectPosition (lookup.position);
+  if (success)
+    {
+      m_stats.RecordLookup (lookup.hops, Simulator::Now () - lookup.started);
+    }
+  else
+    {
+      m_stats.RecordLookupFailure ();
+      DEBUG_LOG ("Iterative lookup failed after " << (uint32_t) lookup.hops << " hops, Key: " << lookup.key);
+      if (lookup.purpose == JOIN_LOOKUP)
+        {
+          ERROR_LOG ("Join failed, no node answered for our position on the ring");
+        }
+      if (lookup.purpose == DHASH_LOOKUP)
+        {
+          DHashStore::Value empty = { 0, 0 };
+          CompleteDhash (lookup.context, GUChordMessage::DHASH_FAILED, empty);
+        }
+      if (lookup.purpose == CHECK_LOOKUP)
+        {
+          CheckLookupDone (lookup.context, false, ChordNodeDescriptor ());
+        }
+      return;
+    }
+  CHORD_LOG ("Iterative lookup done, Node: " << NodeName (successor) << " Hops: " << (uint32_t) lookup.hops);
+  m_locations.Insert (predecessor, successor);
+  m_proximity.AddNode (predecessor);
+  m_proximity.AddNode (successor);
+  switch (lookup.purpose)
+    {
+      case FINGER_LOOKUP:
+        FingerFound (lookup.context, successor);
+        break;
+      case JOIN_LOOKUP:
+        CompleteJoin (successor, predecessor);
+        break;
+      case DHASH_LOOKUP:
+        if (lookup.successors.empty () || lookup.successors[0] != successor)
+          {
+            lookup.successors.insert (lookup.successors.begin (), successor);
+          }
+        DispatchDhash (lookup.context, lookup.successors);
+        break;
+      case CHECK_LOOKUP:
+        CheckLookupDone (lookup.context, true, successor);
+        break;
+    }
+}
+
+void
+GUChord::ProcessNextHopReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  if (!m_position->suc.IsValid ())
+    {
+      DEBUG_LOG ("Dropping NEXT_HOP_REQ from Node: " << ReverseLookup (sourceAddress));
+      return;
+    }
+  ChordId key = message.GetNextHopReq ().key;
+  m_stats.RecordForwarded ();
+  GUChordMessage resp = GUChordMessage (GUChordMessage::NEXT_HOP_RSP, message.GetTransactionId ());
+  if (key.InInterval (m_position->self.id, m_position->suc.id, true))
+    {
+      // Our successor list names the replicas of key
+      resp.SetNextHopRsp (key, 1, m_position->suc, m_position->self, m_position->successors);
+    }
+  else
+    {
+      std::vector<ChordNodeDescriptor> nodes = ClosestPrecedingNodes (key, m_lookupAlpha);
+      ChordLocationCache::Entry cached;
+      if (m_locations.Lookup (key, cached) && cached.predecessor != m_position->self
+          && std::find (nodes.begin (), nodes.end (), cached.predecessor) == nodes.end ())
+        {
+          // Pass on what we learned from earlier lookups through us
+          nodes.insert (nodes.begin (), cached.predecessor);
+        }
+      resp.SetNextHopRsp (key, 0, ChordNodeDescriptor (), ChordNodeDescriptor (), nodes);
+    }
+  SendMessage (resp, sourceAddress, sourcePort);
+}
+
+void
+GUChord::ProcessNextHopRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  const RequestTracker::Request *request = m_queryTracker.Find (message.GetTransactionId ());
+  if (request == 0)
+    {
+      DEBUG_LOG ("Received stale NEXT_HOP_RSP from Node: " << ReverseLookup (sourceAddress));
+      return;
+    }
+  uint32_t lookupId = request->context;
+  Ipv4Address queried = request->destinationAddress;
+  SampleRtt (*request);
+  m_queryTracker.Complete (message.GetTransactionId ());
+  std::map<uint32_t, IterativeLookup>::iterator iter = m_lookups.find (lookupId);
+  if (iter == m_lookups.end ())
+    {
+      return;
+    }
+  IterativeLookup &lookup = iter->second;
+  SelectPosition (lookup.position);
+  GUChordMessage::NextHopRsp rsp = message.GetNextHopRsp ();
+  lookup.inFlight--;
+  // Parallel queries answer at their own depth, not one hop each
+  uint8_t depth = lookup.queryDepths[message.GetTransactionId ()] + 1;
+  lookup.queryDepths.erase (message.GetTransactionId ());
+  lookup.hops = std::max (lookup.hops, depth);
+  if (rsp.done)
+    {
+      lookup.hops = depth;
+      lookup.successors = rsp.nodes;
+      FinishLookup (lookupId, true, rsp.SNode, rsp.PNode);
+      return;
+    }
+  if (lookup.cachedPredecessor.IsValid () && queried == lookup.cachedPredecessor.address)
+    {
+      // The cached predecessor no longer precedes key
+      m_locations.Erase (lookup.key);
+      lookup.cachedPredecessor = ChordNodeDescriptor ();
+    }
+  if (depth == 0xFF)
+    {
+      FinishLookup (lookupId, false, ChordNodeDescriptor (), ChordNodeDescriptor ());
+      return;
+    }
+  AddCandidates (lookup, rsp.nodes, depth);
+  for (uint32_t i = 0; i < rsp.nodes.size (); i++)
+    {
+      m_proximity.AddNode (rsp.nodes[i]);
+    }
+  DispatchQueries (lookupId);
+}
+
+void
+GUChord::QueryCompleted (const RequestTracker::Request &request, bool success)
+{
+  if (success)
+    {
+      return;
+    }
+  std::map<uint32_t, IterativeLookup>::iterator iter = m_lookups.find (request.context);
+  if (iter == m_lookups.end ())
+    {
+      return;
+    }
+  m_stats.RecordTimeout ();
+  // Skip the silent node and move on to the next candidates
+  DEBUG_LOG ("NEXT_HOP_REQ to Node: " << ReverseLookup (request.destinationAddress) << " expired");
+  IterativeLookup &lookup = iter->second;
+  if (lookup.cachedPredecessor.IsValid () && request.destinationAddress == lookup.cachedPredecessor.address
+      && request.destinationPort == lookup.cachedPredecessor.port)
+    {
+      m_locations.Invalidate (lookup.cachedPredecessor);
+      lookup.cachedPredecessor = ChordNodeDescriptor ();
+    }
+  lookup.queryDepths.erase (request.transactionId);
+  lookup.inFlight--;
+  DispatchQueries (request.context);
+}
+
+void
+GUChord::QueryRetry (const RequestTracker::Request &request)
+{
+  std::map<uint32_t, IterativeLookup>::iterator iter = m_lookups.find (request.context);
+  if (iter == m_lookups.end ())
+    {
+      m_queryTracker.Cancel (request.transactionId);
+      return;
+    }
+  SelectPosition (iter->second.position);
+  GUChordMessage message = GUChordMessage (GUChordMessage::NEXT_HOP_REQ, request.transactionId);
+  message.SetNextHopReq (iter->second.key);
+  SendMessage (message, request.destinationAddress, request.destinationPort);
+}
+
+/*
+ * Ring snapshot
+ */
+
+namespace {
+
+struct RecordIdLess
+{
+  bool operator() (const GUChordMessage::RingRecord &a, const GUChordMessage::RingRecord &b) const
+  {
+    return a.node.id < b.node.id;
+  }
+};
+
+struct RecordSameNode
+{
+  bool operator() (const GUChordMessage::RingRecord &a, const GUChordMessage::RingRecord &b) const
+  {
+    return a.node == b.node;
+  }
+};
+
+}
+
+void
+GUChord::StartSnapshot (bool statsOnly, bool check, uint32_t checkKeys, uint64_t seed)
+{
+  if (!m_position->suc.IsValid ())
+    {
+      ERROR_LOG ("Not in a ring, no snapshot taken");
+      return;
+    }
+  uint32_t snapshotId = m_nextSnapshotId++;
+  Snapshot &snapshot = m_snapshots[snapshotId];
+  snapshot.position = GetPosition ();
+  snapshot.initiator = true;
+  snapshot.initiatorNode = m_position->self;
+  snapshot.initiatorSnapshotId = snapshotId;
+  snapshot.statsOnly = statsOnly;
+  snapshot.check = check;
+  snapshot.checkKeys = checkKeys;
+  snapshot.seed = seed;
+  snapshot.treeDone = false;
+  snapshot.started = Simulator::Now ();
+  snapshot.outstanding = 0;
+  snapshot.nodes = 0;
+  MarkSnapshotSeen (m_position->self.id, snapshotId);
+  // (self, self) is every other node on the ring
+  SpreadSnapshot (snapshotId, m_position->self.id, m_snapshotTimeout.GetMilliSeconds ());
+}
+
+void
+GUChord::ProcessSnapshotReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  GUChordMessage::SnapshotReq req = message.GetSnapshotReq ();
+  if (!MarkSnapshotSeen (req.initiator.id, req.snapshotId))
+    {
+      // Inconsistent fingers reached us twice; the first subtree counts us
+      DEBUG_LOG ("Duplicate SNAPSHOT_REQ from Node: " << ReverseLookup (sourceAddress));
+      GUChordMessage resp = GUChordMessage (GUChordMessage::SNAPSHOT_RSP, message.GetTransactionId ());
+      resp.SetSnapshotRsp (0, ChordStats ());
+      SendMessage (resp, sourceAddress, sourcePort);
+      return;
+    }
+  uint32_t snapshotId = m_nextSnapshotId++;
+  Snapshot &snapshot = m_snapshots[snapshotId];
+  snapshot.position = GetPosition ();
+  snapshot.initiator = false;
+  snapshot.statsOnly = req.statsOnly;
+  snapshot.check = false;
+  snapshot.parentAddress = sourceAddress;
+  snapshot.parentPort = sourcePort;
+  snapshot.parentTransactionId = message.GetTransactionId ();
+  snapshot.initiatorNode = req.initiator;
+  snapshot.initiatorSnapshotId = req.snapshotId;
+  snapshot.treeDone = false;
+  snapshot.started = Simulator::Now ();
+  snapshot.outstanding = 0;
+  snapshot.nodes = 0;
+  if (!m_position->suc.IsValid ())
+    {
+      // Left the ring meanwhile, answer empty so the parent does not wait
+      FinishSnapshot (snapshotId);
+      return;
+    }
+  SpreadSnapshot (snapshotId, req.limit, req.budget);
+}
+
+void
+GUChord::SpreadSnapshot (uint32_t snapshotId, const ChordId &limit, uint32_t budget)
+{
+  Snapshot &snapshot = m_snapshots[snapshotId];
+  GUChordMessage::RingRecord record;
+  record.node = m_position->self;
+  record.pred = m_position->pred;
+  record.suc = m_position->suc;
+  if (snapshot.initiator)
+    {
+      snapshot.records.push_back (record);
+    }
+  else if (!snapshot.statsOnly)
+    {
+      // Straight to the initiator, so no datagram up the tree grows with
+      // the subtree
+      std::vector<GUChordMessage::RingRecord> records (1, record);
+      GUChordMessage message = GUChordMessage (GUChordMessage::SNAPSHOT_RECORDS, snapshot.initiatorSnapshotId);
+      message.SetSnapshotRecords (records);
+      SendMessage (message, snapshot.initiatorNode);
+    }
+  snapshot.nodes++;
+  // Statistics are the host's; its first position in the ring reports them
+  bool first = true;
+  for (uint32_t i = 0; i < GetPosition (); i++)
+    {
+      first = first && !m_positions[i].suc.IsValid ();
+    }
+  if (first)
+    {
+      snapshot.stats = m_stats;
+    }
+  // Distinct fingers and successors in (self, limit), nearest first
+  std::vector<ChordNodeDescriptor> children;
+  for (uint32_t i = 0; i < CHORD_ID_BITS; i++)
+    {
+      if (m_position->fingers[i].valid && m_position->fingers[i].node.id.InInterval (m_position->self.id, limit, false)
+          && std::find (children.begin (), children.end (), m_position->fingers[i].node) == children.end ())
+        {
+          children.push_back (m_position->fingers[i].node);
+        }
+    }
+  for (uint32_t i = 0; i < m_position->successors.size (); i++)
+    {
+      if (m_position->successors[i].id.InInterval (m_position->self.id, limit, false)
+          && std::find (children.begin (), children.end (), m_position->successors[i]) == children.end ())
+        {
+          children.push_back (m_position->successors[i]);
+        }
+    }
+  std::sort (children.begin (), children.end (), CloserToKey (limit));
+  std::reverse (children.begin (), children.end ());
+  // Each level gets less time, so a parent outwaits its children
+  uint32_t childBudget = budget * 3 / 4;
+  for (uint32_t i = 0; i < children.size (); i++)
+    {
+      ChordId childLimit = (i + 1 < children.size ()) ? children[i + 1].id : limit;
+      uint32_t transactionId = GetNextTransactionId ();
+      m_snapshotQueries[transactionId] = snapshotId;
+      GUChordMessage message = GUChordMessage (GUChordMessage::SNAPSHOT_REQ, transactionId);
+      message.SetSnapshotReq (childLimit, childBudget, snapshot.initiatorNode, snapshot.initiatorSnapshotId,
+                              snapshot.statsOnly);
+      SendMessage (message, children[i]);
+      snapshot.outstanding++;
+    }
+  if (snapshot.outstanding == 0)
+    {
+      FinishSnapshot (snapshotId);
+      return;
+    }
+  snapshot.expiry = Simulator::Schedule (MilliSeconds (budget), &GUChord::SnapshotExpired, this, snapshotId);
+}
+
+void
+GUChord::ProcessSnapshotRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  std::map<uint32_t, uint32_t>::iterator query = m_snapshotQueries.find (message.GetTransactionId ());
+  if (query == m_snapshotQueries.end ())
+    {
+      DEBUG_LOG ("Received stale SNAPSHOT_RSP from Node: " << ReverseLookup (sourceAddress));
+      return;
+    }
+  uint32_t snapshotId = query->second;
+  m_snapshotQueries.erase (query);
+  std::map<uint32_t, Snapshot>::iterator iter = m_snapshots.find (snapshotId);
+  if (iter == m_snapshots.end ())
+    {
+      return;
+    }
+  Snapshot &snapshot = iter->second;
+  GUChordMessage::SnapshotRsp rsp = message.GetSnapshotRsp ();
+  snapshot.nodes += rsp.nodes;
+  snapshot.stats.Merge (rsp.stats);
+  if (--snapshot.outstanding == 0)
+    {
+      FinishSnapshot (snapshotId);
+    }
+}
+
+void
+GUChord::ProcessSnapshotRecords (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  GUChordMessage::SnapshotRecords rsp = message.GetSnapshotRecords ();
+  if (!rsp.valid)
+    {
+      DEBUG_LOG ("Dropping malformed SNAPSHOT_RECORDS from Node: " << ReverseLookup (sourceAddress));
+      return;
+    }
+  std::map<uint32_t, Snapshot>::iterator iter = m_snapshots.find (message.GetTransactionId ());
+  if (iter == m_snapshots.end () || !iter->second.initiator)
+    {
+      DEBUG_LOG ("Received stale SNAPSHOT_RECORDS from Node: " << ReverseLookup (sourceAddress));
+      return;
+    }
+  Snapshot &snapshot = iter->second;
+  if (snapshot.statsOnly)
+    {
+      return;
+    }
+  snapshot.records.insert (snapshot.records.end (), rsp.records.begin (), rsp.records.end ());
+  if (snapshot.treeDone && snapshot.records.size () >= snapshot.nodes)
+    {
+      FinishSnapshot (iter->first);
+    }
+}
+
+void
+GUChord::SnapshotExpired (uint32_t snapshotId)
+{
+  std::map<uint32_t, Snapshot>::iterator iter = m_snapshots.find (snapshotId);
+  if (iter == m_snapshots.end ())
+    {
+      return;
+    }
+  if (iter->second.treeDone)
+    {
+      DEBUG_LOG ("Snapshot gave up on " << iter->second.nodes - iter->second.records.size () << " records");
+    }
+  else
+    {
+      DEBUG_LOG ("Snapshot gave up on " << iter->second.outstanding << " subtrees");
+    }
+  FinishSnapshot (snapshotId);
+}
+
+void
+GUChord::FinishSnapshot (uint32_t snapshotId)
+{
+  std::map<uint32_t, Snapshot>::iterator iter = m_snapshots.find (snapshotId);
+  if (iter == m_snapshots.end ())
+    {
+      return;
+    }
+  Snapshot snapshot = iter->second;
+  snapshot.expiry.Cancel ();
+  SelectPosition (snapshot.position);
+  if (snapshot.initiator && !snapshot.statsOnly && !snapshot.treeDone
+      && snapshot.records.size () < snapshot.nodes)
+    {
+      // Records travel apart from the tree answers, give them a while
+      iter->second.treeDone = true;
+      iter->second.expiry = Simulator::Schedule (MilliSeconds (m_snapshotTimeout.GetMilliSeconds () / 4),
+                                                 &GUChord::SnapshotExpired, this, snapshotId);
+    }
+  else
+    {
+      m_snapshots.erase (iter);
+    }
+  // Late answers from children are dropped
+  std::map<uint32_t, uint32_t>::iterator query = m_snapshotQueries.begin ();
+  while (query != m_snapshotQueries.end ())
+    {
+      if (query->second == snapshotId)
+        {
+          m_snapshotQueries.erase (query++);
+        }
+      else
+        {
+          query++;
+        }
+    }
+  if (!snapshot.initiator)
+    {
+      GUChordMessage resp = GUChordMessage (GUChordMessage::SNAPSHOT_RSP, snapshot.parentTransactionId);
+      resp.SetSnapshotRsp (snapshot.nodes, snapshot.stats);
+      SendMessage (resp, snapshot.parentAddress, snapshot.parentPort);
+      return;
+    }
+  if (!snapshot.statsOnly && m_snapshots.find (snapshotId) != m_snapshots.end ())
+    {
+      return;
+    }
+  if (snapshot.statsOnly)
+    {
+      std::ostringstream report;
+      snapshot.stats.Print (report);
+      CHORD_LOG ("Network stats, in " << (Simulator::Now () - snapshot.started).GetMilliSeconds () << " ms:\n" << report.str ());
+      return;
+    }
+  std::vector<GUChordMessage::RingRecord> &records = snapshot.records;
+  if (records.size () < snapshot.nodes)
+    {
+      DEBUG_LOG ("Snapshot: " << snapshot.nodes - records.size () << " records lost");
+    }
+  std::sort (records.begin (), records.end (), RecordIdLess ());
+  // Inconsistent fingers may reach a node twice
+  records.erase (std::unique (records.begin (), records.end (), RecordSameNode ()), records.end ());
+  uint32_t broken = 0;
+  for (uint32_t i = 0; i < records.size (); i++)
+    {
+      const GUChordMessage::RingRecord &record = records[i];
+      CHORD_LOG ("Ringstate<" << record.node.id.ToString () << ">: Pred<" << NodeName (record.pred) << ", " << record.pred.id.ToString () << ">: Succ<" << NodeName (record.suc) << ", " << record.suc.id.ToString () << ">");
+      const GUChordMessage::RingRecord &next = records[(i + 1) % records.size ()];
+      if (record.suc != next.node || next.pred != record.node)
+        {
+          broken++;
+        }
+    }
+  CHORD_LOG ("Snapshot: " << records.size () << " nodes, " << broken << " inconsistent links, in " << (Simulator::Now () - snapshot.started).GetMilliSeconds () << " ms");
+  if (snapshot.check)
+    {
+      CheckSnapshot (records, snapshot.checkKeys, snapshot.seed);
+    }
+}
+
+void
+GUChord::CheckSnapshot (const std::vector<GUChordMessage::RingRecord> &records, uint32_t keys, uint64_t seed)
+{
+  // Nodes that missed the snapshot are not on this ring, and show up as
+  // wrong pointers of their neighbours
+  std::vector<ChordId> ids (records.size ());
+  for (uint32_t i = 0; i < records.size (); i++)
+    {
+      ids[i] = records[i].node.id;
+    }
+  ChordRing ring;
+  ring.Insert (ids);
+  std::ostringstream report;
+  uint32_t errors = 0;
+  for (uint32_t i = 0; i < records.size (); i++)
+    {
+      errors += ring.CheckNode (records[i].node.id, records[i].pred.id, records[i].suc.id,
+                                std::vector<ChordId> (), report);
+    }
+  if (errors > 0)
+    {
+      ERROR_LOG ("Ring check found " << errors << " wrong pred/succ pointers\n" << report.str ());
+    }
+  // Only our own fingers and successor list are known here
+  errors += CheckRing (ring);
+  CHORD_LOG ("Ring check: " << ring.GetSize () << " nodes, " << errors << " wrong pointers");
+  if (keys == 0)
+    {
+      return;
+    }
+  if (m_checkPending > 0 || !m_iterativeLookup)
+    {
+      ERROR_LOG ("Key check needs iterative lookups and no other key check running");
+      return;
+    }
+  std::vector<ChordId> checkKeys;
+  ChordRing::GenerateKeys (keys, seed, checkKeys);
+  std::vector<uint32_t> owners;
+  ring.FindSuccessors (checkKeys, owners);
+  m_checkOwners.resize (keys);
+  m_checkPending = keys;
+  m_checkWrong = 0;
+  m_checkStarted = Simulator::Now ();
+  for (uint32_t i = 0; i < keys; i++)
+    {
+      m_checkOwners[i] = ring.GetId (owners[i]);
+      if (OwnsKey (checkKeys[i]))
+        {
+          CheckLookupDone (i, true, m_position->self);
+        }
+      else if (checkKeys[i].InInterval (m_position->self.id, m_position->suc.id, true))
+        {
+          CheckLookupDone (i, true, m_position->suc);
+        }
+      else
+        {
+          StartLookup (checkKeys[i], CHECK_LOOKUP, i, ClosestPrecedingNodes (checkKeys[i], m_lookupAlpha));
+        }
+    }
+}
+
+void
+GUChord::CheckLookupDone (uint32_t index, bool success, const ChordNodeDescriptor &successor)
+{
+  if (index >= m_checkOwners.size () || m_checkPending == 0)
+    {
+      return;
+    }
+  if (!success || successor.id != m_checkOwners[index])
+    {
+      m_checkWrong++;
+    }
+  if (--m_checkPending == 0)
+    {
+      CHORD_LOG ("Key check: " << m_checkOwners.size () << " lookups, " << m_checkWrong << " wrong or failed, in "
+                 << (Simulator::Now () - m_checkStarted).GetMilliSeconds () << " ms");
+    }
+}
+
+bool
+GUChord::MarkSnapshotSeen (const ChordId &initiator, uint32_t snapshotId)
+{
+  std::map<std::pair<ChordId, uint32_t>, Time>::iterator iter = m_position->snapshotsSeen.begin ();
+  while (iter != m_position->snapshotsSeen.end ())
+    {
+      if (Simulator::Now () - iter->second > m_snapshotTimeout)
+        {
+          m_position->snapshotsSeen.erase (iter++);
+        }
+      else
+        {
+          iter++;
+        }
+    }
+  return m_position->snapshotsSeen.insert (std::make_pair (std::make_pair (initiator, snapshotId), Simulator::Now ())).second;
+}
+
+void
+GUChord::ClearSnapshots ()
+{
+  std::map<uint32_t, Snapshot>::iterator iter;
+  for (iter = m_snapshots.begin (); iter != m_snapshots.end (); iter++)
+    {
+      iter->second.expiry.Cancel ();
+    }
+  m_snapshots.clear ();
+  m_snapshotQueries.clear ();
+  for (uint32_t i = 0; i < m_positions.size (); i++)
+    {
+      m_positions[i].snapshotsSeen.clear ();
+    }
+  // Lookups of a running key check are gone with the rest of our state
+  m_checkPending = 0;
+}
+
+/*
+ * DHash
+ */
+
+uint32_t
+GUChord::DhashPut (const std::string &key, const std::string &value)
+{
+  return StartDhash (GUChordMessage::DHASH_PUT, key, value);
+}
+
+uint32_t
+GUChord::DhashGet (const std::string &key)
+{
+  return StartDhash (GUChordMessage::DHASH_GET, key, "");
+}
+
+uint32_t
+GUChord::DhashDelete (const std::string &key)
+{
+  return StartDhash (GUChordMessage::DHASH_DELETE, key, "");
+}
+
+uint32_t
+GUChord::StartDhash (uint8_t operation, const std::string &key, const std::string &value)
+{
+  uint32_t requestId = m_nextDhashId++;
+  DhashRequest &request = m_dhashRequests[requestId];
+  request.position = GetPosition ();
+  request.operation = operation;
+  request.key = ChordId::Hash (key);
+  request.reroutes = 0;
+  // Completion is always reported after the request id is returned
+  if (value.length () > DHASH_MAX_VALUE_SIZE)
+    {
+      ERROR_LOG ("DHash value of " << value.length () << " bytes exceeds " << DHASH_MAX_VALUE_SIZE);
+      DHashStore::Value empty = { 0, 0 };
+      Simulator::ScheduleNow (&GUChord::CompleteDhash, this, requestId, (uint8_t) GUChordMessage::DHASH_FAILED, empty);
+      return requestId;
+    }
+  request.value = value;
+  Simulator::ScheduleNow (&GUChord::RouteDhash, this, requestId);
+  return requestId;
+}
+
+void
+GUChord::RouteDhash (uint32_t requestId)
+{
+  std::map<uint32_t, DhashRequest>::iterator iter = m_dhashRequests.find (requestId);
+  if (iter == m_dhashRequests.end ())
+    {
+      return;
+    }
+  SelectPosition (iter->second.position);
+  const ChordId &key = iter->second.key;
+  if (!m_position->suc.IsValid ())
+    {
+      DHashStore::Value empty = { 0, 0 };
+      CompleteDhash (requestId, GUChordMessage::DHASH_FAILED, empty);
+    }
+  else if (OwnsKey (key))
+    {
+      ServeDhashLocally (requestId);
+    }
+  else if (key.InInterval (m_position->self.id, m_position->suc.id, true))
+    {
+      DispatchDhash (requestId, m_position->successors);
+    }
+  else
+    {
+      StartLookup (key, DHASH_LOOKUP, requestId, ClosestPrecedingNodes (key, m_lookupAlpha));
+    }
+}
+
+bool
+GUChord::OwnsKey (const ChordId &key)
+{
+  if (m_position->suc == m_position->self)
+    {
+      return true;
+    }
+  // Until stabilization tells us otherwise, keys routed here are ours
+  return !m_position->pred.IsValid () || key.InInterval (m_position->pred.id, m_position->self.id, true);
+}
+
+void
+GUChord::DispatchDhash (uint32_t requestId, const std::vector<ChordNodeDescriptor> &successors)
+{
+  std::map<uint32_t, DhashRequest>::iterator iter = m_dhashRequests.find (requestId);
+  if (iter == m_dhashRequests.end ())
+    {
+      return;
+    }
+  DhashRequest &request = iter->second;
+  request.replicas.clear ();
+  request.nextReplica = 0;
+  request.tried = 0;
+  if (request.operation == GUChordMessage::DHASH_GET)
+    {
+      // Any replica may serve a read; spread reads over them
+      uint32_t count = std::min<uint32_t> (m_replicationFactor, successors.size ());
+      request.replicas.assign (successors.begin (), successors.begin () + count);
+      if (count > 1)
+        {
+          UniformVariable random (0, count);
+          request.nextReplica = random.GetInteger () % count;
+        }
+    }
+  else if (!successors.empty ())
+    {
+      request.replicas.push_back (successors[0]);
+    }
+  if (!SendDhashReq (requestId))
+    {
+      DHashStore::Value empty = { 0, 0 };
+      CompleteDhash (requestId, GUChordMessage::DHASH_FAILED, empty);
+    }
+}
+
+bool
+GUChord::SendDhashReq (uint32_t requestId)
+{
+  std::map<uint32_t, DhashRequest>::iterator iter = m_dhashRequests.find (requestId);
+  if (iter == m_dhashRequests.end () || iter->second.tried >= iter->second.replicas.size ())
+    {
+      return false;
+    }
+  DhashRequest &request = iter->second;
+  SelectPosition (request.position);
+  ChordNodeDescriptor node = request.replicas[request.nextReplica % request.replicas.size ()];
+  request.nextReplica++;
+  request.tried++;
+  if (node == m_position->self)
+    {
+      ServeDhashLocally (requestId);
+      return true;
+    }
+  uint32_t transactionId = GetNextTransactionId ();
+  TrackRequest (m_dhashTracker, transactionId, node, m_pingRetries, requestId);
+  GUChordMessage message = GUChordMessage (GUChordMessage::DHASH_REQ, transactionId);
+  message.SetDhashReq (request.operation, request.key, request.value);
+  SendMessage (message, node);
+  return true;
+}
+
+uint8_t
+GUChord::ServeDhash (uint8_t operation, const ChordId &key, const std::string &value, DHashStore::Value &result)
+{
+  result.data = 0;
+  result.size = 0;
+  switch (operation)
+    {
+      case GUChordMessage::DHASH_PUT:
+        m_store.Put (key, value);
+        ReplicateWrite (GUChordMessage::DHASH_REPLICA_PUT, key, value);
+        return GUChordMessage::DHASH_OK;
+      case GUChordMessage::DHASH_GET:
+        return m_store.Get (key, result) ? GUChordMessage::DHASH_OK : GUChordMessage::DHASH_NOT_FOUND;
+      case GUChordMessage::DHASH_DELETE:
+        if (!m_store.Remove (key))
+          {
+            return GUChordMessage::DHASH_NOT_FOUND;
+          }
+        ReplicateWrite (GUChordMessage::DHASH_REPLICA_DELETE, key, "");
+        return GUChordMessage::DHASH_OK;
+      default:
+        ERROR_LOG ("Unknown DHash operation: " << (uint32_t) operation);
+        return GUChordMessage::DHASH_FAILED;
+    }
+}
+
+void
+GUChord::ServeDhashLocally (uint32_t requestId)
+{
+  std::map<uint32_t, DhashRequest>::iterator iter = m_dhashRequests.find (requestId);
+  if (iter == m_dhashRequests.end ())
+    {
+      return;
+    }
+  DHashStore::Value result;
+  uint8_t status = ServeDhash (iter->second.operation, iter->second.key, iter->second.value, result);
+  CompleteDhash (requestId, status, result);
+}
+
+void
+GUChord::ProcessDhashReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  GUChordMessage::DhashReq req = message.GetDhashReq ();
+  switch (req.operation)
+    {
+      case GUChordMessage::DHASH_REPLICA_PUT:
+        m_store.Put (req.key, req.value);
+        return;
+      case GUChordMessage::DHASH_REPLICA_DELETE:
+        m_store.Remove (req.key);
+        return;
+    }
+  DHashStore::Value result = { 0, 0 };
+  uint8_t status = GUChordMessage::DHASH_NOT_OWNER;
+  if (m_position->suc.IsValid () && OwnsKey (req.key))
+    {
+      status = ServeDhash (req.operation, req.key, req.value, result);
+    }
+  else if (req.operation == GUChordMessage::DHASH_GET && m_store.Get (req.key, result))
+    {
+      // Served from our replica
+      status = GUChordMessage::DHASH_OK;
+    }
+  DEBUG_LOG ("DHash operation " << (uint32_t) req.operation << " from Node: " << ReverseLookup (sourceAddress) << " Status: " << (uint32_t) status);
+  // The value is copied from the store straight into the response
+  GUChordMessage resp = GUChordMessage (GUChordMessage::DHASH_RSP, message.GetTransactionId ());
+  resp.SetDhashRsp (req.operation, status, req.key, result.data, result.size);
+  SendMessage (resp, sourceAddress, sourcePort);
+}
+
+void
+GUChord::ProcessDhashRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  const RequestTracker::Request *request = m_dhashTracker.Find (message.GetTransactionId ());
+  if (request == 0)
+    {
+      DEBUG_LOG ("Received stale DHASH_RSP from Node: " << ReverseLookup (sourceAddress));
+      return;
+    }
+  uint32_t requestId = request->context;
+  SampleRtt (*request);
+  m_dhashTracker.Complete (message.GetTransactionId ());
+  std::map<uint32_t, DhashRequest>::iterator iter = m_dhashRequests.find (requestId);
+  if (iter == m_dhashRequests.end ())
+    {
+      return;
+    }
+  const GUChordMessage::DhashRsp &rsp = message.GetDhashRsp ();
+  if (rsp.status == GUChordMessage::DHASH_NOT_OWNER && SendDhashReq (requestId))
+    {
+      // That replica has not got the item yet, try the next one
+      return;
+    }
+  if (rsp.status == GUChordMessage::DHASH_NOT_OWNER && iter->second.reroutes < 2)
+    {
+      // Routed with stale ring state; look the owner up again
+      iter->second.reroutes++;
+      m_locations.Erase (iter->second.key);
+      RouteDhash (requestId);
+      return;
+    }
+  DHashStore::Value result;
+  result.data = (const uint8_t *) rsp.value.data ();
+  result.size = rsp.value.size ();
+  CompleteDhash (requestId, rsp.status, result);
+}
+
+void
+GUChord::DhashCompleted (const RequestTracker::Request &request, bool success)
+{
+  if (!success)
+    {
+      DEBUG_LOG ("DHASH_REQ to Node: " << ReverseLookup (request.destinationAddress) << " expired");
+      if (SendDhashReq (request.context))
+        {
+          // Fail over to the next replica
+          return;
+        }
+      DHashStore::Value empty = { 0, 0 };
+      CompleteDhash (request.context, GUChordMessage::DHASH_FAILED, empty);
+    }
+}
+
+void
+GUChord::DhashRetry (const RequestTracker::Request &request)
+{
+  std::map<uint32_t, DhashRequest>::iterator iter = m_dhashRequests.find (request.context);
+  if (iter == m_dhashRequests.end ())
+    {
+      m_dhashTracker.Cancel (request.transactionId);
+      return;
+    }
+  SelectPosition (iter->second.position);
+  GUChordMessage message = GUChordMessage (GUChordMessage::DHASH_REQ, request.transactionId);
+  message.SetDhashReq (iter->second.operation, iter->second.key, iter->second.value);
+  SendMessage (message, request.destinationAddress, request.destinationPort);
+}
+
+void
+GUChord::CompleteDhash (uint32_t requestId, uint8_t status, const DHashStore::Value &result)
+{
+  if (m_dhashRequests.erase (requestId) == 0)
+    {
+      return;
+    }
+  CHORD_LOG ("DHash request " << requestId << " done, Status: " << (uint32_t) status << " Value: " << result.size << " bytes");
+  if (!m_dhashFn.IsNull ())
+    {
+      m_dhashFn (requestId, status, result);
+    }
+}
+
+/*
+ * Replication
+ */
+
+std::vector<ChordNodeDescriptor>
+GUChord::GetReplicas ()
+{
+  uint32_t count = std::min<uint32_t> (m_replicationFactor - 1, m_position->successors.size ());
+  return std::vector<ChordNodeDescriptor> (m_position->successors.begin (), m_position->successors.begin () + count);
+}
+
+void
+GUChord::ReplicateWrite (uint8_t operation, const ChordId &key, const std::string &value)
+{
+  // Fire and forget; anti-entropy repairs lost copies. Positions of this
+  // host already have the write in our store
+  std::vector<ChordNodeDescriptor> replicas = GetReplicas ();
+  for (uint32_t i = 0; i < replicas.size (); i++)
+    {
+      if (IsLocal (replicas[i]))
+        {
+          continue;
+        }
+      GUChordMessage message = GUChordMessage (GUChordMessage::DHASH_REQ, GetNextTransactionId ());
+      message.SetDhashReq (operation, key, value);
+      SendMessage (message, replicas[i]);
+    }
+}
+
+void
+GUChord::AntiEntropy ()
+{
+  m_antiEntropyTimer.Schedule (JitteredInterval (m_antiEntropyInterval));
+  for (uint32_t i = 0; i < m_positions.size (); i++)
+    {
+      SelectPosition (i);
+      if (!m_position->suc.IsValid () || m_position->suc == m_position->self || !m_position->pred.IsValid () || m_position->pred == m_position->self)
+        {
+          continue;
+        }
+      // Start at the root of the tree over the keys the position owns;
+      // positions of this host share our store and need no repair
+      DHashMerkle tree (m_store, m_position->pred.id, m_position->self.id);
+      std::vector<ChordNodeDescriptor> replicas = GetReplicas ();
+      for (uint32_t j = 0; j < replicas.size (); j++)
+        {
+          if (!IsLocal (replicas[j]))
+            {
+              SendMerkleReq (tree, m_position->pred.id, m_position->self.id, ChordId (), 0, replicas[j].address, replicas[j].port);
+            }
+        }
+    }
+}
+
+void
+GUChord::SendMerkleReq (const DHashMerkle &tree, const ChordId &from, const ChordId &to,
+                        const ChordId &prefix, uint8_t depth, Ipv4Address address, uint16_t port)
+{
+  std::vector<ChordId> digests;
+  std::vector<uint32_t> counts;
+  tree.GetChildren (prefix, depth, digests, counts);
+  GUChordMessage message = GUChordMessage (GUChordMessage::MERKLE_REQ, GetNextTransactionId ());
+  message.SetMerkleReq (from, to, prefix, depth, digests);
+  SendMessage (message, address, port);
+}
+
+void
+GUChord::ProcessMerkleReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  GUChordMessage::MerkleReq req = message.GetMerkleReq ();
+  DHashMerkle tree (m_store, req.from, req.to);
+  std::vector<ChordId> digests;
+  std::vector<uint32_t> counts;
+  tree.GetChildren (req.prefix, req.depth, digests, counts);
+  uint16_t mismatches = 0;
+  for (uint32_t i = 0; i < DHASH_MERKLE_FANOUT && i < req.digests.size (); i++)
+    {
+      if (digests[i] != req.digests[i])
+        {
+          mismatches |= (1 << i);
+        }
+    }
+  GUChordMessage resp = GUChordMessage (GUChordMessage::MERKLE_RSP, message.GetTransactionId ());
+  resp.SetMerkleRsp (req.from, req.to, req.prefix, req.depth, mismatches);
+  SendMessage (resp, sourceAddress, sourcePort);
+}
+
+void
+GUChord::ProcessMerkleRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  GUChordMessage::MerkleRsp rsp = message.GetMerkleRsp ();
+  if (rsp.mismatches == 0)
+    {
+      return;
+    }
+  DHashMerkle tree (m_store, rsp.from, rsp.to);
+  std::vector<ChordId> digests;
+  std::vector<uint32_t> counts;
+  tree.GetChildren (rsp.prefix, rsp.depth, digests, counts);
+  for (uint32_t i = 0; i < DHASH_MERKLE_FANOUT; i++)
+    {
+      if ((rsp.mismatches & (1 << i)) == 0)
+        {
+          continue;
+        }
+      ChordId prefix = DHashMerkle::GetChildPrefix (rsp.prefix, rsp.depth, i);
+      uint8_t depth = rsp.depth + 1;
+      if (counts[i] > DHASH_SYNC_ITEMS && depth < DHASH_MERKLE_DEPTH)
+        {
+          SendMerkleReq (tree, rsp.from, rsp.to, prefix, depth, sourceAddress, sourcePort);
+          continue;
+        }
+      // Small enough to send the items themselves
+      std::vector<ChordId> keys = tree.GetKeys (prefix, depth);
+      std::vector<GUChordMessage::DhashItem> items (keys.size ());
+      for (uint32_t j = 0; j < keys.size (); j++)
+        {
+          DHashStore::Value value;
+          m_store.Get (keys[j], value);
+          items[j].key = keys[j];
+          items[j].value = value.ToString ();
+        }
+      DEBUG_LOG ("Repairing " << items.size () << " items at replica " << ReverseLookup (sourceAddress));
+      GUChordMessage sync = GUChordMessage (GUChordMessage::REPLICA_SYNC, GetNextTransactionId ());
+      sync.SetReplicaSync (rsp.from, rsp.to, prefix, depth, items);
+      SendMessage (sync, sourceAddress, sourcePort);
+    }
+}
+
+void
+GUChord::ProcessReplicaSync (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  GUChordMessage::ReplicaSync sync = message.GetReplicaSync ();
+  std::set<ChordId> keep;
+  for (uint32_t i = 0; i < sync.items.size (); i++)
+    {
+      keep.insert (sync.items[i].key);
+    }
+  // The owner has none of our other keys below this node
+  DHashMerkle tree (m_store, sync.from, sync.to);
+  std::vector<ChordId> keys = tree.GetKeys (sync.prefix, sync.depth);
+  for (uint32_t i = 0; i < keys.size (); i++)
+    {
+      if (keep.count (keys[i]) == 0)
+        {
+          m_store.Remove (keys[i]);
+        }
+    }
+  for (uint32_t i = 0; i < sync.items.size (); i++)
+    {
+      m_store.Put (sync.items[i].key, sync.items[i].value);
+    }
+}
+
+/*
+ * Key handoff
+ */
+
+// Stalls after which a handoff is abandoned to anti-entropy
+#define HANDOFF_MAX_STALLS 5
+
+bool
+GUChord::StartHandoff (const ChordId &from, const ChordId &to, const ChordNodeDescriptor &target, bool release)
+{
+  if (IsLocal (target))
+    {
+      // Another position of this host; the keys are in our store already
+      return false;
+    }
+  std::vector<DHashStore::Item> items;
+  m_store.GetItems (from, to, items);
+  if (items.empty ())
+    {
+      return false;
+    }
+  uint32_t handoffId = m_nextHandoffId++;
+  Handoff &handoff = m_handoffs[handoffId];
+  handoff.position = GetPosition ();
+  handoff.target = target;
+  handoff.from = from;
+  handoff.to = to;
+  handoff.keys.resize (items.size ());
+  for (uint32_t i = 0; i < items.size (); i++)
+    {
+      handoff.keys[i] = items[i].key;
+    }
+  handoff.acked = 0;
+  handoff.sent = 0;
+  handoff.release = release;
+  handoff.stalls = 0;
+  CHORD_LOG ("Handing off " << items.size () << " keys to " << NodeName (target));
+  SendHandoffChunks (handoffId);
+  return true;
+}
+
+void
+GUChord::SendHandoffChunks (uint32_t handoffId)
+{
+  std::map<uint32_t, Handoff>::iterator iter = m_handoffs.find (handoffId);
+  if (iter == m_handoffs.end ())
+    {
+      return;
+    }
+  Handoff &handoff = iter->second;
+  SelectPosition (handoff.position);
+  while (handoff.chunks.size () < m_handoffWindow && handoff.sent < handoff.keys.size ())
+    {
+      uint32_t transactionId = GetNextTransactionId ();
+      HandoffChunk chunk;
+      chunk.transactionId = transactionId;
+      chunk.end = SendHandoffChunk (handoff, transactionId, handoff.sent, handoff.keys.size ());
+      chunk.acked = false;
+      TrackRequest (m_handoffTracker, transactionId, handoff.target, m_pingRetries, handoffId);
+      handoff.chunks.push_back (chunk);
+      handoff.sent = chunk.end;
+    }
+  if (handoff.chunks.empty ())
+    {
+      FinishHandoff (handoffId, true);
+    }
+}
+
+uint32_t
+GUChord::SendHandoffChunk (Handoff &handoff, uint32_t transactionId, uint32_t begin, uint32_t end)
+{
+  std::vector<GUChordMessage::DhashItem> items;
+  uint32_t bytes = 0;
+  uint32_t next = begin;
+  for (; next < end && items.size () < 0xFFFF; next++)
+    {
+      DHashStore::Value value;
+      if (!m_store.Get (handoff.keys[next], value))
+        {
+          // Deleted since the handoff started
+          continue;
+        }
+      uint32_t size = CHORD_ID_SIZE + sizeof (uint16_t) + value.size;
+      if (!items.empty () && bytes + size > m_handoffChunkSize)
+        {
+          break;
+        }
+      GUChordMessage::DhashItem item;
+      item.key = handoff.keys[next];
+      item.value = value.ToString ();
+      items.push_back (item);
+      bytes += size;
+    }
+  GUChordMessage message = GUChordMessage (GUChordMessage::HANDOFF_REQ, transactionId);
+  message.SetHandoffReq (handoff.from, handoff.to, begin, items);
+  SendMessage (message, handoff.target);
+  return next;
+}
+
+void
+GUChord::ProcessHandoffReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  GUChordMessage::HandoffReq req = message.GetHandoffReq ();
+  // Writes that reached us as the new owner are newer than the handed off copy
+  uint16_t stored = 0;
+  for (uint32_t i = 0; i < req.items.size (); i++)
+    {
+      if (!m_store.Contains (req.items[i].key))
+        {
+          m_store.Put (req.items[i].key, req.items[i].value);
+          stored++;
+        }
+    }
+  DEBUG_LOG ("Received " << req.items.size () << " handed off keys from " << ReverseLookup (sourceAddress) << " at " << req.offset);
+  GUChordMessage resp = GUChordMessage (GUChordMessage::HANDOFF_RSP, message.GetTransactionId ());
+  resp.SetHandoffRsp (stored);
+  SendMessage (resp, sourceAddress, sourcePort);
+}
+
+void
+GUChord::ProcessHandoffRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  const RequestTracker::Request *request = m_handoffTracker.Find (message.GetTransactionId ());
+  if (request == 0)
+    {
+      DEBUG_LOG ("Received stale HANDOFF_RSP from Node: " << ReverseLookup (sourceAddress));
+      return;
+    }
+  uint32_t handoffId = request->context;
+  SampleRtt (*request);
+  m_handoffTracker.Complete (message.GetTransactionId ());
+  HandoffAcked (handoffId, message.GetTransactionId ());
+}
+
+void
+GUChord::HandoffAcked (uint32_t handoffId, uint32_t transactionId)
+{
+  std::map<uint32_t, Handoff>::iterator iter = m_handoffs.find (handoffId);
+  if (iter == m_handoffs.end ())
+    {
+      return;
+    }
+  Handoff &handoff = iter->second;
+  for (uint32_t i = 0; i < handoff.chunks.size (); i++)
+    {
+      if (handoff.chunks[i].transactionId == transactionId)
+        {
+          handoff.chunks[i].acked = true;
+        }
+    }
+  // Progress only moves over a prefix of acknowledged chunks, so a resumed
+  // handoff never skips a lost one
+  while (!handoff.chunks.empty () && handoff.chunks.front ().acked)
+    {
+      uint32_t end = handoff.chunks.front ().end;
+      for (uint32_t i = handoff.acked; handoff.release && i < end; i++)
+        {
+          m_store.Remove (handoff.keys[i]);
+        }
+      handoff.acked = end;
+      handoff.chunks.erase (handoff.chunks.begin ());
+    }
+  handoff.stalls = 0;
+  SendHandoffChunks (handoffId);
+}
+
+void
+GUChord::HandoffCompleted (const RequestTracker::Request &request, bool success)
+{
+  if (success)
+    {
+      return;
+    }
+  std::map<uint32_t, Handoff>::iterator iter = m_handoffs.find (request.context);
+  if (iter == m_handoffs.end ())
+    {
+      return;
+    }
+  Handoff &handoff = iter->second;
+  DEBUG_LOG ("HANDOFF_REQ to Node: " << NodeName (handoff.target) << " expired, " << handoff.acked << " of " << handoff.keys.size () << " keys acknowledged");
+  // Stop the window and start over from the last acknowledged key later
+  for (uint32_t i = 0; i < handoff.chunks.size (); i++)
+    {
+      m_handoffTracker.Cancel (handoff.chunks[i].transactionId);
+    }
+  handoff.chunks.clear ();
+  handoff.sent = handoff.acked;
+  handoff.stalls++;
+  if (handoff.stalls > HANDOFF_MAX_STALLS)
+    {
+      FinishHandoff (request.context, false);
+      return;
+    }
+  handoff.resume = Simulator::Schedule (JitteredInterval (m_stabilizeMinInterval), &GUChord::ResumeHandoff, this, request.context);
+}
+
+void
+GUChord::HandoffRetry (const RequestTracker::Request &request)
+{
+  std::map<uint32_t, Handoff>::iterator iter = m_handoffs.find (request.context);
+  if (iter == m_handoffs.end ())
+    {
+      m_handoffTracker.Cancel (request.transactionId);
+      return;
+    }
+  Handoff &handoff = iter->second;
+  SelectPosition (handoff.position);
+  uint32_t begin = handoff.acked;
+  for (uint32_t i = 0; i < handoff.chunks.size (); i++)
+    {
+      if (handoff.chunks[i].transactionId == request.transactionId)
+        {
+          SendHandoffChunk (handoff, request.transactionId, begin, handoff.chunks[i].end);
+          return;
+        }
+      begin = handoff.chunks[i].end;
+    }
+}
+
+void
+GUChord::ResumeHandoff (uint32_t handoffId)
+{
+  DEBUG_LOG ("Resuming handoff " << handoffId);
+  SendHandoffChunks (handoffId);
+}
+
+void
+GUChord::FinishHandoff (uint32_t handoffId, bool success)
+{
+  std::map<uint32_t, Handoff>::iterator iter = m_handoffs.find (handoffId);
+  if (iter == m_handoffs.end ())
+    {
+      return;
+    }
+  Handoff &handoff = iter->second;
+  if (success)
+    {
+      CHORD_LOG ("Handed off " << handoff.keys.size () << " keys to " << NodeName (handoff.target));
+    }
+  else
+    {
+      ERROR_LOG ("Handoff to " << NodeName (handoff.target) << " abandoned after " << handoff.acked << " of " << handoff.keys.size () << " keys");
+    }
+  handoff.resume.Cancel ();
+  m_handoffs.erase (iter);
+}
+
+void
+GUChord::ClearHandoffs ()
+{
+  std::map<uint32_t, Handoff>::iterator iter;
+  for (iter = m_handoffs.begin (); iter != m_handoffs.end (); iter++)
+    {
+      iter->second.resume.Cancel ();
+    }
+  m_handoffs.clear ();
+  m_handoffTracker.Clear ();
+}
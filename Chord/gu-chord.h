@@ -21,11 +21,19 @@
 
 #include "ns3/gu-application.h"
 #include "ns3/gu-chord-message.h"
-#include "ns3/ping-request.h"
+#include "ns3/chord-id.h"
+#include "ns3/chord-peer-cache.h"
+#include "ns3/chord-node-descriptor.h"
+#include "ns3/chord-location-cache.h"
+#include "ns3/chord-proximity-table.h"
+#include "ns3/chord-stats.h"
+#include "ns3/dhash-store.h"
+#include "ns3/dhash-merkle.h"
+#include "ns3/request-tracker.h"
+#include "ns3/node-address-directory.h"
 #include "ns3/chord.h"
 #include "ns3/ipv4-address.h"
 
-#include <openssl/sha.h>
 #include <map>
 #include <set>
 #include <vector>
@@ -33,6 +41,7 @@
 #include "ns3/socket.h"
 #include "ns3/nstime.h"
 #include "ns3/timer.h"
+#include "ns3/event-id.h"
 #include "ns3/uinteger.h"
 #include "ns3/boolean.h"
 
@@ -59,24 +68,141 @@ class GUChord : public GUApplication
     void ProcessNotifyPred (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     void ProcessNotifySuc (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     void ProcessRingstate (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
-    bool CompareHash(unsigned char*, unsigned char*);
-    void AuditPings ();
+    void ProcessLookupReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessLookupRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessNextHopReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessNextHopRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessSnapshotReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessSnapshotRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessSnapshotRecords (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessDhashReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessDhashRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessMerkleReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessMerkleRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessReplicaSync (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessHandoffReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessHandoffRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void PingCompleted (const RequestTracker::Request &request, bool success);
+    void PingRetry (const RequestTracker::Request &request);
+    void LookupCompleted (const RequestTracker::Request &request, bool success);
+    void StabilizeCompleted (const RequestTracker::Request &request, bool success);
+    void StabilizeRetry (const RequestTracker::Request &request);
+    void QueryCompleted (const RequestTracker::Request &request, bool success);
+    void QueryRetry (const RequestTracker::Request &request);
+    void DhashCompleted (const RequestTracker::Request &request, bool success);
+    void DhashRetry (const RequestTracker::Request &request);
+    void HandoffCompleted (const RequestTracker::Request &request, bool success);
+    void HandoffRetry (const RequestTracker::Request &request);
+    /**
+     * \brief Sends the rest of a stalled handoff, from its last
+     * acknowledged item.
+     */
+    void ResumeHandoff (uint32_t handoffId);
     uint32_t GetNextTransactionId ();
+    /**
+     * \brief Makes the ring position with the given index, counted from
+     * AppPort, the one messages are handled and sent for.
+     */
+    void SelectPosition (uint32_t index);
+    uint32_t GetPosition () const;
     void StopChord ();
     void joinChord(std::string);
     void createChord();
+    /**
+     * \brief Probes the successor of every position in the ring that is
+     * due; one timer serves all positions of the host, each on its own
+     * period.
+     */
     void Stabilize();
+    /**
+     * \brief Sets the timer for the position due first.
+     */
+    void ScheduleStabilize ();
+    /**
+     * \brief Sends a stabilize probe for the current position, unless one
+     * is in flight.
+     */
+    void ProbeSuccessor ();
+    /**
+     * \brief Drops the stabilize probe of the current position, if any,
+     * without failing its successor.
+     */
+    void CancelStabilizeProbe ();
+    /**
+     * \brief Refreshes the next finger of every position in the ring.
+     */
+    void FixFingers();
+    void FixNextFinger ();
+    /**
+     * \brief Compares the Merkle digests of the keys of each position with
+     * its replicas and repairs the ranges that differ.
+     */
+    void AntiEntropy ();
     void startRingstate();
+    /**
+     * \brief Collects pred/succ records and statistics of the whole ring
+     * over a finger spanning tree and logs them at this node.
+     * \param statsOnly Log the merged statistics instead of the records.
+     * \param check Check every node's pointers against the ring the records
+     * make up, then look up checkKeys keys drawn from seed and compare the
+     * answers with their owners on that ring.
+     */
+    void StartSnapshot (bool statsOnly, bool check = false, uint32_t checkKeys = 0, uint64_t seed = 0);
+    void SnapshotExpired (uint32_t snapshotId);
+    /**
+     * \brief Takes the current position out of the ring; host state goes
+     * with the last position to leave.
+     */
     void nodeLeave();
-    void hashtostr(unsigned char*, std::string &);
+
+    /**
+     * \brief Shares the peer id cache of the application above; must be
+     * called before the application starts.
+     */
+    void SetPeerCache (Ptr<ChordPeerCache> peers);
+    Ptr<ChordPeerCache> GetPeerCache ();
+    /**
+     * \brief Shares the node address directory of the application above,
+     * in place of SetNodeAddressMap and SetAddressNodeMap.
+     */
+    void SetAddressDirectory (Ptr<NodeAddressDirectory> directory);
+
+    const ChordId& GetRingId () const;
+    /**
+     * \brief Compares predecessor, successor list and fingers of the current
+     * position with the ring of all live nodes and logs each pointer that is
+     * wrong.
+     * \returns the number of wrong pointers.
+     */
+    uint32_t CheckRing (const ChordRing &ring);
+
+    /**
+     * \brief Stores, fetches or deletes a value at the successor of
+     * SHA-1(key). Completion is reported through the DHash callback.
+     * \returns the request id passed to the callback.
+     */
+    uint32_t DhashPut (const std::string &key, const std::string &value);
+    uint32_t DhashGet (const std::string &key);
+    uint32_t DhashDelete (const std::string &key);
+
+    /**
+     * \brief Reports request id, DhashStatus and, for a successful get, a
+     * view of the value that is only valid during the call.
+     */
+    typedef Callback <void, uint32_t, uint8_t, const DHashStore::Value &> DhashCallback;
 
     // Callback with Application Layer (add more when required)
     void SetPingSuccessCallback (Callback <void, Ipv4Address, std::string> pingSuccessFn);
     void SetPingFailureCallback (Callback <void, Ipv4Address, std::string> pingFailureFn);
     void SetPingRecvCallback (Callback <void, Ipv4Address, std::string> pingRecvFn);
+    void SetDhashCallback (DhashCallback dhashFn);
 
     // From GUApplication
     virtual void ProcessCommand (std::vector<std::string> tokens);
+    virtual void SetNodeAddressMap (std::map<uint32_t, Ipv4Address> nodeAddressMap);
+    virtual void SetAddressNodeMap (std::map<Ipv4Address, uint32_t> addressNodeMap);
+    virtual Ipv4Address ResolveNodeIpAddress (std::string nodeId);
+    virtual std::string ReverseLookup (Ipv4Address ipv4Address);
     
   protected:
     virtual void DoDispose ();
@@ -85,25 +211,430 @@ class GUChord : public GUApplication
     virtual void StartApplication (void);
     virtual void StopApplication (void);
 
+    struct Finger
+      {
+        ChordNodeDescriptor node;
+        bool valid;
+      };
+
+    /**
+     * \brief Ring state of one virtual node; everything else, the socket
+     * and request trackers included, belongs to the host.
+     */
+    struct RingPosition
+      {
+        ChordNodeDescriptor self;
+        // Invalid while not in a ring
+        ChordNodeDescriptor pred;
+        // Last time the predecessor stabilized with us
+        Time predLastSeen;
+        ChordNodeDescriptor suc;
+        // Nearest live successors, suc first; empty while alone in the ring
+        std::vector<ChordNodeDescriptor> successors;
+        // Successor we last failed over from, not taken back from a stale report
+        ChordNodeDescriptor failedSuccessor;
+        std::vector<Finger> fingers;
+        uint32_t nextFinger;
+        // Transaction id of the last stabilize probe
+        uint32_t stabilizeProbe;
+        // Stabilization period, backing off while this position sees no
+        // churn, and when it is next due
+        Time stabilizeInterval;
+        Time nextStabilize;
+        // Snapshots reached here lately, by initiator and its snapshot id, so
+        // a node reached twice reports itself once
+        std::map<std::pair<ChordId, uint32_t>, Time> snapshotsSeen;
+      };
+
+    enum LookupPurpose
+      {
+        FINGER_LOOKUP,
+        JOIN_LOOKUP,
+        DHASH_LOOKUP,
+        // Key of a ring check, context is its index
+        CHECK_LOOKUP
+      };
+
+    /**
+     * \brief State of an iterative lookup at its originator.
+     */
+    struct IterativeLookup
+      {
+        // Ring position the lookup runs for
+        uint32_t position;
+        ChordId key;
+        LookupPurpose purpose;
+        // Finger index for FINGER_LOOKUP, request id for DHASH_LOOKUP
+        uint32_t context;
+        // Successor list of the predecessor of key, once found
+        std::vector<ChordNodeDescriptor> successors;
+        // Nodes not yet queried, closest preceding key first
+        std::vector<ChordNodeDescriptor> candidates;
+        std::set<ChordId> queried;
+        // Hops from this node to each candidate, and to the node each
+        // query in flight went to
+        std::map<ChordId, uint8_t> depths;
+        std::map<uint32_t, uint8_t> queryDepths;
+        uint32_t inFlight;
+        // Hops of the answer once found, else the deepest answer so far
+        uint8_t hops;
+        // Predecessor of key according to the location cache, asked first
+        ChordNodeDescriptor cachedPredecessor;
+        Time started;
+      };
+
+    /**
+     * \brief Forwards a join towards the predecessor of the joining node.
+     */
+    void RouteFindSuc (const ChordNodeDescriptor &node, const ChordNodeDescriptor &landmark, uint32_t transactionId);
+    /**
+     * \returns the finger that most closely precedes key, or the successor.
+     */
+    ChordNodeDescriptor ClosestPrecedingFinger (const ChordId &key);
+    /**
+     * \brief Makes nodeId the successor. Successor list entries ahead of it
+     * are dropped; if it is not in the list it is put in front.
+     */
+    void SetSuccessor (const ChordNodeDescriptor &node);
+    /**
+     * \brief Rebuilds the successor list from the current successor and the
+     * list it reported.
+     */
+    void RefreshSuccessors (const std::vector<ChordNodeDescriptor> &successors);
+    /**
+     * \brief Drops the unresponsive successor and fails over to the next
+     * entry of the successor list.
+     */
+    void SuccessorFailed ();
+    void SetPredecessor (const ChordNodeDescriptor &node);
+    /**
+     * \brief Drops the stabilization period of the current position to its
+     * minimum after a membership change or a lost probe.
+     */
+    void ChurnObserved ();
+    /**
+     * \brief Restarts stabilization of the current position at the minimum
+     * period.
+     */
+    void ResetStabilize ();
+    Time JitteredInterval (Time interval);
+    void InitFingers ();
+    /**
+     * \brief Points finger index, and every later finger whose start also
+     * precedes the node, at node.
+     * \returns the index of the first finger left unchanged.
+     */
+    uint32_t UpdateFingers (uint32_t index, const ChordNodeDescriptor &node);
+    /**
+     * \brief Installs the answer of a finger lookup, or the nearest known
+     * node in the same finger interval, and skips the fingers it also covers.
+     */
+    void FingerFound (uint32_t index, const ChordNodeDescriptor &node);
+    /**
+     * \returns up to count distinct fingers and successors preceding key,
+     * closest first, or the successor if there are none.
+     */
+    std::vector<ChordNodeDescriptor> ClosestPrecedingNodes (const ChordId &key, uint32_t count);
+    void CompleteJoin (const ChordNodeDescriptor &successor, const ChordNodeDescriptor &predecessor);
+    /**
+     * \brief Starts an iterative lookup of key from the given nodes.
+     */
+    void StartLookup (const ChordId &key, LookupPurpose purpose, uint32_t context,
+                      const std::vector<ChordNodeDescriptor> &nodes);
+    /**
+     * \brief Adds the nodes not yet known to the lookup, depth hops away.
+     */
+    void AddCandidates (IterativeLookup &lookup, const std::vector<ChordNodeDescriptor> &nodes, uint8_t depth);
+    /**
+     * \brief Queries candidates until alpha queries are in flight; fails the
+     * lookup once nothing is in flight and no candidates are left.
+     */
+    void DispatchQueries (uint32_t lookupId);
+    void FinishLookup (uint32_t lookupId, bool success, const ChordNodeDescriptor &successor,
+                       const ChordNodeDescriptor &predecessor);
+    /**
+     * \brief State of a snapshot at a node of the spanning tree.
+     */
+    struct Snapshot
+      {
+        uint32_t position;
+        // Set at the node that started the snapshot
+        bool initiator;
+        Ipv4Address parentAddress;
+        uint16_t parentPort;
+        uint32_t parentTransactionId;
+        // Where ring records go, and the initiator's id for the snapshot
+        ChordNodeDescriptor initiatorNode;
+        uint32_t initiatorSnapshotId;
+        Time started;
+        uint32_t outstanding;
+        // Records received, at the initiator only
+        std::vector<GUChordMessage::RingRecord> records;
+        // Nodes of the subtree that sent their record to the initiator
+        uint32_t nodes;
+        ChordStats stats;
+        bool statsOnly;
+        bool check;
+        uint32_t checkKeys;
+        uint64_t seed;
+        // Set at the initiator once the tree answered, while records are
+        // still on their way
+        bool treeDone;
+        EventId expiry;
+      };
+
+    /**
+     * \brief Hands each finger in (self, limit) the ids up to the next one.
+     */
+    void SpreadSnapshot (uint32_t snapshotId, const ChordId &limit, uint32_t budget);
+    /**
+     * \brief Reports the node count and stats of the subtree to the parent,
+     * or logs the records at the initiator once they all arrived.
+     */
+    void FinishSnapshot (uint32_t snapshotId);
+    /**
+     * \brief Notes the snapshot, forgetting those older than SnapshotTimeout.
+     * \returns false if it was seen already.
+     */
+    bool MarkSnapshotSeen (const ChordId &initiator, uint32_t snapshotId);
+    /**
+     * \brief Builds the ring of the snapshot records, checks each record and
+     * our own pointers against it, and starts the key lookups of the check.
+     */
+    void CheckSnapshot (const std::vector<GUChordMessage::RingRecord> &records, uint32_t keys, uint64_t seed);
+    void CheckLookupDone (uint32_t index, bool success, const ChordNodeDescriptor &successor);
+    void ClearSnapshots ();
+    /**
+     * \brief DHash request issued by this node.
+     */
+    struct DhashRequest
+      {
+        uint32_t position;
+        uint8_t operation;
+        ChordId key;
+        std::string value;
+        // Lookups restarted after a DHASH_NOT_OWNER answer
+        uint8_t reroutes;
+        // Owner only for writes; owner and replicas for reads
+        std::vector<ChordNodeDescriptor> replicas;
+        uint32_t nextReplica;
+        uint32_t tried;
+      };
+
+    uint32_t StartDhash (uint8_t operation, const std::string &key, const std::string &value);
+    /**
+     * \brief Finds the successor of the request key and sends it the request.
+     */
+    void RouteDhash (uint32_t requestId);
+    /**
+     * \brief Sends a request to the key owner, or a read to a random one of
+     * its first ReplicationFactor successors.
+     * \param successors The owner followed by its successors.
+     */
+    void DispatchDhash (uint32_t requestId, const std::vector<ChordNodeDescriptor> &successors);
+    /**
+     * \returns false once every candidate of the request has been tried.
+     */
+    bool SendDhashReq (uint32_t requestId);
+    /**
+     * \brief Forwards a write applied here to our replicas.
+     */
+    void ReplicateWrite (uint8_t operation, const ChordId &key, const std::string &value);
+    std::vector<ChordNodeDescriptor> GetReplicas ();
+    void SendMerkleReq (const DHashMerkle &tree, const ChordId &from, const ChordId &to,
+                        const ChordId &prefix, uint8_t depth, Ipv4Address address, uint16_t port);
+    /**
+     * \returns true if the current position holds the keys in
+     * (predecessor, self].
+     */
+    bool OwnsKey (const ChordId &key);
+    /**
+     * \returns true if node is a position of this host, which shares our
+     * store.
+     */
+    bool IsLocal (const ChordNodeDescriptor &node);
+    /**
+     * \returns the number of positions of this host in a ring.
+     */
+    uint32_t PositionsInRing ();
+    /**
+     * \brief Applies an operation to the local store; a get result points
+     * into the store.
+     */
+    uint8_t ServeDhash (uint8_t operation, const ChordId &key, const std::string &value, DHashStore::Value &result);
+    void ServeDhashLocally (uint32_t requestId);
+    struct HandoffChunk
+      {
+        uint32_t transactionId;
+        // One past the last key of the chunk
+        uint32_t end;
+        bool acked;
+      };
+    /**
+     * \brief Items of a range streaming to its new owner.
+     */
+    struct Handoff
+      {
+        // Position handing off
+        uint32_t position;
+        ChordNodeDescriptor target;
+        ChordId from;
+        ChordId to;
+        // Keys in (from, to] when the handoff started
+        std::vector<ChordId> keys;
+        // Keys before acked have been stored by the target, keys from acked
+        // to sent are in flight
+        uint32_t acked;
+        uint32_t sent;
+        // Chunks in flight, oldest first
+        std::vector<HandoffChunk> chunks;
+        // Drop the keys once the target has them
+        bool release;
+        uint8_t stalls;
+        EventId resume;
+      };
+    /**
+     * \brief Streams the items in (from, to] to target.
+     * \returns false if there is nothing to send, or target shares our store.
+     */
+    bool StartHandoff (const ChordId &from, const ChordId &to, const ChordNodeDescriptor &target, bool release);
+    /**
+     * \brief Sends chunks until HandoffWindow of them are unacknowledged.
+     */
+    void SendHandoffChunks (uint32_t handoffId);
+    /**
+     * \brief Sends the keys of handoff from begin, up to HandoffChunkSize
+     * bytes of them.
+     * \returns one past the last key sent.
+     */
+    uint32_t SendHandoffChunk (Handoff &handoff, uint32_t transactionId, uint32_t begin, uint32_t end);
+    void HandoffAcked (uint32_t handoffId, uint32_t transactionId);
+    void FinishHandoff (uint32_t handoffId, bool success);
+    void ClearHandoffs ();
+    void CompleteDhash (uint32_t requestId, uint8_t status, const DHashStore::Value &result);
+    /**
+     * \brief Sends to the socket address cached in node.
+     */
+    void SendMessage (GUChordMessage &message, const ChordNodeDescriptor &node);
+    void SendMessage (GUChordMessage &message, Ipv4Address address, uint16_t port);
+    /**
+     * \brief Queues message from the current position to the position on
+     * the port of destination. Datagrams go to the AppPort of the host,
+     * which all hosts share; messages to one host queued within
+     * BatchWindow of the first go out in one datagram. Responses go out at
+     * once, with whatever is queued ahead of them, so the requester's round
+     * trip samples do not include our batching delay.
+     */
+    void SendMessage (GUChordMessage &message, const InetSocketAddress &destination);
+    /**
+     * \brief Sends the queued datagram and restamps the requests in it as
+     * sent now.
+     */
+    void FlushQueue (uint32_t address);
+    void FlushQueues ();
+    void ProcessMessage (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    /**
+     * \brief Tracks a request to node, remembering its port for retries.
+     */
+    void TrackRequest (RequestTracker &tracker, uint32_t transactionId, const ChordNodeDescriptor &node,
+                       uint8_t retries, uint32_t context);
+    /**
+     * \brief Measures the round trip of an answered request, unless it was
+     * retransmitted (Karn's rule).
+     */
+    void SampleRtt (const RequestTracker::Request &request);
+    /**
+     * \returns the node id of node, for logging only.
+     */
+    std::string NodeName (const ChordNodeDescriptor &node);
+
     uint32_t m_currentTransactionId;
     Ptr<Socket> m_socket;
+    // Datagram under construction for each destination host, by address
+    struct SendQueue
+      {
+        // Queued messages, serialized back to back
+        Buffer buffer;
+        // Our requests among them
+        std::vector<uint32_t> transactionIds;
+        EventId flush;
+      };
+    std::map<uint32_t, SendQueue> m_sendQueues;
+    Time m_batchWindow;
+    uint32_t m_batchMaxSize;
     Time m_pingTimeout;
+    uint8_t m_pingRetries;
+    // Stabilization period of each position backs off from
+    // m_stabilizeMinInterval to m_stabilizeTimeout while the ring is quiet
     Time m_stabilizeTimeout;
+    Time m_stabilizeMinInterval;
+    Time m_fixFingersTimeout;
+    Time m_lookupTimeout;
+    uint8_t m_successorListSize;
+    bool m_iterativeLookup;
+    uint8_t m_lookupAlpha;
+    Time m_lookupHopTimeout;
+    Time m_snapshotTimeout;
+    uint8_t m_replicationFactor;
+    Time m_antiEntropyInterval;
+    uint8_t m_lookupHopRetries;
     uint16_t m_appPort;
-    std::string m_pred;
-    std::string m_suc;
-    unsigned char m_pred_hash [20];
-    unsigned char m_suc_hash [20];
-    unsigned char m_my_hash [20];
+    uint16_t m_virtualNodes;
+    // Ring positions on AppPort onwards, and the one being handled
+    std::vector<RingPosition> m_positions;
+    RingPosition *m_position;
+    Ptr<ChordPeerCache> m_peers;
+    Ptr<NodeAddressDirectory> m_addressDirectory;
+    bool m_sharedDirectory;
     // Timers
-    Timer m_auditPingsTimer;
     Timer m_stabilizeTimer;
+    Timer m_fixFingersTimer;
+    Timer m_antiEntropyTimer;
     // Ping tracker
-    std::map<uint32_t, Ptr<PingRequest> > m_pingTracker;
+    RequestTracker m_pingTracker;
+    // Finger lookups in flight, tagged with the finger index
+    RequestTracker m_lookupTracker;
+    // Stabilize probes of the successor, which fail it over on expiry,
+    // tagged with the position
+    RequestTracker m_stabilizeTracker;
+    // Iterative lookups by lookup id, and their queries tagged with it
+    std::map<uint32_t, IterativeLookup> m_lookups;
+    uint32_t m_nextLookupId;
+    RequestTracker m_queryTracker;
+    uint32_t m_locationCacheSize;
+    ChordLocationCache m_locations;
+    bool m_proximityFingers;
+    uint32_t m_proximityTableSize;
+    ChordProximityTable m_proximity;
+    // Snapshots this node takes part in, and its queries to children
+    std::map<uint32_t, Snapshot> m_snapshots;
+    std::map<uint32_t, uint32_t> m_snapshotQueries;
+    uint32_t m_nextSnapshotId;
+    // Owners of the keys of the last ring check, by key index, and its progress
+    std::vector<ChordId> m_checkOwners;
+    uint32_t m_checkPending;
+    uint32_t m_checkWrong;
+    Time m_checkStarted;
+    // Lookups started here and load from other nodes' lookups
+    ChordStats m_stats;
+    // Keys the positions are successors of, and replicas
+    DHashStore m_store;
+    std::map<uint32_t, DhashRequest> m_dhashRequests;
+    uint32_t m_nextDhashId;
+    // DHash requests in flight to key owners, tagged with the request id
+    RequestTracker m_dhashTracker;
+    // Outgoing range transfers, and their chunks in flight tagged with the
+    // handoff id
+    std::map<uint32_t, Handoff> m_handoffs;
+    uint32_t m_nextHandoffId;
+    RequestTracker m_handoffTracker;
+    uint32_t m_handoffChunkSize;
+    uint8_t m_handoffWindow;
     // Callbacks
     Callback <void, Ipv4Address, std::string> m_pingSuccessFn;
     Callback <void, Ipv4Address, std::string> m_pingFailureFn;
     Callback <void, Ipv4Address, std::string> m_pingRecvFn;
+    DhashCallback m_dhashFn;
 };
 
 #endif
@@ -40,8 +40,31 @@ GUSearchHelper::Install (NodeContainer c)
     {
       Ptr<Node> node = *i;
       Ptr<GUSearch> application = m_factory.Create<GUSearch> ();
+      if (m_addressDirectory != 0)
+        {
+          application->SetAddressDirectory (m_addressDirectory);
+        }
       node->AddApplication (application);
       apps.Add (application);
     }
   return apps;
 }
+
+void
+GUSearchHelper::SetNodeAddressMaps (const std::map<uint32_t, Ipv4Address> &nodeAddressMap,
+                                    const std::map<Ipv4Address, uint32_t> &addressNodeMap)
+{
+  m_addressDirectory = ns3::Create<NodeAddressDirectory> (nodeAddressMap, addressNodeMap);
+}
+
+void
+GUSearchHelper::SetAddressDirectory (Ptr<NodeAddressDirectory> directory)
+{
+  m_addressDirectory = directory;
+}
+
+Ptr<NodeAddressDirectory>
+GUSearchHelper::GetAddressDirectory () const
+{
+  return m_addressDirectory;
+}
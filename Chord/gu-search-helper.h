@@ -37,8 +37,22 @@ class GUSearchHelper
 
     ApplicationContainer Install (NodeContainer c);
 
+    /**
+     * \brief Builds one address directory from the topology maps and hands
+     * it to every application Install () makes.
+     */
+    void SetNodeAddressMaps (const std::map<uint32_t, Ipv4Address> &nodeAddressMap,
+                             const std::map<Ipv4Address, uint32_t> &addressNodeMap);
+    /**
+     * \brief Hands directory, such as another helper's, to every application
+     * Install () makes.
+     */
+    void SetAddressDirectory (Ptr<NodeAddressDirectory> directory);
+    Ptr<NodeAddressDirectory> GetAddressDirectory () const;
+
   private:
     ObjectFactory m_factory;
+    Ptr<NodeAddressDirectory> m_addressDirectory;
 };
 
 #endif
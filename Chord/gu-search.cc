@@ -22,6 +22,8 @@
 #include "ns3/random-variable.h"
 #include "ns3/inet-socket-address.h"
 
+#include <algorithm>
+
 using namespace ns3;
 
 TypeId
@@ -40,23 +42,39 @@ GUSearch::GetTypeId ()
                    UintegerValue (10001),
                    MakeUintegerAccessor (&GUSearch::m_chordPort),
                    MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("ChordVirtualNodes",
+                   "Ring positions of a host of weight 1, all served by one socket on ChordPort; ChordPort + i only tags position i inside Chord messages",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&GUSearch::m_chordVirtualNodes),
+                   MakeUintegerChecker<uint16_t> (1))
+    .AddAttribute ("Weight",
+                   "Capacity of this host relative to others, scales its number of virtual nodes",
+                   DoubleValue (1.0),
+                   MakeDoubleAccessor (&GUSearch::m_weight),
+                   MakeDoubleChecker<double> (0.0))
     .AddAttribute ("PingTimeout",
                    "Timeout value for PING_REQ in milliseconds",
                    TimeValue (MilliSeconds (2000)),
                    MakeTimeAccessor (&GUSearch::m_pingTimeout),
                    MakeTimeChecker ())
+    .AddAttribute ("PingRetries",
+                   "Number of PING_REQ retransmissions before a ping fails",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&GUSearch::m_pingRetries),
+                   MakeUintegerChecker<uint8_t> ())
     ;
   return tid;
 }
 
 GUSearch::GUSearch ()
-  : m_auditPingsTimer (Timer::CANCEL_ON_DESTROY)
 {
   m_chord = NULL;
   RandomVariable random;
   SeedManager::SetSeed (time (NULL));
   random = UniformVariable (0x00000000, 0xFFFFFFFF);
   m_currentTransactionId = random.GetInteger ();
+  m_addressDirectory = Create<NodeAddressDirectory> ();
+  m_sharedDirectory = false;
 }
 
 GUSearch::~GUSearch ()
@@ -74,18 +92,22 @@ GUSearch::DoDispose ()
 void
 GUSearch::StartApplication (void)
 {
-  // Create and Configure GUChord
+  // Chord and search share peer ids, so each peer is hashed once per node
+  m_peers = Create<ChordPeerCache> ();
+  m_peers->SetResolveCallback (MakeCallback (&GUSearch::ResolveNodeIpAddress, this));
+  // Create and Configure GUChord, with one ring position per virtual node
+  // behind a single socket
   ObjectFactory factory;
   factory.SetTypeId (GUChord::GetTypeId ());
   factory.Set ("AppPort", UintegerValue (m_chordPort));
+  factory.Set ("VirtualNodes", UintegerValue (GetVirtualNodeCount ()));
   m_chord = factory.Create<GUChord> ();
   m_chord->SetNode (GetNode ());
-  m_chord->SetNodeAddressMap (m_nodeAddressMap);
-  m_chord->SetAddressNodeMap (m_addressNodeMap);
+  m_chord->SetAddressDirectory (m_addressDirectory);
   m_chord->SetModuleName ("CHORD");
-  std::string nodeId = GetNodeId ();
-  m_chord->SetNodeId (nodeId);
+  m_chord->SetNodeId (GetNodeId ());
   m_chord->SetLocalAddress(m_local);
+  m_chord->SetPeerCache (m_peers);
 
   if (GUApplication::IsRealStack ())
   {
@@ -96,6 +118,7 @@ GUSearch::StartApplication (void)
   m_chord->SetPingSuccessCallback (MakeCallback (&GUSearch::HandleChordPingSuccess, this)); 
   m_chord->SetPingFailureCallback (MakeCallback (&GUSearch::HandleChordPingFailure, this));
   m_chord->SetPingRecvCallback (MakeCallback (&GUSearch::HandleChordPingRecv, this)); 
+  m_chord->SetDhashCallback (MakeCallback (&GUSearch::HandleChordDhashResult, this));
   //////
   // m_chord->SetGUSearchCallback (MakeCallback (&GUSearch::HandleChordSearchResult, this)); 
   // m_chord->setGUSearchNodeLeave (MakeCallback (&GUSearch::HandleChordNodeLeave, this));
@@ -113,10 +136,61 @@ GUSearch::StartApplication (void)
       m_socket->SetRecvCallback (MakeCallback (&GUSearch::RecvMessage, this));
     }  
   
-  // Configure timers
-  m_auditPingsTimer.SetFunction (&GUSearch::AuditPings, this);
-  // Start timers
-  m_auditPingsTimer.Schedule (m_pingTimeout);
+  // Configure ping tracker
+  m_pingTracker.SetTimeout (m_pingTimeout);
+  m_pingTracker.SetCompletionCallback (MakeCallback (&GUSearch::PingCompleted, this));
+  m_pingTracker.SetRetryCallback (MakeCallback (&GUSearch::PingRetry, this));
+}
+
+uint32_t
+GUSearch::GetVirtualNodeCount ()
+{
+  // Hosts take ring positions, and so keys, in proportion to their weight
+  uint32_t count = (uint32_t) (m_chordVirtualNodes * m_weight + 0.5);
+  return std::max<uint32_t> (count, 1);
+}
+
+void
+GUSearch::SetNodeAddressMap (std::map<uint32_t, Ipv4Address> nodeAddressMap)
+{
+  // Fallback for callers without a helper; a shared directory is not ours
+  // to change
+  if (!m_sharedDirectory)
+    {
+      m_addressDirectory->BuildNodes (nodeAddressMap);
+    }
+}
+
+void
+GUSearch::SetAddressNodeMap (std::map<Ipv4Address, uint32_t> addressNodeMap)
+{
+  if (!m_sharedDirectory)
+    {
+      m_addressDirectory->BuildAddresses (addressNodeMap);
+    }
+}
+
+void
+GUSearch::SetAddressDirectory (Ptr<NodeAddressDirectory> directory)
+{
+  m_addressDirectory = directory;
+  m_sharedDirectory = true;
+  if (m_chord != 0)
+    {
+      m_chord->SetAddressDirectory (directory);
+    }
+}
+
+Ipv4Address
+GUSearch::ResolveNodeIpAddress (std::string nodeId)
+{
+  return m_addressDirectory->Resolve (nodeId);
+}
+
+std::string
+GUSearch::ReverseLookup (Ipv4Address ipv4Address)
+{
+  return m_addressDirectory->ReverseLookup (ipv4Address);
 }
 
 void
@@ -132,9 +206,8 @@ GUSearch::StopApplication (void)
       m_socket = 0;
     }
 
-  // Cancel timers
-  m_auditPingsTimer.Cancel ();
-  m_pingTracker.clear ();
+  // Release outstanding pings
+  m_pingTracker.Clear ();
 }
 
 void
@@ -167,14 +240,11 @@ GUSearch::ProcessCommand (std::vector<std::string> tokens)
         {
           iterator++;
           std::string pingMessage = *iterator;
-          std::map<uint32_t, Ipv4Address>::iterator iter;
-          for (iter = m_nodeAddressMap.begin () ; iter != m_nodeAddressMap.end (); iter++)  
+          for (uint32_t i = 0; i < m_addressDirectory->GetSize (); i++)
             {
               std::ostringstream sin;
-              uint32_t nodeNumber = iter->first;
-              sin << nodeNumber;
-              std::string nodeId = sin.str();    
-              SendPing (nodeId, pingMessage);
+              sin << m_addressDirectory->GetNodeNumber (i);
+              SendPing (sin.str (), pingMessage);
             }
         }
     }
@@ -199,7 +269,7 @@ GUSearch::SendPing (std::string nodeId, std::string pingMessage)
 {
   // Send Ping Via-Chord layer 
   SEARCH_LOG ("Sending Ping via Chord Layer to node: " << nodeId << " Message: " << pingMessage);
-  Ipv4Address destAddress = ResolveNodeIpAddress(nodeId);
+  Ipv4Address destAddress = m_peers->GetAddress (nodeId);
   m_chord->SendPing (destAddress, pingMessage);
 }
 
@@ -210,9 +280,8 @@ GUSearch::SendGUSearchPing (Ipv4Address destAddress, std::string pingMessage)
     {
       uint32_t transactionId = GetNextTransactionId ();
       SEARCH_LOG ("Sending PING_REQ to Node: " << ReverseLookup(destAddress) << " IP: " << destAddress << " Message: " << pingMessage << " transactionId: " << transactionId);
-      Ptr<PingRequest> pingRequest = Create<PingRequest> (transactionId, Simulator::Now(), destAddress, pingMessage);
       // Add to ping-tracker
-      m_pingTracker.insert (std::make_pair (transactionId, pingRequest));
+      m_pingTracker.Track (transactionId, destAddress, pingMessage, m_pingRetries);
       Ptr<Packet> packet = Create<Packet> ();
       GUSearchMessage message = GUSearchMessage (GUSearchMessage::PING_REQ, transactionId);
       message.SetPingReq (pingMessage);
@@ -267,13 +336,10 @@ void
 GUSearch::ProcessPingRsp (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
 {
   // Remove from pingTracker
-  std::map<uint32_t, Ptr<PingRequest> >::iterator iter;
-  iter = m_pingTracker.find (message.GetTransactionId ());
-  if (iter != m_pingTracker.end ())
+  if (m_pingTracker.Complete (message.GetTransactionId ()))
     {
       std::string fromNode = ReverseLookup (sourceAddress);
       SEARCH_LOG ("Received PING_RSP, From Node: " << fromNode << ", Message: " << message.GetPingRsp().pingMessage);
-      m_pingTracker.erase (iter);
     }
   else
     {
@@ -282,25 +348,23 @@ GUSearch::ProcessPingRsp (GUSearchMessage message, Ipv4Address sourceAddress, ui
 }
 
 void
-GUSearch::AuditPings ()
+GUSearch::PingCompleted (const RequestTracker::Request &request, bool success)
 {
-  std::map<uint32_t, Ptr<PingRequest> >::iterator iter;
-  for (iter = m_pingTracker.begin () ; iter != m_pingTracker.end();)
+  if (!success)
     {
-      Ptr<PingRequest> pingRequest = iter->second;
-      if (pingRequest->GetTimestamp().GetMilliSeconds() + m_pingTimeout.GetMilliSeconds() <= Simulator::Now().GetMilliSeconds())
-        {
-          DEBUG_LOG ("Ping expired. Message: " << pingRequest->GetPingMessage () << " Timestamp: " << pingRequest->GetTimestamp().GetMilliSeconds () << " CurrentTime: " << Simulator::Now().GetMilliSeconds ());
-          // Remove stale entries
-          m_pingTracker.erase (iter++);
-        }
-      else
-        {
-          ++iter;
-        }
+      DEBUG_LOG ("Ping expired. Message: " << request.message << " Timestamp: " << request.timestamp.GetMilliSeconds () << " CurrentTime: " << Simulator::Now().GetMilliSeconds ());
     }
-  // Rechedule timer
-  m_auditPingsTimer.Schedule (m_pingTimeout); 
+}
+
+void
+GUSearch::PingRetry (const RequestTracker::Request &request)
+{
+  DEBUG_LOG ("Retrying PING_REQ to Node: " << ReverseLookup (request.destinationAddress) << " Attempt: " << (uint32_t) request.attempts << " transactionId: " << request.transactionId);
+  Ptr<Packet> packet = Create<Packet> ();
+  GUSearchMessage message = GUSearchMessage (GUSearchMessage::PING_REQ, request.transactionId);
+  message.SetPingReq (request.message);
+  packet->AddHeader (message);
+  m_socket->SendTo (packet, 0 , InetSocketAddress (request.destinationAddress, m_appPort));
 }
 
 void
@@ -374,6 +438,12 @@ GUSearch::HandleChordPingRecv (Ipv4Address destAddress, std::string message)
   SEARCH_LOG ("Chord Layer Received Ping! Source nodeId: " << ReverseLookup(destAddress) << " IP: " << destAddress << " Message: " << message);
 }
 
+void
+GUSearch::HandleChordDhashResult (uint32_t requestId, uint8_t status, const DHashStore::Value &value)
+{
+  SEARCH_LOG ("Chord Layer DHash Result! Request: " << requestId << " Status: " << (uint32_t) status << " Value: " << value.ToString ());
+}
+
 
 
 // Override GULog
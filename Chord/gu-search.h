@@ -21,8 +21,11 @@
 
 #include "ns3/gu-application.h"
 #include "ns3/gu-chord.h"
+#include "ns3/chord-peer-cache.h"
+#include "ns3/dhash-store.h"
 #include "ns3/gu-search-message.h"
-#include "ns3/ping-request.h"
+#include "ns3/request-tracker.h"
+#include "ns3/node-address-directory.h"
 
 #include "ns3/ipv4-address.h"
 #include <map>
@@ -34,6 +37,7 @@
 #include "ns3/timer.h"
 #include "ns3/uinteger.h"
 #include "ns3/boolean.h"
+#include "ns3/double.h"
 #include <fstream>
 
 using namespace ns3;
@@ -50,17 +54,28 @@ class GUSearch : public GUApplication
     void RecvMessage (Ptr<Socket> socket);
     void ProcessPingReq (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     void ProcessPingRsp (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
-    void AuditPings ();
+    void PingCompleted (const RequestTracker::Request &request, bool success);
+    void PingRetry (const RequestTracker::Request &request);
     uint32_t GetNextTransactionId ();
 
     // Chord Callbacks
     void HandleChordPingSuccess (Ipv4Address destAddress, std::string message);
     void HandleChordPingFailure (Ipv4Address destAddress, std::string message);
     void HandleChordPingRecv (Ipv4Address destAddress, std::string message);
+    void HandleChordDhashResult (uint32_t requestId, uint8_t status, const DHashStore::Value &value);
     void makeItable(std::string);
 
     // From GUApplication
     virtual void ProcessCommand (std::vector<std::string> tokens);
+    virtual void SetNodeAddressMap (std::map<uint32_t, Ipv4Address> nodeAddressMap);
+    virtual void SetAddressNodeMap (std::map<Ipv4Address, uint32_t> addressNodeMap);
+    virtual Ipv4Address ResolveNodeIpAddress (std::string nodeId);
+    /**
+     * \brief Shares the directory the helper built for every node with this
+     * application and its Chord layer; the map setters are then ignored.
+     */
+    void SetAddressDirectory (Ptr<NodeAddressDirectory> directory);
+    virtual std::string ReverseLookup (Ipv4Address ipv4Address);
     // From GULog
     virtual void SetTrafficVerbose (bool on);
     virtual void SetErrorVerbose (bool on);
@@ -76,15 +91,26 @@ class GUSearch : public GUApplication
     virtual void StartApplication (void);
     virtual void StopApplication (void);
 
+    /**
+     * \returns the number of ring positions this host takes, VirtualNodes
+     * scaled by its Weight.
+     */
+    uint32_t GetVirtualNodeCount ();
+
     Ptr<GUChord> m_chord;
+    uint16_t m_chordVirtualNodes;
+    double m_weight;
+    Ptr<ChordPeerCache> m_peers;
+    // Shared with the Chord layer and, from the helper, every other module
+    Ptr<NodeAddressDirectory> m_addressDirectory;
+    bool m_sharedDirectory;
     uint32_t m_currentTransactionId;
     Ptr<Socket> m_socket;
     Time m_pingTimeout;
+    uint8_t m_pingRetries;
     uint16_t m_appPort, m_chordPort;
-    // Timers
-    Timer m_auditPingsTimer;
     // Ping tracker
-    std::map<uint32_t, Ptr<PingRequest> > m_pingTracker;
+    RequestTracker m_pingTracker;
     std::map<std::string, std::vector<std::string> > iTable;
     //std::map<std::string, std::vector<std::string> >::iterator it;
 };
@@ -18,11 +18,80 @@
 #include "ns3/log.h"
 #include "ns3/simulator.h"
 
+#include <algorithm>
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("LSMessage");
 NS_OBJECT_ENSURE_REGISTERED (LSMessage);
 
+static inline uint32_t
+VarintSize (uint32_t value)
+{
+  uint32_t size = 1;
+  while (value >= 0x80)
+    {
+      value >>= 7;
+      size++;
+    }
+  return size;
+}
+
+static inline void
+WriteVarint (std::vector<uint8_t> &out, uint32_t value)
+{
+  while (value >= 0x80)
+    {
+      out.push_back ((uint8_t) (value | 0x80));
+      value >>= 7;
+    }
+  out.push_back ((uint8_t) value);
+}
+
+static inline void
+WriteVarint (Buffer::Iterator &start, uint32_t value)
+{
+  while (value >= 0x80)
+    {
+      start.WriteU8 ((uint8_t) (value | 0x80));
+      value >>= 7;
+    }
+  start.WriteU8 ((uint8_t) value);
+}
+
+static inline uint32_t
+ReadVarint (Buffer::Iterator &start, uint32_t &size)
+{
+  uint32_t value = 0;
+  for (uint32_t shift = 0; shift < 35; shift += 7)
+    {
+      uint8_t byte = start.ReadU8 ();
+      size++;
+      value |= (uint32_t) (byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        {
+          break;
+        }
+    }
+  return value;
+}
+
+static inline bool
+ReadVarint (const std::vector<uint8_t> &in, size_t &pos, uint32_t &value)
+{
+  value = 0;
+  for (uint32_t shift = 0; shift < 35 && pos < in.size (); shift += 7)
+    {
+      uint8_t byte = in[pos++];
+      value |= (uint32_t) (byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
 LSMessage::LSMessage ()
 {
 }
@@ -78,6 +147,9 @@ LSMessage::GetSerializedSize (void) const
       case LSP:
 	size += m_message.lsp.GetSerializedSize ();
 	break;
+      case DB_SUMMARY:
+	size += m_message.dbSummary.GetSerializedSize ();
+	break;
       default:
         NS_ASSERT (false);
     }
@@ -108,9 +180,12 @@ LSMessage::Print (std::ostream &os) const
       case ND_RSP:
         m_message.pingRsp.Print (os);
         break;
-//      case LSP:
-//	m_message.lsp.Print (os);
-//	break;
+      case LSP:
+        m_message.lsp.Print (os);
+        break;
+      case DB_SUMMARY:
+        m_message.dbSummary.Print (os);
+        break;
       default:
         break;  
     }
@@ -143,6 +218,9 @@ LSMessage::Serialize (Buffer::Iterator start) const
       case LSP:
 	m_message.lsp.Serialize (i);
  	break;
+      case DB_SUMMARY:
+	m_message.dbSummary.Serialize (i);
+	break;
       default:
         NS_ASSERT (false);   
     }
@@ -177,6 +255,9 @@ LSMessage::Deserialize (Buffer::Iterator start)
       case LSP:
 	size += m_message.lsp.Deserialize (i);
 	break;
+      case DB_SUMMARY:
+	size += m_message.dbSummary.Deserialize (i);
+	break;
       default:
         NS_ASSERT (false);
     }
@@ -419,46 +500,107 @@ uint32_t
 LSMessage::Lsp::GetSerializedSize (void) const
 {
   uint32_t size;
-  size = 3*sizeof(uint32_t)*ntable.size + sizeof(uint32_t) + sizeof(uint32_t);
+  size = sizeof(uint8_t) + VarintSize (links.size ()) + VarintSize (encodedLinks.size ()) + encodedLinks.size ();
   return size;
 }
-/*
+
 void
 LSMessage::Lsp::Print (std::ostream &os) const
 {
-  os << "NdReq:: Message: " << ndMessage << "\n";
+  os << "Lsp:: Version: " << (uint32_t) version << " Links:";
+  for (size_t i = 0; i < links.size (); i++)
+    {
+      os << " " << links[i].nodeNumber << "(" << links[i].metric << ")";
+    }
+  os << "\n";
 }
-*/
+
+void
+LSMessage::Lsp::Encode ()
+{
+  // Node numbers are sorted and delta coded so dense ids take one byte
+  std::vector<lsdbLink> sorted = links;
+  std::sort (sorted.begin (), sorted.end ());
+  encodedLinks.clear ();
+  encodedLinks.reserve (sorted.size () * 3);
+  uint32_t previous = 0;
+  for (size_t i = 0; i < sorted.size (); i++)
+    {
+      WriteVarint (encodedLinks, sorted[i].nodeNumber - previous);
+      WriteVarint (encodedLinks, sorted[i].metric);
+      previous = sorted[i].nodeNumber;
+    }
+  links.swap (sorted);
+}
+
+bool
+LSMessage::Lsp::Decode ()
+{
+  size_t pos = 0;
+  uint32_t previous = 0;
+  for (size_t i = 0; i < links.size (); i++)
+    {
+      uint32_t delta, metric;
+      if (!ReadVarint (encodedLinks, pos, delta) || !ReadVarint (encodedLinks, pos, metric))
+        {
+          links.clear ();
+          return false;
+        }
+      previous += delta;
+      links[i].nodeNumber = previous;
+      links[i].metric = metric > 0xFFFF ? 0xFFFF : metric;
+    }
+  return pos == encodedLinks.size ();
+}
+
 void
 LSMessage::Lsp::Serialize (Buffer::Iterator &start) const
 {
-  start.WriteHtonU32 (ntable.size);
-  for(int i = 0; i < ntable.size; i++){
-  start.WriteU32 (ntable.at(i).nodeNumber);
-  start.WriteU32 (ntable.at(i).NeighborAddress.Get());
-  start.WriteU32 (ntable.at(i).InterfaceAddress.Get());
-  }
-  start.WriteU32 (sourceAddress.Get());
+  start.WriteU8 (version);
+  WriteVarint (start, links.size ());
+  WriteVarint (start, encodedLinks.size ());
+  if (!encodedLinks.empty ())
+    {
+      start.Write (&encodedLinks[0], encodedLinks.size ());
+    }
 }
 
 uint32_t
 LSMessage::Lsp::Deserialize (Buffer::Iterator &start)
 {
-  int size = (int)start.ReadNtohU32();
-  for(int i = 0; i < size; i++)
-{
-  uint32_t nodeId = uint32_t(start.ReadU32());
-  Ipv4Address neighborAddress = Ipv4Address (start.ReadU32 ());
-  Ipv4Address interfaceAddress = Ipv4Address (start.ReadU32 ());
-  nTableEntry nEntry (neighborAddress, interfaceAddress, nodeId, Simulator::Now());
-  ntable.nTableInsert(nEntry);
-}
-  sourceAddress = Ipv4Address (start.ReadU32());
-  return Lsp::GetSerializedSize ();
+  uint32_t size = sizeof(uint8_t);
+  version = start.ReadU8 ();
+  links.clear ();
+  encodedLinks.clear ();
+  if (version != LSP_VERSION_COMPACT)
+    {
+      // Unknown encoding, ProcessLsp drops it
+      return size;
+    }
+  uint32_t count = ReadVarint (start, size);
+  uint32_t length = ReadVarint (start, size);
+  // Each link takes at least two bytes and the LSP fits a datagram
+  if (count > length / 2 || length > 0xFFFF)
+    {
+      version = 0;
+      return size;
+    }
+  encodedLinks.resize (length);
+  if (length > 0)
+    {
+      start.Read (&encodedLinks[0], length);
+    }
+  size += length;
+  links.resize (count);
+  if (!Decode ())
+    {
+      version = 0;
+    }
+  return size;
 }
 
 void
-LSMessage::SetLsp (neighborTable nTable, Ipv4Address sourceAddress)
+LSMessage::SetLsp (const std::vector<lsdbLink> &links)
 {
   if (m_messageType == 0)
     {
@@ -468,8 +610,9 @@ LSMessage::SetLsp (neighborTable nTable, Ipv4Address sourceAddress)
     {
       NS_ASSERT (m_messageType == LSP);
     }
-  m_message.lsp.sourceAddress = sourceAddress;
-  m_message.lsp.ntable = nTable;
+  m_message.lsp.version = LSP_VERSION_COMPACT;
+  m_message.lsp.links = links;
+  m_message.lsp.Encode ();
 }
 
 LSMessage::Lsp
@@ -478,6 +621,107 @@ LSMessage::GetLsp ()
   return m_message.lsp;
 }
 
+/* DB_SUMMARY */
+
+uint32_t
+LSMessage::DbSummary::GetSerializedSize (void) const
+{
+  uint32_t size = sizeof(uint8_t) + 2 * sizeof(uint32_t) + VarintSize (entries.size ());
+  uint32_t previous = 0;
+  for (size_t i = 0; i < entries.size (); i++)
+    {
+      size += VarintSize (entries[i].first - previous) + sizeof(uint32_t);
+      previous = entries[i].first;
+    }
+  return size;
+}
+
+void
+LSMessage::DbSummary::Print (std::ostream &os) const
+{
+  os << "DbSummary:: ReplyRequested: " << replyRequested << " Range: " << rangeStart << "-" << rangeEnd << " Entries:";
+  for (size_t i = 0; i < entries.size (); i++)
+    {
+      os << " " << entries[i].first << "/" << entries[i].second;
+    }
+  os << "\n";
+}
+
+void
+LSMessage::DbSummary::Serialize (Buffer::Iterator &start) const
+{
+  // Originators are delta coded like LSP links, sequence numbers are fixed width
+  start.WriteU8 (replyRequested ? 1 : 0);
+  start.WriteHtonU32 (rangeStart);
+  start.WriteHtonU32 (rangeEnd);
+  WriteVarint (start, entries.size ());
+  uint32_t previous = 0;
+  for (size_t i = 0; i < entries.size (); i++)
+    {
+      WriteVarint (start, entries[i].first - previous);
+      start.WriteHtonU32 (entries[i].second);
+      previous = entries[i].first;
+    }
+}
+
+uint32_t
+LSMessage::DbSummary::Deserialize (Buffer::Iterator &start)
+{
+  uint32_t size = sizeof(uint8_t) + 2 * sizeof(uint32_t);
+  replyRequested = (start.ReadU8 () != 0);
+  rangeStart = start.ReadNtohU32 ();
+  rangeEnd = start.ReadNtohU32 ();
+  entries.clear ();
+  uint32_t count = ReadVarint (start, size);
+  // Senders split summaries into pieces of DB_SUMMARY_MAX_ENTRIES
+  valid = (count <= DB_SUMMARY_MAX_ENTRIES && rangeStart <= rangeEnd);
+  if (!valid)
+    {
+      // ProcessDbSummary drops it
+      return size;
+    }
+  entries.reserve (count);
+  uint32_t previous = 0;
+  for (uint32_t i = 0; i < count; i++)
+    {
+      previous += ReadVarint (start, size);
+      uint32_t sequenceNumber = start.ReadNtohU32 ();
+      size += sizeof(uint32_t);
+      if (previous < rangeStart || previous > rangeEnd)
+        {
+          valid = false;
+        }
+      entries.push_back (std::make_pair (previous, sequenceNumber));
+    }
+  return size;
+}
+
+void
+LSMessage::SetDbSummary (const std::vector<std::pair<uint32_t, uint32_t> > &entries, bool replyRequested,
+                         uint32_t rangeStart, uint32_t rangeEnd)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = DB_SUMMARY;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == DB_SUMMARY);
+    }
+  m_message.dbSummary.replyRequested = replyRequested;
+  m_message.dbSummary.rangeStart = rangeStart;
+  m_message.dbSummary.rangeEnd = rangeEnd;
+  m_message.dbSummary.entries = entries;
+  m_message.dbSummary.valid = true;
+  std::sort (m_message.dbSummary.entries.begin (), m_message.dbSummary.entries.end ());
+}
+
+LSMessage::DbSummary
+LSMessage::GetDbSummary ()
+{
+  return m_message.dbSummary;
+}
+
 
 //
 //
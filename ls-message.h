@@ -26,6 +26,10 @@
 using namespace ns3;
 
 #define IPV4_ADDRESS_SIZE 4
+// Compact LSP payload: varint delta-coded node numbers with per-link metrics
+#define LSP_VERSION_COMPACT 2
+// Entries per DB_SUMMARY datagram; at most 9 bytes each, so a piece fits the MTU
+#define DB_SUMMARY_MAX_ENTRIES 128
 
 class LSMessage : public Header
 {
@@ -41,6 +45,7 @@ class LSMessage : public Header
 	ND_REQ = 3,
 	ND_RSP = 4,
 	LSP = 5,
+	DB_SUMMARY = 6,
         // Define extra message types when needed       
       };
 
@@ -154,12 +159,40 @@ class LSMessage : public Header
       };
     struct Lsp
       {
-	void print (std::ostream &os) const;
-	uint32_t GetSerializedSize(void) const;
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize(void) const;
         void Serialize (Buffer::Iterator &start) const;
         uint32_t Deserialize (Buffer::Iterator &start);
-	Ipv4Address sourceAddress;
-	neighborTable ntable;
+        /**
+         *  \brief Encodes links into encodedLinks in one pass
+         */
+        void Encode ();
+        /**
+         *  \brief Decodes encodedLinks into links in one pass
+         *  \returns false if the payload is malformed
+         */
+        bool Decode ();
+        // Payload (the originator is carried in the message header)
+        uint8_t version;
+        std::vector<lsdbLink> links;
+        std::vector<uint8_t> encodedLinks;
+      };
+
+    struct DbSummary
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        // Payload
+        bool replyRequested;
+        // Originator numbers this piece of the summary covers, inclusive
+        uint32_t rangeStart;
+        uint32_t rangeEnd;
+        // (originator number, sequence number), sorted by originator
+        std::vector<std::pair<uint32_t, uint32_t> > entries;
+        // Not on the wire; false if the payload was malformed
+        bool valid;
       };
 
   private:
@@ -170,6 +203,7 @@ class LSMessage : public Header
 	NdReq ndReq;
 	NdRsp ndRsp;
 	Lsp lsp;
+	DbSummary dbSummary;
       } m_message;
     
   public:
@@ -205,8 +239,23 @@ class LSMessage : public Header
 
     void SetNdRsp (Ipv4Address destinationAddress, Ipv4Address sourceAddress);
 
-    void SetLsp(neighborTable, Ipv4Address sourceAddress);
-    Lsp GetLsp();
+    /**
+     *  \brief Sets LSP payload
+     *  \param links Adjacencies of the originator, encoded once here
+     */
+    void SetLsp (const std::vector<lsdbLink> &links);
+    Lsp GetLsp ();
+
+    /**
+     *  \brief Sets DB_SUMMARY payload
+     *  \param entries (originator, sequence number) of every LSDB entry in the range
+     *  \param replyRequested true if the receiver should answer with its own summary
+     *  \param rangeStart First originator number the summary covers
+     *  \param rangeEnd Last originator number the summary covers
+     */
+    void SetDbSummary (const std::vector<std::pair<uint32_t, uint32_t> > &entries, bool replyRequested,
+                       uint32_t rangeStart, uint32_t rangeEnd);
+    DbSummary GetDbSummary ();
 
 }; // class LSMessage
 
@@ -27,7 +27,8 @@ LSRoutingHelper::LSRoutingHelper ()
 }
 
 LSRoutingHelper::LSRoutingHelper (const LSRoutingHelper &o)
-  :  m_lsFactory (o.m_lsFactory)
+  :  m_lsFactory (o.m_lsFactory),
+     m_addressDirectory (o.m_addressDirectory)
 {
 }
 
@@ -42,6 +43,10 @@ LSRoutingHelper::Create (Ptr<Node> node) const
 {
   Ptr<LSRoutingProtocol> lsProto = m_lsFactory.Create<LSRoutingProtocol> ();
   node->AggregateObject (lsProto); 
+  if (m_addressDirectory != 0)
+    {
+      lsProto->SetAddressDirectory (m_addressDirectory);
+    }
   return lsProto;
 }
 
@@ -51,3 +56,22 @@ LSRoutingHelper::Set (std::string name, const AttributeValue &value)
   m_lsFactory.Set (name, value);
 }
 
+void
+LSRoutingHelper::SetNodeAddressMaps (const std::map<uint32_t, Ipv4Address> &nodeAddressMap,
+                                     const std::map<Ipv4Address, uint32_t> &addressNodeMap)
+{
+  m_addressDirectory = ns3::Create<NodeAddressDirectory> (nodeAddressMap, addressNodeMap);
+}
+
+void
+LSRoutingHelper::SetAddressDirectory (Ptr<NodeAddressDirectory> directory)
+{
+  m_addressDirectory = directory;
+}
+
+Ptr<NodeAddressDirectory>
+LSRoutingHelper::GetAddressDirectory () const
+{
+  return m_addressDirectory;
+}
+
@@ -41,9 +41,23 @@ class LSRoutingHelper : public Ipv4RoutingHelper
 
     void Set (std::string name, const AttributeValue &value);
 
+    /**
+     * \brief Builds one address directory from the topology maps and hands
+     * it to every protocol Create () makes.
+     */
+    void SetNodeAddressMaps (const std::map<uint32_t, Ipv4Address> &nodeAddressMap,
+                             const std::map<Ipv4Address, uint32_t> &addressNodeMap);
+    /**
+     * \brief Hands directory, such as another helper's, to every protocol
+     * Create () makes.
+     */
+    void SetAddressDirectory (Ptr<NodeAddressDirectory> directory);
+    Ptr<NodeAddressDirectory> GetAddressDirectory () const;
+
   private:
     LSRoutingHelper &operator = (const LSRoutingHelper &o);
     ObjectFactory m_lsFactory;
+    Ptr<NodeAddressDirectory> m_addressDirectory;
 };
 
 #endif
@@ -16,6 +16,7 @@
 
 #include <sstream>
 #include "ns3/ls-routing-protocol.h"
+#include "ns3/lsdb-snapshot.h"
 #include "ns3/socket-factory.h"
 #include "ns3/udp-socket-factory.h"
 #include "ns3/simulator.h"
@@ -25,8 +26,11 @@
 #include "ns3/ipv4-header.h"
 #include "ns3/ipv4-route.h"
 #include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+#include "ns3/string.h"
 #include "ns3/test-result.h"
 #include <sys/time.h>
+#include <set>
 
 using namespace ns3;
 
@@ -59,6 +63,51 @@ LSRoutingProtocol::GetTypeId (void)
                  TimeValue (MilliSeconds (10000)),
                  MakeTimeAccessor (&LSRoutingProtocol::m_ndLong),
                  MakeTimeChecker ())
+  .AddAttribute ("HelloInterval",
+                 "Interval between ND_REQ hello broadcasts in milliseconds",
+                 TimeValue (MilliSeconds (3000)),
+                 MakeTimeAccessor (&LSRoutingProtocol::m_helloInterval),
+                 MakeTimeChecker ())
+  .AddAttribute ("LspRefreshInterval",
+                 "Interval between refreshes of this node's LSP in milliseconds",
+                 TimeValue (MilliSeconds (10000)),
+                 MakeTimeAccessor (&LSRoutingProtocol::m_lspRefreshInterval),
+                 MakeTimeChecker ())
+  .AddAttribute ("LspMaxAge",
+                 "Age in milliseconds after which an LSP that was not refreshed is purged",
+                 TimeValue (MilliSeconds (35000)),
+                 MakeTimeAccessor (&LSRoutingProtocol::m_lspMaxAge),
+                 MakeTimeChecker ())
+  .AddAttribute ("RttMetric",
+                 "Derive link metrics from measured ND round-trip times",
+                 BooleanValue (false),
+                 MakeBooleanAccessor (&LSRoutingProtocol::m_rttMetric),
+                 MakeBooleanChecker ())
+  .AddAttribute ("RttMetricUnit",
+                 "Round-trip time worth one metric unit, in microseconds",
+                 TimeValue (MicroSeconds (100)),
+                 MakeTimeAccessor (&LSRoutingProtocol::m_rttMetricUnit),
+                 MakeTimeChecker ())
+  .AddAttribute ("DefaultMetric",
+                 "Metric of links without a static or measured metric",
+                 UintegerValue (1),
+                 MakeUintegerAccessor (&LSRoutingProtocol::m_defaultMetric),
+                 MakeUintegerChecker<uint16_t> (1, 0xFFFF))
+  .AddAttribute ("InterfaceMetrics",
+                 "Static link metrics per interface index, e.g. \"1=10 2=40\"",
+                 StringValue (""),
+                 MakeStringAccessor (&LSRoutingProtocol::m_interfaceMetricsConfig),
+                 MakeStringChecker ())
+  .AddAttribute ("SnapshotFile",
+                 "Checkpoint file loaded at start and written by CHECKPOINT",
+                 StringValue (""),
+                 MakeStringAccessor (&LSRoutingProtocol::m_snapshotFile),
+                 MakeStringChecker ())
+  .AddAttribute ("SnapshotInterval",
+                 "Interval between automatic checkpoints, zero to disable",
+                 TimeValue (Seconds (0)),
+                 MakeTimeAccessor (&LSRoutingProtocol::m_snapshotInterval),
+                 MakeTimeChecker ())
 
   .AddAttribute ("MaxTTL",
                  "Maximum TTL value for LS packets",
@@ -70,14 +119,18 @@ LSRoutingProtocol::GetTypeId (void)
 }
 
 LSRoutingProtocol::LSRoutingProtocol ()
-  : m_auditPingsTimer (Timer::CANCEL_ON_DESTROY), m_checkNeighborTimer (Timer::CANCEL_ON_DESTROY)
+  : m_checkNeighborTimer (Timer::CANCEL_ON_DESTROY), m_helloTimer (Timer::CANCEL_ON_DESTROY),
+    m_lspRefreshTimer (Timer::CANCEL_ON_DESTROY), m_snapshotTimer (Timer::CANCEL_ON_DESTROY)
 {
   RandomVariable random;
   SeedManager::SetSeed (time (NULL));
   random = UniformVariable (0x00000000, 0xFFFFFFFF);
   m_currentSequenceNumber = random.GetInteger ();
+  m_helloSequenceNumber = 0;
   // Setup static routing 
   m_staticRouting = Create<Ipv4StaticRouting> ();
+  m_addressDirectory = Create<NodeAddressDirectory> ();
+  m_sharedDirectory = false;
 }
 
 LSRoutingProtocol::~LSRoutingProtocol ()
@@ -99,10 +152,12 @@ LSRoutingProtocol::DoDispose ()
   m_staticRouting = 0;
 
   // Cancel timers
-  m_auditPingsTimer.Cancel ();
   m_checkNeighborTimer.Cancel(); 
+  m_helloTimer.Cancel ();
+  m_lspRefreshTimer.Cancel ();
+  m_snapshotTimer.Cancel ();
 
-  m_pingTracker.clear (); 
+  m_pingTracker.Clear (); 
 //  m_checkNeighborTimer.clear();
 
   GURoutingProtocol::DoDispose ();
@@ -117,38 +172,46 @@ LSRoutingProtocol::SetMainInterface (uint32_t mainInterface)
 void
 LSRoutingProtocol::SetNodeAddressMap (std::map<uint32_t, Ipv4Address> nodeAddressMap)
 {
-  m_nodeAddressMap = nodeAddressMap;
+  // Fallback for callers without a helper; a shared directory is not ours
+  // to change
+  if (!m_sharedDirectory)
+    {
+      m_addressDirectory->BuildNodes (nodeAddressMap);
+    }
 }
 
 void
 LSRoutingProtocol::SetAddressNodeMap (std::map<Ipv4Address, uint32_t> addressNodeMap)
 {
-  m_addressNodeMap = addressNodeMap;
+  if (!m_sharedDirectory)
+    {
+      m_addressDirectory->BuildAddresses (addressNodeMap);
+    }
+}
+
+void
+LSRoutingProtocol::SetAddressDirectory (Ptr<NodeAddressDirectory> directory)
+{
+  m_addressDirectory = directory;
+  m_sharedDirectory = true;
 }
 
 Ipv4Address
 LSRoutingProtocol::ResolveNodeIpAddress (uint32_t nodeNumber)
 {
-  std::map<uint32_t, Ipv4Address>::iterator iter = m_nodeAddressMap.find (nodeNumber);
-  if (iter != m_nodeAddressMap.end ())
-    { 
-      return iter->second;
-    }
-  return Ipv4Address::GetAny ();
+  return m_addressDirectory->Resolve (nodeNumber);
+}
+
+bool
+LSRoutingProtocol::LookupNodeNumber (Ipv4Address ipAddress, uint32_t &nodeNumber)
+{
+  return m_addressDirectory->LookupNodeNumber (ipAddress, nodeNumber);
 }
 
 std::string
 LSRoutingProtocol::ReverseLookup (Ipv4Address ipAddress)
 {
-  std::map<Ipv4Address, uint32_t>::iterator iter = m_addressNodeMap.find (ipAddress);
-  if (iter != m_addressNodeMap.end ())
-    { 
-      std::ostringstream sin;
-      uint32_t nodeNumber = iter->second;
-      sin << nodeNumber;    
-      return sin.str();
-    }
-  return "Unknown";
+  return m_addressDirectory->ReverseLookup (ipAddress);
 }
 
 void
@@ -174,23 +237,133 @@ LSRoutingProtocol::DoStart ()
       socket->BindToNetDevice (netDevice);
       m_socketAddresses[socket] = m_ipv4->GetAddress (i, 0);
     }
+  ParseInterfaceMetrics ();
+  // Configure ping tracker
+  m_pingTracker.SetTimeout (m_pingTimeout);
+  m_pingTracker.SetCompletionCallback (MakeCallback (&LSRoutingProtocol::PingCompleted, this));
   // Configure timers
-  m_auditPingsTimer.SetFunction (&LSRoutingProtocol::AuditPings, this);
   m_checkNeighborTimer.SetFunction (&LSRoutingProtocol::checkNTEntry, this);
+  m_helloTimer.SetFunction (&LSRoutingProtocol::SendHello, this);
+  m_lspRefreshTimer.SetFunction (&LSRoutingProtocol::RefreshLsp, this);
+  m_snapshotTimer.SetFunction (&LSRoutingProtocol::PeriodicSnapshot, this);
 
   // Start timers
-  m_auditPingsTimer.Schedule (m_pingTimeout);
   m_checkNeighborTimer.Schedule (m_ndTimeout);
+  m_lspRefreshTimer.Schedule (JitteredInterval (m_lspRefreshInterval));
+  if (!m_snapshotFile.empty () && m_snapshotInterval.IsStrictlyPositive ())
+    {
+      m_snapshotTimer.Schedule (m_snapshotInterval);
+    }
 
-        uint32_t sequenceNumber = GetNextSequenceNumber ();
-      TRAFFIC_LOG ("Sending ND_REQ from Node: " << ReverseLookup(m_mainAddress)  << " IP: " << m_mainAddress << " SequenceNumber: " << sequenceNumber);
-      Ptr<Packet> packet = Create<Packet> ();
-      LSMessage lsMessage = LSMessage (LSMessage::ND_REQ, sequenceNumber, 1, m_mainAddress);
-      lsMessage.SetNdReq ();
-      packet->AddHeader (lsMessage);
-      BroadcastPacket (packet);
+  // Warm restart: forward on the checkpointed routes and ask the neighbors
+  // for whatever changed while we were down
+  if (!m_snapshotFile.empty () && LoadSnapshot (m_snapshotFile))
+    {
+      SendDbSummary (Ipv4Address::GetAny (), true);
+    }
 
+  SendHello ();
+}
 
+void
+LSRoutingProtocol::SendHello ()
+{
+  uint32_t sequenceNumber = GetNextSequenceNumber ();
+  TRAFFIC_LOG ("Sending ND_REQ from Node: " << ReverseLookup(m_mainAddress)  << " IP: " << m_mainAddress << " SequenceNumber: " << sequenceNumber);
+  Ptr<Packet> packet = Create<Packet> ();
+  LSMessage lsMessage = LSMessage (LSMessage::ND_REQ, sequenceNumber, 1, m_mainAddress);
+  lsMessage.SetNdReq ();
+  packet->AddHeader (lsMessage);
+  m_helloSequenceNumber = sequenceNumber;
+  m_helloSent = Simulator::Now ();
+  BroadcastPacket (packet);
+  m_helloTimer.Schedule (JitteredInterval (m_helloInterval));
+}
+
+void
+LSRoutingProtocol::ParseInterfaceMetrics ()
+{
+  m_interfaceMetrics.clear ();
+  std::string config = m_interfaceMetricsConfig;
+  for (size_t i = 0; i < config.size (); i++)
+    {
+      if (config[i] == ',' || config[i] == '=')
+        {
+          config[i] = ' ';
+        }
+    }
+  std::istringstream sin (config);
+  uint32_t interface, metric;
+  while (sin >> interface >> metric)
+    {
+      if (metric == 0 || metric > 0xFFFF)
+        {
+          ERROR_LOG ("Invalid metric " << metric << " for interface " << interface);
+          continue;
+        }
+      m_interfaceMetrics[interface] = metric;
+    }
+}
+
+uint16_t
+LSRoutingProtocol::ComputeLinkMetric (const nTableEntry &entry)
+{
+  uint32_t interface;
+  Ipv4Address localAddress;
+  if (FindInterfaceForNextHop (entry.InterfaceAddress, interface, localAddress))
+    {
+      std::map<uint32_t, uint16_t>::iterator iter = m_interfaceMetrics.find (interface);
+      if (iter != m_interfaceMetrics.end ())
+        {
+          return iter->second;
+        }
+    }
+  if (m_rttMetric && !entry.rtt.IsZero () && m_rttMetricUnit.IsStrictlyPositive ())
+    {
+      uint64_t metric = entry.rtt.GetNanoSeconds () / m_rttMetricUnit.GetNanoSeconds ();
+      if (metric < 1)
+        {
+          return 1;
+        }
+      return metric > 0xFFFF ? 0xFFFF : metric;
+    }
+  return m_defaultMetric;
+}
+
+bool
+LSRoutingProtocol::UpdateNeighborRtt (Ipv4Address neighborAddress, Ipv4Address interfaceAddress, Time sample)
+{
+  nTableEntry *entry = nTable.find (neighborAddress, interfaceAddress);
+  if (entry == 0)
+    {
+      return false;
+    }
+  // Smoothed as in TCP: srtt = 7/8 srtt + 1/8 sample
+  if (entry->rtt.IsZero ())
+    {
+      entry->rtt = sample;
+    }
+  else
+    {
+      entry->rtt = NanoSeconds ((7 * entry->rtt.GetNanoSeconds () + sample.GetNanoSeconds ()) / 8);
+    }
+  // Re-advertise only on changes above 25% so RTT noise does not cause floods
+  uint16_t metric = ComputeLinkMetric (*entry);
+  uint32_t difference = metric > entry->metric ? metric - entry->metric : entry->metric - metric;
+  if (4 * difference > entry->metric)
+    {
+      entry->metric = metric;
+      return true;
+    }
+  return false;
+}
+
+Time
+LSRoutingProtocol::JitteredInterval (Time interval)
+{
+  // Desynchronize periodic floods of neighboring nodes
+  UniformVariable jitter (0.75, 1.25);
+  return MilliSeconds ((uint64_t) (interval.GetMilliSeconds () * jitter.GetValue ()));
 }
 
 Ptr<Ipv4Route>
@@ -299,9 +472,8 @@ LSRoutingProtocol::ProcessCommand (std::vector<std::string> tokens)
         {
           uint32_t sequenceNumber = GetNextSequenceNumber ();
           TRAFFIC_LOG ("Sending PING_REQ to Node: " << nodeNumber << " IP: " << destAddress << " Message: " << pingMessage << " SequenceNumber: " << sequenceNumber);
-          Ptr<PingRequest> pingRequest = Create<PingRequest> (sequenceNumber, Simulator::Now(), destAddress, pingMessage);
           // Add to ping-tracker
-          m_pingTracker.insert (std::make_pair (sequenceNumber, pingRequest));
+          m_pingTracker.Track (sequenceNumber, destAddress, pingMessage);
           Ptr<Packet> packet = Create<Packet> ();
           LSMessage lsMessage = LSMessage (LSMessage::PING_REQ, sequenceNumber, m_maxTTL, m_mainAddress);
           lsMessage.SetPingReq (destAddress, pingMessage);
@@ -319,6 +491,28 @@ LSRoutingProtocol::ProcessCommand (std::vector<std::string> tokens)
       packet->AddHeader (lsMessage);
       BroadcastPacket (packet);
     }*/
+  else if (command == "CHECKPOINT")
+    {
+      std::string path = m_snapshotFile;
+      if (tokens.size() >= 2)
+        {
+          iterator++;
+          path = *iterator;
+        }
+      if (path.empty ())
+        {
+          ERROR_LOG ("No snapshot file given!");
+          return;
+        }
+      if (SaveSnapshot (path))
+        {
+          STATUS_LOG ("Checkpoint written to " << path);
+        }
+      else
+        {
+          ERROR_LOG ("Failed to write checkpoint " << path);
+        }
+    }
   else if (command == "DUMP")
     {
       if (tokens.size() < 2)
@@ -349,6 +543,22 @@ LSRoutingProtocol::DumpLSA ()
   STATUS_LOG (std::endl << "**************** LSA DUMP ********************" << std::endl
               << "Node\t\tNeighbor(s)");
   PRINT_LOG ("");
+
+  // Read only: aged entries are hidden here and purged when the LSDB is next used
+  for (linkStateDatabase::const_iterator iter = lsdb.begin (); iter != lsdb.end (); iter++)
+    {
+      if (Simulator::Now () > m_lspMaxAge && iter->second.installed < Simulator::Now () - m_lspMaxAge)
+        {
+          continue;
+        }
+      std::ostringstream neighbors;
+      for (size_t i = 0; i < iter->second.links.size (); i++)
+        {
+          neighbors << iter->second.links[i].nodeNumber << "(" << iter->second.links[i].metric << ") ";
+        }
+      PRINT_LOG (iter->second.originatorNumber << "\t\t" << neighbors.str () << "\t\tSeq: " << iter->second.sequenceNumber
+                 << " Age: " << (Simulator::Now () - iter->second.installed).GetMilliSeconds () << "ms");
+    }
 }
 
 void
@@ -433,6 +643,9 @@ LSRoutingProtocol::RecvLSMessage (Ptr<Socket> socket)
 //	PRINT_LOG("This is the source(interace) address " << sourceAddress << std::endl)
 	ProcessNdRsp (lsMessage);
 	break;
+      case LSMessage::DB_SUMMARY:
+	ProcessDbSummary (lsMessage, sourceAddress);
+	break;
       case LSMessage::LSP:
 	ProcessLsp(lsMessage);
 	break;
@@ -465,13 +678,10 @@ LSRoutingProtocol::ProcessPingRsp (LSMessage lsMessage)
   if (IsOwnAddress (lsMessage.GetPingRsp().destinationAddress))
     {
       // Remove from pingTracker
-      std::map<uint32_t, Ptr<PingRequest> >::iterator iter;
-      iter = m_pingTracker.find (lsMessage.GetSequenceNumber ());
-      if (iter != m_pingTracker.end ())
+      if (m_pingTracker.Complete (lsMessage.GetSequenceNumber ()))
         {
           std::string fromNode = ReverseLookup (lsMessage.GetOriginatorAddress ());
           TRAFFIC_LOG ("Received PING_RSP, From Node: " << fromNode << ", Message: " << lsMessage.GetPingRsp().pingMessage);
-          m_pingTracker.erase (iter);
         }
       else
         {
@@ -533,142 +743,542 @@ LSRoutingProtocol::ProcessNdRsp (LSMessage lsMessage)
   // Check destination address
   if (IsOwnAddress (lsMessage.GetNdRsp().destinationAddress))
     {
-//      std::map<uint32_t, Ptr<NdRequest> >::iterator iter;
-//      iter = m_pingTracker.find (lsMessage.GetSequenceNumber ());
-//      if (iter != m_pingTracker.end ())
-//        {
-	// add to neighbor table entry
-//	PRINT_LOG("OriginatorAddress is  " << lsMessage.GetOriginatorAddress() << "  mainAddress is  " << m_mainAddress << std::endl);
-	  Ipv4Address interfaceAddress = lsMessage.GetOriginatorAddress ();
-	  Ipv4Address sceAddress = lsMessage.GetNdRsp().sourceAddress;
-uint32_t nodeNumber;
-  std::map<Ipv4Address, uint32_t>::iterator iter = m_addressNodeMap.find (sceAddress);
-  if (iter != m_addressNodeMap.end ())
-    {
-       nodeNumber = iter->second;
-    }
-//	  Ipv4Address interfaceAddress = lsMessage.GetOriginatorAddress ();
-//	  uint32_t nodeNumber = ReverseLookup(interfaceAddress);
-//	  Ipv4Address interfaceAddress = lsMessage.GetNdRsp().sourceAddress;
-	  nTableEntry entry (sceAddress, interfaceAddress, nodeNumber, Simulator::Now());
-	  nTable.nTableInsert(entry);
-	  LSMessage lsp = LSMessage (LSMessage::LSP, lsMessage.GetSequenceNumber(), m_maxTTL, m_mainAddress);
-          lsp.SetLsp (nTable, m_mainAddress);
-          Ptr<Packet> packet = Create<Packet> ();
-          packet->AddHeader (lsp);
-          BroadcastPacket (packet);
+      // add to neighbor table entry
+      Ipv4Address interfaceAddress = lsMessage.GetOriginatorAddress ();
+      Ipv4Address sceAddress = lsMessage.GetNdRsp().sourceAddress;
+      uint32_t nodeNumber;
+      if (!LookupNodeNumber (sceAddress, nodeNumber))
+        {
+          DEBUG_LOG ("Received ND_RSP from unknown node: " << sceAddress);
+          return;
+        }
+      nTableEntry entry (sceAddress, interfaceAddress, nodeNumber, Simulator::Now());
+      entry.metric = ComputeLinkMetric (entry);
+      std::string fromNode = ReverseLookup (lsMessage.GetOriginatorAddress ());
+      TRAFFIC_LOG ("Received ND_RSP, From Node: " << fromNode << ", Message: " << lsMessage.GetNdRsp().ndMessage);
+      // Hellos from known neighbors only refresh their timestamp
+      bool isNew = nTable.nTableUpdate (entry);
+      bool metricChanged = false;
+      if (lsMessage.GetSequenceNumber () == m_helloSequenceNumber)
+        {
+          metricChanged = UpdateNeighborRtt (sceAddress, interfaceAddress, Simulator::Now () - m_helloSent);
+        }
+      // One LSP per event, whether the adjacency or its metric changed
+      if (isNew || metricChanged)
+        {
+          OriginateLsp ();
+        }
+      if (isNew)
+        {
+          // Bring the new adjacency's LSDB in sync without waiting for refreshes
+          SendDbSummary (interfaceAddress, true);
+        }
+    }
+}
 
-          //nTable.table.push_back(entry);
-	  //nTable.size++;
-//	  printnTable();
-          std::string fromNode = ReverseLookup (lsMessage.GetOriginatorAddress ());
-          TRAFFIC_LOG ("Received ND_RSP, From Node: " << fromNode << ", Message: " << lsMessage.GetNdRsp().ndMessage);
-//          m_pingTracker.erase (iter);
-     }
-//      else
-//     {
-//          DEBUG_LOG ("Received invalid ND_RSP!");
-//     }
+void
+LSRoutingProtocol::OriginateLsp ()
+{
+  uint32_t myNumber;
+  if (!LookupNodeNumber (m_mainAddress, myNumber))
+    {
+      return;
+    }
+  lsdbEntry entry;
+  entry.originatorNumber = myNumber;
+  entry.originatorAddress = m_mainAddress;
+  entry.sequenceNumber = GetNextSequenceNumber ();
+  entry.installed = Simulator::Now ();
+  // Parallel links to one neighbor are advertised with the best metric
+  std::map<uint32_t, uint16_t> metrics;
+  for (int i = 0; i < nTable.size; i++)
+    {
+      std::map<uint32_t, uint16_t>::iterator iter = metrics.find (nTable.at (i).nodeNumber);
+      if (iter == metrics.end () || nTable.at (i).metric < iter->second)
+        {
+          metrics[nTable.at (i).nodeNumber] = nTable.at (i).metric;
+        }
+    }
+  for (std::map<uint32_t, uint16_t>::iterator iter = metrics.begin (); iter != metrics.end (); iter++)
+    {
+      entry.links.push_back (lsdbLink (iter->first, iter->second));
+    }
+
+  TRAFFIC_LOG ("Sending LSP from Node: " << myNumber << " SequenceNumber: " << entry.sequenceNumber);
+  LSMessage lsp = LSMessage (LSMessage::LSP, entry.sequenceNumber, m_maxTTL, m_mainAddress);
+  lsp.SetLsp (entry.links);
+  lsdb.lsdbUpdate (entry);
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (lsp);
+  BroadcastPacket (packet);
+
+  PurgeLsdb ();
+  ComputeRoutes ();
+}
+
+void
+LSRoutingProtocol::RefreshLsp ()
+{
+  // Re-originate before our LSP reaches LspMaxAge anywhere in the network
+  OriginateLsp ();
+  m_lspRefreshTimer.Schedule (JitteredInterval (m_lspRefreshInterval));
+}
+
+bool
+LSRoutingProtocol::PurgeLsdb ()
+{
+  // Lazy purge: aged entries are only removed when the database is used
+  if (Simulator::Now () <= m_lspMaxAge)
+    {
+      return false;
+    }
+  std::vector<lsdbEntry> expired = lsdb.purge (Simulator::Now () - m_lspMaxAge);
+  for (size_t i = 0; i < expired.size (); i++)
+    {
+      DEBUG_LOG ("LSP expired. Node Number: " << expired[i].originatorNumber << " SequenceNumber: " << expired[i].sequenceNumber);
+    }
+  return !expired.empty ();
 }
 
 void
 LSRoutingProtocol::ProcessLsp (LSMessage lsMessage)
 {
-//  PRINT_LOG ("PROCESSING LSP"  << std::endl);
-  Ipv4Address nAdd;
-  Ipv4Address iAdd;
-  uint32_t nNum;
-  nTableEntry nEntry;
-  neighborTable ntable = lsMessage.GetLsp().ntable;
-  Ipv4Address sceAddress = lsMessage.GetLsp().sourceAddress;
-  uint32_t nodeNumber;
-  std::map<Ipv4Address, uint32_t>::iterator iter = m_addressNodeMap.find (sceAddress);
-  rTableEntry rEntry();
-  if (iter != m_addressNodeMap.end ())
-    {
-       nodeNumber = iter->second;
-    }
-  std::string myNum = ReverseLookup(m_mainAddress);
-  for(int i = 0; i < lsMessage.GetLsp().ntable.size; i++){
-	std::stringstream ss;
-	std::string str;
-	nEntry = ntable.at(i);
-	nAdd = nEntry.NeighborAddress;
-	nNum = nEntry.nodeNumber;
-	iAdd = nEntry.InterfaceAddress;
-	ss << nNum;
-	ss >> str;
-//	PRINT_LOG("is it working properly?  " << str << "\t" << myNum << std::endl);
-	if( myNum == str){
-		rTableEntry rEntry (nodeNumber, sceAddress, nNum, nAdd, iAdd, 1);
-		if(rTable.isNew(rEntry)){
-			rTable.rTableInsert(rEntry);
-//			PRINT_LOG("its working with 6 stuff" << std::endl);
-		}
-	}
-	else {
-		rTableEntry rEntry (nNum, nAdd, iAdd);
-		rEntry.NextHopNumber = 99;
-		if(rTable.isNew(rEntry)){
-			rTable.rTableInsert(rEntry);
-//			PRINT_LOG("its working with 6 stuff" << std::endl);
-		}
-	}
-  }
+  Ipv4Address originatorAddress = lsMessage.GetOriginatorAddress ();
+  uint32_t sequenceNumber = lsMessage.GetSequenceNumber ();
+  uint32_t originatorNumber;
+  if (!LookupNodeNumber (originatorAddress, originatorNumber))
+    {
+      DEBUG_LOG ("Received LSP from unknown node: " << originatorAddress);
+      return;
+    }
+
+  if (IsOwnAddress (originatorAddress))
+    {
+      // A copy of our LSP from before a restart outlived us: jump past it
+      const lsdbEntry *own = lsdb.find (originatorNumber);
+      if (own == 0 || sequenceNumberNewer (sequenceNumber, own->sequenceNumber))
+        {
+          m_currentSequenceNumber = sequenceNumber + 1;
+          OriginateLsp ();
+        }
+      return;
+    }
+
+  if (lsMessage.GetLsp ().version != LSP_VERSION_COMPACT)
+    {
+      DEBUG_LOG ("Dropping LSP with unsupported encoding from: " << originatorAddress);
+      return;
+    }
+
+  bool purged = PurgeLsdb ();
+  if (!lsdb.isNewer (originatorNumber, sequenceNumber))
+    {
+      // Duplicate or stale copy of the flood
+      if (purged)
+        {
+          ComputeRoutes ();
+        }
+      return;
+    }
+
+  lsdbEntry entry;
+  entry.originatorNumber = originatorNumber;
+  entry.originatorAddress = originatorAddress;
+  entry.sequenceNumber = sequenceNumber;
+  entry.installed = Simulator::Now ();
+  entry.links = lsMessage.GetLsp ().links;
+  lsdb.lsdbUpdate (entry);
+  TRAFFIC_LOG ("Received LSP, From Node: " << originatorNumber << " SequenceNumber: " << sequenceNumber);
+
+  // Continue the flood
+  if (lsMessage.GetTTL () > 1)
+    {
+      lsMessage.SetTTL (lsMessage.GetTTL () - 1);
+      Ptr<Packet> packet = Create<Packet> ();
+      packet->AddHeader (lsMessage);
+      BroadcastPacket (packet);
+    }
+
+  ComputeRoutes ();
+}
+
+void
+LSRoutingProtocol::SendDbSummary (Ipv4Address destination, bool replyRequested, uint32_t rangeStart, uint32_t rangeEnd)
+{
+  PurgeLsdb ();
+  std::vector<std::pair<uint32_t, uint32_t> > entries;
+  linkStateDatabase::const_iterator iter = lsdb.lower_bound (rangeStart);
+  uint32_t pieceStart = rangeStart;
+  // An empty range still goes out as one piece, so the neighbor sends us everything
+  do
+    {
+      entries.clear ();
+      for (; iter != lsdb.end () && iter->first <= rangeEnd && entries.size () < DB_SUMMARY_MAX_ENTRIES; iter++)
+        {
+          entries.push_back (std::make_pair (iter->first, iter->second.sequenceNumber));
+        }
+      bool last = (iter == lsdb.end () || iter->first > rangeEnd);
+      // Pieces tile the range, so a gap between entries means the sender lacks those LSPs
+      uint32_t pieceEnd = last ? rangeEnd : entries.back ().first;
+      uint32_t sequenceNumber = GetNextSequenceNumber ();
+      TRAFFIC_LOG ("Sending DB_SUMMARY to: " << destination << " Range: " << pieceStart << "-" << pieceEnd
+                   << " Entries: " << entries.size () << " SequenceNumber: " << sequenceNumber);
+      LSMessage lsMessage = LSMessage (LSMessage::DB_SUMMARY, sequenceNumber, 1, m_mainAddress);
+      lsMessage.SetDbSummary (entries, replyRequested, pieceStart, pieceEnd);
+      Ptr<Packet> packet = Create<Packet> ();
+      packet->AddHeader (lsMessage);
+      if (destination == Ipv4Address::GetAny ())
+        {
+          BroadcastPacket (packet);
+        }
+      else
+        {
+          SendPacketToNeighbor (packet, destination);
+        }
+      if (last)
+        {
+          break;
+        }
+      pieceStart = pieceEnd + 1;
+    }
+  while (true);
+}
+
+void
+LSRoutingProtocol::ProcessDbSummary (LSMessage lsMessage, Ipv4Address sourceAddress)
+{
+  LSMessage::DbSummary summary = lsMessage.GetDbSummary ();
+  if (!summary.valid)
+    {
+      DEBUG_LOG ("Dropping malformed DB_SUMMARY from: " << sourceAddress);
+      return;
+    }
+  TRAFFIC_LOG ("Received DB_SUMMARY, From: " << sourceAddress << " Range: " << summary.rangeStart << "-"
+               << summary.rangeEnd << " Entries: " << summary.entries.size ());
+  std::map<uint32_t, uint32_t> theirs (summary.entries.begin (), summary.entries.end ());
+
+  // Send the neighbor every LSP of the range it lacks or holds an older copy
+  // of. These copies go one hop only: the neighbor's other adjacencies are in sync.
+  PurgeLsdb ();
+  for (linkStateDatabase::const_iterator iter = lsdb.lower_bound (summary.rangeStart);
+       iter != lsdb.end () && iter->first <= summary.rangeEnd; iter++)
+    {
+      std::map<uint32_t, uint32_t>::iterator known = theirs.find (iter->first);
+      if (known != theirs.end () && !sequenceNumberNewer (iter->second.sequenceNumber, known->second))
+        {
+          continue;
+        }
+      LSMessage lsp = LSMessage (LSMessage::LSP, iter->second.sequenceNumber, 1, iter->second.originatorAddress);
+      lsp.SetLsp (iter->second.links);
+      Ptr<Packet> packet = Create<Packet> ();
+      packet->AddHeader (lsp);
+      SendPacketToNeighbor (packet, sourceAddress);
+    }
+
+  // Answer once with our own summary of the range if the neighbor has LSPs we lack
+  if (!summary.replyRequested)
+    {
+      return;
+    }
+  for (std::map<uint32_t, uint32_t>::iterator iter = theirs.begin (); iter != theirs.end (); iter++)
+    {
+      if (lsdb.isNewer (iter->first, iter->second))
+        {
+          SendDbSummary (sourceAddress, false, summary.rangeStart, summary.rangeEnd);
+          return;
+        }
+    }
 }
 
 bool
-LSRoutingProtocol::IsOwnAddress (Ipv4Address originatorAddress)
+LSRoutingProtocol::SaveSnapshot (std::string path)
+{
+  uint32_t myNumber;
+  if (!LookupNodeNumber (m_mainAddress, myNumber))
+    {
+      return false;
+    }
+  PurgeLsdb ();
+  return LsdbSnapshot::Write (path, myNumber, m_currentSequenceNumber, Simulator::Now (), lsdb, nTable, rTable);
+}
+
+void
+LSRoutingProtocol::PeriodicSnapshot ()
+{
+  if (!SaveSnapshot (m_snapshotFile))
+    {
+      ERROR_LOG ("Failed to write checkpoint " << m_snapshotFile);
+    }
+  m_snapshotTimer.Schedule (m_snapshotInterval);
+}
+
+bool
+LSRoutingProtocol::LoadSnapshot (std::string path)
+{
+  LsdbSnapshot snapshot;
+  if (!snapshot.Open (path))
+    {
+      DEBUG_LOG ("No usable checkpoint at " << path);
+      return false;
+    }
+  const LsdbSnapshot::Header &header = snapshot.GetHeader ();
+  uint32_t myNumber;
+  if (!LookupNodeNumber (m_mainAddress, myNumber) || header.nodeNumber != myNumber)
+    {
+      ERROR_LOG ("Checkpoint " << path << " belongs to node " << header.nodeNumber);
+      return false;
+    }
+
+  Time now = Simulator::Now ();
+  for (uint32_t i = 0; i < header.lsdbCount; i++)
+    {
+      lsdbEntry entry = snapshot.GetLsdbEntry (i, now);
+      if (now - entry.installed <= m_lspMaxAge)
+        {
+          lsdb.lsdbUpdate (entry);
+        }
+    }
+  for (uint32_t i = 0; i < header.neighborCount; i++)
+    {
+      nTableEntry entry = snapshot.GetNeighborEntry (i, now);
+      if (now - entry.tStamp <= m_ndLong)
+        {
+          nTable.nTableUpdate (entry);
+        }
+    }
+  for (uint32_t i = 0; i < header.routeCount; i++)
+    {
+      rTableEntry entry = snapshot.GetRouteEntry (i);
+      uint32_t interface;
+      Ipv4Address localAddress;
+      if (!FindInterfaceForNextHop (entry.NextHopAddress, interface, localAddress))
+        {
+          continue;
+        }
+      rTable.rTableInsert (entry);
+      if (!IsOwnAddress (entry.DestinationAddress))
+        {
+          AddHostRoute (entry.DestinationAddress, entry.NextHopAddress, interface);
+        }
+    }
+  // Our next LSP must supersede the copies the network still holds
+  m_currentSequenceNumber = header.sequenceNumber;
+  STATUS_LOG ("Warm restart from " << path << ": " << lsdb.size << " LSPs, " << nTable.size << " neighbors, "
+              << rTable.size << " routes");
+  return true;
+}
+
+void
+LSRoutingProtocol::SendPacketToNeighbor (Ptr<Packet> packet, Ipv4Address neighborAddress)
 {
-  // Check all interfaces
   for (std::map<Ptr<Socket> , Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.begin (); i != m_socketAddresses.end (); i++)
     {
-      Ipv4InterfaceAddress interfaceAddr = i->second;
-      if (originatorAddress == interfaceAddr.GetLocal ())
+      Ipv4Mask mask = i->second.GetMask ();
+      if (i->second.GetLocal ().CombineMask (mask) == neighborAddress.CombineMask (mask))
         {
+          i->first->SendTo (packet, 0, InetSocketAddress (neighborAddress, m_lsPort));
+          return;
+        }
+    }
+  DEBUG_LOG ("No interface towards neighbor: " << neighborAddress);
+}
+
+bool
+LSRoutingProtocol::FindInterfaceForNextHop (Ipv4Address nextHop, uint32_t &interface, Ipv4Address &localAddress)
+{
+  for (std::map<Ptr<Socket> , Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.begin (); i != m_socketAddresses.end (); i++)
+    {
+      Ipv4Mask mask = i->second.GetMask ();
+      if (i->second.GetLocal ().CombineMask (mask) == nextHop.CombineMask (mask))
+        {
+          localAddress = i->second.GetLocal ();
+          interface = m_ipv4->GetInterfaceForAddress (localAddress);
           return true;
         }
     }
   return false;
-
 }
 
 void
-LSRoutingProtocol::AuditPings ()
+LSRoutingProtocol::ComputeRoutes ()
 {
-  std::map<uint32_t, Ptr<PingRequest> >::iterator iter;
-  for (iter = m_pingTracker.begin () ; iter != m_pingTracker.end();)
+  uint32_t myNumber;
+  if (!LookupNodeNumber (m_mainAddress, myNumber))
     {
-      Ptr<PingRequest> pingRequest = iter->second;
-      if (pingRequest->GetTimestamp().GetMilliSeconds() + m_pingTimeout.GetMilliSeconds() <= Simulator::Now().GetMilliSeconds())
+      return;
+    }
+
+  // Dijkstra over the LSDB, remembering the first hop of every path
+  std::map<uint32_t, uint32_t> cost;
+  std::map<uint32_t, uint32_t> firstHop;
+  std::set<std::pair<uint32_t, uint32_t> > queue;
+  cost[myNumber] = 0;
+  queue.insert (std::make_pair (0, myNumber));
+  while (!queue.empty ())
+    {
+      uint32_t nodeCost = queue.begin ()->first;
+      uint32_t node = queue.begin ()->second;
+      queue.erase (queue.begin ());
+
+      std::vector<lsdbLink> links;
+      if (node == myNumber)
         {
-          DEBUG_LOG ("Ping expired. Message: " << pingRequest->GetPingMessage () << " Timestamp: " << pingRequest->GetTimestamp().GetMilliSeconds () << " CurrentTime: " << Simulator::Now().GetMilliSeconds ());
-          // Remove stale entries
-          m_pingTracker.erase (iter++);
+          for (int i = 0; i < nTable.size; i++)
+            {
+              links.push_back (lsdbLink (nTable.at (i).nodeNumber, nTable.at (i).metric));
+            }
         }
       else
         {
-          ++iter;
+          const lsdbEntry *entry = lsdb.find (node);
+          if (entry == 0)
+            {
+              continue;
+            }
+          links = entry->links;
+        }
+
+      for (size_t i = 0; i < links.size (); i++)
+        {
+          uint32_t neighbor = links[i].nodeNumber;
+          if (neighbor == myNumber)
+            {
+              continue;
+            }
+          // Only use links both ends still advertise, so a dead router's
+          // stale adjacencies are ignored once its own LSP is purged
+          if (node != myNumber)
+            {
+              const lsdbEntry *reverse = lsdb.find (neighbor);
+              if (reverse == 0 || !reverse->hasNeighbor (node))
+                {
+                  continue;
+                }
+            }
+          uint32_t newCost = nodeCost + links[i].metric;
+          std::map<uint32_t, uint32_t>::iterator known = cost.find (neighbor);
+          if (known != cost.end () && known->second <= newCost)
+            {
+              continue;
+            }
+          if (known != cost.end ())
+            {
+              queue.erase (std::make_pair (known->second, neighbor));
+            }
+          cost[neighbor] = newCost;
+          firstHop[neighbor] = (node == myNumber) ? neighbor : firstHop[node];
+          queue.insert (std::make_pair (newCost, neighbor));
+        }
+    }
+
+  // Rebuild the route table and the forwarding entries derived from it
+  rTable.clear ();
+  RemoveHostRoutes ();
+  for (std::map<uint32_t, uint32_t>::iterator iter = firstHop.begin (); iter != firstHop.end (); iter++)
+    {
+      uint32_t destNumber = iter->first;
+      uint32_t hopNumber = iter->second;
+      Ipv4Address destAddress = ResolveNodeIpAddress (destNumber);
+      // Leave through the cheapest of the links to the first hop
+      Ipv4Address hopAddress = Ipv4Address::GetAny ();
+      uint16_t hopMetric = 0xFFFF;
+      for (int i = 0; i < nTable.size; i++)
+        {
+          if (nTable.at (i).nodeNumber == hopNumber && nTable.at (i).metric <= hopMetric)
+            {
+              hopAddress = nTable.at (i).InterfaceAddress;
+              hopMetric = nTable.at (i).metric;
+            }
+        }
+      uint32_t interface;
+      Ipv4Address localAddress;
+      if (destAddress == Ipv4Address::GetAny () || !FindInterfaceForNextHop (hopAddress, interface, localAddress))
+        {
+          continue;
+        }
+      uint16_t dijCost = cost[destNumber] > 0xFFFF ? 0xFFFF : cost[destNumber];
+      rTable.rTableInsert (rTableEntry (destNumber, destAddress, hopNumber, hopAddress, localAddress, dijCost));
+      if (!IsOwnAddress (destAddress))
+        {
+          AddHostRoute (destAddress, hopAddress, interface);
+        }
+    }
+}
+
+void
+LSRoutingProtocol::AddHostRoute (Ipv4Address destination, Ipv4Address nextHop, uint32_t interface)
+{
+  m_staticRouting->AddHostRouteTo (destination, nextHop, interface);
+  m_hostRoutes[destination] = std::make_pair (nextHop, interface);
+}
+
+void
+LSRoutingProtocol::RemoveHostRoutes ()
+{
+  if (m_hostRoutes.empty ())
+    {
+      return;
+    }
+  for (uint32_t i = m_staticRouting->GetNRoutes (); i > 0; i--)
+    {
+      Ipv4RoutingTableEntry route = m_staticRouting->GetRoute (i - 1);
+      if (!route.IsHost () || !route.IsGateway ())
+        {
+          continue;
+        }
+      std::map<Ipv4Address, std::pair<Ipv4Address, uint32_t> >::iterator iter = m_hostRoutes.find (route.GetDest ());
+      if (iter != m_hostRoutes.end () && iter->second.first == route.GetGateway ()
+          && iter->second.second == route.GetInterface ())
+        {
+          m_staticRouting->RemoveRoute (i - 1);
+          m_hostRoutes.erase (iter);
+        }
+    }
+  m_hostRoutes.clear ();
+}
+
+bool
+LSRoutingProtocol::IsOwnAddress (Ipv4Address originatorAddress)
+{
+  // Check all interfaces
+  for (std::map<Ptr<Socket> , Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.begin (); i != m_socketAddresses.end (); i++)
+    {
+      Ipv4InterfaceAddress interfaceAddr = i->second;
+      if (originatorAddress == interfaceAddr.GetLocal ())
+        {
+          return true;
         }
     }
-  // Rechedule timer
-  m_auditPingsTimer.Schedule (m_pingTimeout); 
+  return false;
+
+}
+
+void
+LSRoutingProtocol::PingCompleted (const RequestTracker::Request &request, bool success)
+{
+  if (!success)
+    {
+      DEBUG_LOG ("Ping expired. Message: " << request.message << " Timestamp: " << request.timestamp.GetMilliSeconds () << " CurrentTime: " << Simulator::Now().GetMilliSeconds ());
+    }
 }
 
 
 void
 LSRoutingProtocol::checkNTEntry ()
 {
-//  nTable.checkNeighborTableEntry();
-  for(int i = 0; i < nTable.size; i++)
-  {
-    if(nTable.at(i).tStamp.GetMilliSeconds() + m_ndLong.GetMilliSeconds() <= Simulator::Now().GetMilliSeconds())
+  if (Simulator::Now () > m_ndLong)
     {
-         DEBUG_LOG ("Node Discovery expired. Node Number: " << nTable.at(i).nodeNumber << "  Neighbor Address: " << nTable.at(i).NeighborAddress << " InterfaceAddress : " << nTable.at(i).InterfaceAddress);
+      std::vector<nTableEntry> expired = nTable.purge (Simulator::Now () - m_ndLong);
+      for (size_t i = 0; i < expired.size (); i++)
+        {
+          DEBUG_LOG ("Node Discovery expired. Node Number: " << expired[i].nodeNumber << "  Neighbor Address: " << expired[i].NeighborAddress << " InterfaceAddress : " << expired[i].InterfaceAddress);
+        }
+      // Advertise the lost adjacencies right away
+      if (!expired.empty ())
+        {
+          OriginateLsp ();
+        }
     }
-  }
-//  PRINT_LOG (m_checkNeighborTimer.GetDelayLeft());
-//  m_checkNeighborTimer.Cancel();
   m_checkNeighborTimer.Schedule (m_ndTimeout);
 }
 
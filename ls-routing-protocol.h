@@ -26,7 +26,8 @@
 #include "ns3/socket.h"
 #include "ns3/timer.h"
 #include "tables.h"
-#include "ns3/ping-request.h"
+#include "ns3/request-tracker.h"
+#include "ns3/node-address-directory.h"
 #include "ns3/gu-routing-protocol.h"
 #include "ns3/ls-message.h"
 
@@ -43,6 +44,7 @@ class LSRoutingProtocol : public GURoutingProtocol
     LSRoutingProtocol ();
     neighborTable nTable;
     routeTable rTable;
+    linkStateDatabase lsdb;
     virtual ~LSRoutingProtocol ();
     /**
      * \brief Process command issued from the scenario file or interactively issued from keyboard.
@@ -79,6 +81,11 @@ class LSRoutingProtocol : public GURoutingProtocol
      */
 
     virtual void SetAddressNodeMap (std::map<Ipv4Address, uint32_t> addressNodeMap);
+    /**
+     * \brief Shares the directory the routing helper built for every node;
+     * SetNodeAddressMap and SetAddressNodeMap are then ignored.
+     */
+    void SetAddressDirectory (Ptr<NodeAddressDirectory> directory);
 
     // Message Handling
     /**
@@ -93,11 +100,45 @@ class LSRoutingProtocol : public GURoutingProtocol
     void ProcessNdReq (LSMessage lsMessage);
     void ProcessNdRsp (LSMessage lsMessage);
     void ProcessLsp (LSMessage lsMessage);
+    void ProcessDbSummary (LSMessage lsMessage, Ipv4Address sourceAddress);
 
 //    void sendLsp ();
-    // Periodic Audit
-    void AuditPings ();
+    void PingCompleted (const RequestTracker::Request &request, bool success);
+    // Periodic hello and LSP refresh
+    void SendHello ();
+    void RefreshLsp ();
+    void OriginateLsp ();
+    bool PurgeLsdb ();
+    void ComputeRoutes ();
+    /**
+     * \brief Adds a host route to the static routing table and remembers
+     * it, so that RemoveHostRoutes leaves routes of others alone.
+     */
+    void AddHostRoute (Ipv4Address destination, Ipv4Address nextHop, uint32_t interface);
+    void RemoveHostRoutes ();
     void checkNTEntry();
+    /**
+     * \brief Sends the (originator, sequence number) list of our LSDB,
+     * in pieces of DB_SUMMARY_MAX_ENTRIES that each cover a range of
+     * originator numbers.
+     *
+     * \param destination Neighbor interface address, or any to broadcast.
+     * \param replyRequested true if the neighbor should answer with its own summary.
+     * \param rangeStart First originator number to summarize.
+     * \param rangeEnd Last originator number to summarize.
+     */
+    void SendDbSummary (Ipv4Address destination, bool replyRequested,
+                        uint32_t rangeStart = 0, uint32_t rangeEnd = 0xFFFFFFFF);
+    /**
+     * \brief Checkpoints the LSDB, neighbor and route tables to a file.
+     */
+    bool SaveSnapshot (std::string path);
+    /**
+     * \brief Restores a checkpoint and installs its routes, so the node
+     * forwards while it resynchronizes with its neighbors.
+     */
+    bool LoadSnapshot (std::string path);
+    void PeriodicSnapshot ();
     void printnTable(); 
     void printrTable(); 
     // From Ipv4RoutingProtocol
@@ -195,6 +236,13 @@ class LSRoutingProtocol : public GURoutingProtocol
      * \param packet Packet to be sent.
      */
     void BroadcastPacket (Ptr<Packet> packet);
+    /**
+     * \brief Sends a packet to a directly connected neighbor.
+     *
+     * \param packet Packet to be sent.
+     * \param neighborAddress Neighbor's address on the shared subnet.
+     */
+    void SendPacketToNeighbor (Ptr<Packet> packet, Ipv4Address neighborAddress);
     /**
      * \brief Returns the main IP address of a node in Inet topology.
      *
@@ -212,6 +260,40 @@ class LSRoutingProtocol : public GURoutingProtocol
      */
 
     virtual std::string ReverseLookup (Ipv4Address ipv4Address); 
+    /**
+     * \brief Returns the Inet topology node number using the specified IP.
+     *
+     * \param ipv4Address IP address of node.
+     * \param nodeNumber Set to the node number when found.
+     * \returns false if the address is unknown.
+     */
+    bool LookupNodeNumber (Ipv4Address ipv4Address, uint32_t &nodeNumber);
+    /**
+     * \brief Finds the local interface sharing a subnet with a next hop.
+     *
+     * \param nextHop IP address of a directly connected neighbor.
+     * \param interface Set to the interface index.
+     * \param localAddress Set to the local address on that interface.
+     * \returns false if no interface is on the next hop's subnet.
+     */
+    bool FindInterfaceForNextHop (Ipv4Address nextHop, uint32_t &interface, Ipv4Address &localAddress);
+    /**
+     * \returns interval randomly shortened or lengthened by up to 25%.
+     */
+    Time JitteredInterval (Time interval);
+    /**
+     * \brief Computes the metric of a link to a neighbor.
+     *
+     * A static metric configured for the local interface wins; otherwise the
+     * smoothed ND round-trip time is used when RttMetric is enabled.
+     */
+    uint16_t ComputeLinkMetric (const nTableEntry &entry);
+    void ParseInterfaceMetrics ();
+    /**
+     * \returns true if the sample moved the link metric enough to be
+     * re-advertised; the caller originates the LSP.
+     */
+    bool UpdateNeighborRtt (Ipv4Address neighborAddress, Ipv4Address interfaceAddress, Time sample);
     
     // Status 
     void DumpLSA ();
@@ -233,20 +315,39 @@ class LSRoutingProtocol : public GURoutingProtocol
     std::map< Ptr<Socket>, Ipv4InterfaceAddress > m_socketAddresses;
     Ipv4Address m_mainAddress;
     Ptr<Ipv4StaticRouting> m_staticRouting;
+    // Host routes we installed: destination -> (next hop, interface)
+    std::map<Ipv4Address, std::pair<Ipv4Address, uint32_t> > m_hostRoutes;
     Ptr<Ipv4> m_ipv4;
     Time m_pingTimeout;
     Time m_ndTimeout;
     Time m_ndLong;
+    Time m_helloInterval;
+    Time m_lspRefreshInterval;
+    Time m_lspMaxAge;
+    bool m_rttMetric;
+    Time m_rttMetricUnit;
+    uint16_t m_defaultMetric;
+    std::string m_interfaceMetricsConfig;
+    std::map<uint32_t, uint16_t> m_interfaceMetrics;
+    // Last hello, for ND round-trip measurement
+    uint32_t m_helloSequenceNumber;
+    Time m_helloSent;
+    std::string m_snapshotFile;
+    Time m_snapshotInterval;
     uint8_t m_maxTTL;
     uint16_t m_lsPort;
     uint32_t m_currentSequenceNumber;
-    std::map<uint32_t, Ipv4Address> m_nodeAddressMap;
-    std::map<Ipv4Address, uint32_t> m_addressNodeMap;
+    // Shared with every other module of the simulation, once the helper
+    // hands it over
+    Ptr<NodeAddressDirectory> m_addressDirectory;
+    bool m_sharedDirectory;
     // Timers
-    Timer m_auditPingsTimer;
     Timer m_checkNeighborTimer;
+    Timer m_helloTimer;
+    Timer m_lspRefreshTimer;
+    Timer m_snapshotTimer;
     // Ping tracker
-    std::map<uint32_t, Ptr<PingRequest> > m_pingTracker;
+    RequestTracker m_pingTracker;
 };
 
 #endif
@@ -0,0 +1,290 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/lsdb-snapshot.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace ns3;
+
+// "LSDB" read in host byte order; a byte swapped magic means another host
+#define SNAPSHOT_MAGIC 0x4C534442
+#define SNAPSHOT_VERSION 1
+
+LsdbSnapshot::LsdbSnapshot ()
+  : m_data (0),
+    m_length (0)
+{
+}
+
+LsdbSnapshot::~LsdbSnapshot ()
+{
+  Close ();
+}
+
+bool
+LsdbSnapshot::Write (const std::string &path, uint32_t nodeNumber, uint32_t sequenceNumber, Time now,
+                     const linkStateDatabase &lsdb, const neighborTable &nTable, const routeTable &rTable)
+{
+  std::vector<LsdbRecord> lsdbRecords;
+  std::vector<LinkRecord> linkRecords;
+  for (linkStateDatabase::const_iterator iter = lsdb.begin (); iter != lsdb.end (); iter++)
+    {
+      const lsdbEntry &entry = iter->second;
+      LsdbRecord record;
+      memset (&record, 0, sizeof (record));
+      record.age = (now - entry.installed).GetNanoSeconds ();
+      record.originatorNumber = entry.originatorNumber;
+      record.originatorAddress = entry.originatorAddress.Get ();
+      record.sequenceNumber = entry.sequenceNumber;
+      record.firstLink = linkRecords.size ();
+      record.linkCount = entry.links.size ();
+      lsdbRecords.push_back (record);
+      for (size_t i = 0; i < entry.links.size (); i++)
+        {
+          LinkRecord link;
+          memset (&link, 0, sizeof (link));
+          link.nodeNumber = entry.links[i].nodeNumber;
+          link.metric = entry.links[i].metric;
+          linkRecords.push_back (link);
+        }
+    }
+
+  std::vector<NeighborRecord> neighborRecords;
+  for (int i = 0; i < nTable.size; i++)
+    {
+      nTableEntry entry = nTable.at (i);
+      NeighborRecord record;
+      memset (&record, 0, sizeof (record));
+      record.age = (now - entry.tStamp).GetNanoSeconds ();
+      record.rtt = entry.rtt.GetNanoSeconds ();
+      record.nodeNumber = entry.nodeNumber;
+      record.neighborAddress = entry.NeighborAddress.Get ();
+      record.interfaceAddress = entry.InterfaceAddress.Get ();
+      record.metric = entry.metric;
+      neighborRecords.push_back (record);
+    }
+
+  std::vector<RouteRecord> routeRecords;
+  for (int i = 0; i < rTable.size; i++)
+    {
+      rTableEntry entry = rTable.at (i);
+      RouteRecord record;
+      memset (&record, 0, sizeof (record));
+      record.destinationNumber = entry.DestinationNumber;
+      record.destinationAddress = entry.DestinationAddress.Get ();
+      record.nextHopNumber = entry.NextHopNumber;
+      record.nextHopAddress = entry.NextHopAddress.Get ();
+      record.interfaceAddress = entry.InterfaceAddress.Get ();
+      record.cost = entry.dijCost;
+      routeRecords.push_back (record);
+    }
+
+  Header header;
+  memset (&header, 0, sizeof (header));
+  header.magic = SNAPSHOT_MAGIC;
+  header.version = SNAPSHOT_VERSION;
+  header.headerSize = sizeof (Header);
+  header.nodeNumber = nodeNumber;
+  header.sequenceNumber = sequenceNumber;
+  header.savedAt = now.GetNanoSeconds ();
+  header.lsdbCount = lsdbRecords.size ();
+  header.neighborCount = neighborRecords.size ();
+  header.routeCount = routeRecords.size ();
+  header.linkCount = linkRecords.size ();
+
+  // Write next to the target and rename, so a crash never leaves half a file
+  std::string tmpPath = path + ".tmp";
+  FILE *file = fopen (tmpPath.c_str (), "wb");
+  if (file == 0)
+    {
+      return false;
+    }
+  bool ok = fwrite (&header, sizeof (header), 1, file) == 1;
+  if (ok && !lsdbRecords.empty ())
+    {
+      ok = fwrite (&lsdbRecords[0], sizeof (LsdbRecord), lsdbRecords.size (), file) == lsdbRecords.size ();
+    }
+  if (ok && !neighborRecords.empty ())
+    {
+      ok = fwrite (&neighborRecords[0], sizeof (NeighborRecord), neighborRecords.size (), file) == neighborRecords.size ();
+    }
+  if (ok && !routeRecords.empty ())
+    {
+      ok = fwrite (&routeRecords[0], sizeof (RouteRecord), routeRecords.size (), file) == routeRecords.size ();
+    }
+  if (ok && !linkRecords.empty ())
+    {
+      ok = fwrite (&linkRecords[0], sizeof (LinkRecord), linkRecords.size (), file) == linkRecords.size ();
+    }
+  ok = (fclose (file) == 0) && ok;
+  if (!ok || rename (tmpPath.c_str (), path.c_str ()) != 0)
+    {
+      remove (tmpPath.c_str ());
+      return false;
+    }
+  return true;
+}
+
+bool
+LsdbSnapshot::Open (const std::string &path)
+{
+  Close ();
+  int fd = open (path.c_str (), O_RDONLY);
+  if (fd < 0)
+    {
+      return false;
+    }
+  struct stat st;
+  if (fstat (fd, &st) != 0 || st.st_size < (off_t) sizeof (Header))
+    {
+      close (fd);
+      return false;
+    }
+  void *data = mmap (0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (data == MAP_FAILED)
+    {
+      return false;
+    }
+  m_data = (const uint8_t *) data;
+  m_length = st.st_size;
+
+  const Header &header = GetHeader ();
+  if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION || header.headerSize != sizeof (Header))
+    {
+      Close ();
+      return false;
+    }
+  // Sizes are computed in 64 bits so corrupt counts cannot wrap around
+  uint64_t expected = sizeof (Header)
+    + (uint64_t) header.lsdbCount * sizeof (LsdbRecord)
+    + (uint64_t) header.neighborCount * sizeof (NeighborRecord)
+    + (uint64_t) header.routeCount * sizeof (RouteRecord)
+    + (uint64_t) header.linkCount * sizeof (LinkRecord);
+  if (expected != m_length)
+    {
+      Close ();
+      return false;
+    }
+  const LsdbRecord *records = GetLsdbRecords ();
+  for (uint32_t i = 0; i < header.lsdbCount; i++)
+    {
+      if ((uint64_t) records[i].firstLink + records[i].linkCount > header.linkCount)
+        {
+          Close ();
+          return false;
+        }
+    }
+  return true;
+}
+
+void
+LsdbSnapshot::Close ()
+{
+  if (m_data != 0)
+    {
+      munmap ((void *) m_data, m_length);
+    }
+  m_data = 0;
+  m_length = 0;
+}
+
+bool
+LsdbSnapshot::IsOpen () const
+{
+  return m_data != 0;
+}
+
+const LsdbSnapshot::Header&
+LsdbSnapshot::GetHeader () const
+{
+  return *(const Header *) m_data;
+}
+
+const LsdbSnapshot::LsdbRecord*
+LsdbSnapshot::GetLsdbRecords () const
+{
+  return (const LsdbRecord *) (m_data + sizeof (Header));
+}
+
+const LsdbSnapshot::NeighborRecord*
+LsdbSnapshot::GetNeighborRecords () const
+{
+  return (const NeighborRecord *) (GetLsdbRecords () + GetHeader ().lsdbCount);
+}
+
+const LsdbSnapshot::RouteRecord*
+LsdbSnapshot::GetRouteRecords () const
+{
+  return (const RouteRecord *) (GetNeighborRecords () + GetHeader ().neighborCount);
+}
+
+const LsdbSnapshot::LinkRecord*
+LsdbSnapshot::GetLinkRecords () const
+{
+  return (const LinkRecord *) (GetRouteRecords () + GetHeader ().routeCount);
+}
+
+Time
+LsdbSnapshot::Elapsed (Time now) const
+{
+  Time savedAt = NanoSeconds (GetHeader ().savedAt);
+  return now > savedAt ? now - savedAt : Time ();
+}
+
+lsdbEntry
+LsdbSnapshot::GetLsdbEntry (uint32_t index, Time now) const
+{
+  const LsdbRecord &record = GetLsdbRecords ()[index];
+  const LinkRecord *links = GetLinkRecords () + record.firstLink;
+  lsdbEntry entry;
+  entry.originatorNumber = record.originatorNumber;
+  entry.originatorAddress = Ipv4Address (record.originatorAddress);
+  entry.sequenceNumber = record.sequenceNumber;
+  entry.installed = now - Elapsed (now) - NanoSeconds (record.age);
+  entry.links.reserve (record.linkCount);
+  for (uint32_t i = 0; i < record.linkCount; i++)
+    {
+      entry.links.push_back (lsdbLink (links[i].nodeNumber, links[i].metric));
+    }
+  return entry;
+}
+
+nTableEntry
+LsdbSnapshot::GetNeighborEntry (uint32_t index, Time now) const
+{
+  const NeighborRecord &record = GetNeighborRecords ()[index];
+  nTableEntry entry (Ipv4Address (record.neighborAddress), Ipv4Address (record.interfaceAddress),
+                     record.nodeNumber, now - Elapsed (now) - NanoSeconds (record.age));
+  entry.rtt = NanoSeconds (record.rtt);
+  entry.metric = record.metric;
+  return entry;
+}
+
+rTableEntry
+LsdbSnapshot::GetRouteEntry (uint32_t index) const
+{
+  const RouteRecord &record = GetRouteRecords ()[index];
+  return rTableEntry (record.destinationNumber, Ipv4Address (record.destinationAddress), record.nextHopNumber,
+                      Ipv4Address (record.nextHopAddress), Ipv4Address (record.interfaceAddress), record.cost);
+}
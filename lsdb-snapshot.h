@@ -0,0 +1,138 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LSDB_SNAPSHOT_H
+#define LSDB_SNAPSHOT_H
+
+#include "ns3/nstime.h"
+#include "tables.h"
+
+#include <string>
+
+using namespace ns3;
+
+/**
+ * \brief Checkpoint of the link state database, neighbor table and route
+ * table of one node, used for warm restarts.
+ *
+ * The file is a header followed by fixed-width arrays in host byte order:
+ *
+ *   header | lsdb entries | neighbors | routes | links
+ *
+ * Every record is naturally aligned, so an opened snapshot is read straight
+ * from the mapping without parsing. Ages are stored relative to the time of
+ * the checkpoint.
+ */
+class LsdbSnapshot
+{
+  public:
+    struct Header
+      {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t headerSize;
+        uint32_t nodeNumber;
+        // Next sequence number the node would have used
+        uint32_t sequenceNumber;
+        int64_t savedAt;
+        uint32_t lsdbCount;
+        uint32_t neighborCount;
+        uint32_t routeCount;
+        uint32_t linkCount;
+      };
+
+    struct LsdbRecord
+      {
+        int64_t age;
+        uint32_t originatorNumber;
+        uint32_t originatorAddress;
+        uint32_t sequenceNumber;
+        // Range of this entry in the links array
+        uint32_t firstLink;
+        uint32_t linkCount;
+        uint32_t reserved;
+      };
+
+    struct NeighborRecord
+      {
+        int64_t age;
+        int64_t rtt;
+        uint32_t nodeNumber;
+        uint32_t neighborAddress;
+        uint32_t interfaceAddress;
+        uint16_t metric;
+        uint16_t reserved;
+      };
+
+    struct RouteRecord
+      {
+        uint32_t destinationNumber;
+        uint32_t destinationAddress;
+        uint32_t nextHopNumber;
+        uint32_t nextHopAddress;
+        uint32_t interfaceAddress;
+        uint16_t cost;
+        uint16_t reserved;
+      };
+
+    struct LinkRecord
+      {
+        uint32_t nodeNumber;
+        uint16_t metric;
+        uint16_t reserved;
+      };
+
+    LsdbSnapshot ();
+    ~LsdbSnapshot ();
+
+    /**
+     * \brief Writes a checkpoint; the file is replaced atomically.
+     * \returns false if the file could not be written.
+     */
+    static bool Write (const std::string &path, uint32_t nodeNumber, uint32_t sequenceNumber, Time now,
+                       const linkStateDatabase &lsdb, const neighborTable &nTable, const routeTable &rTable);
+
+    /**
+     * \brief Maps a checkpoint read-only and validates its layout.
+     * \returns false if the file is missing, truncated or of another format.
+     */
+    bool Open (const std::string &path);
+    void Close ();
+    bool IsOpen () const;
+
+    const Header& GetHeader () const;
+    const LsdbRecord* GetLsdbRecords () const;
+    const NeighborRecord* GetNeighborRecords () const;
+    const RouteRecord* GetRouteRecords () const;
+    const LinkRecord* GetLinkRecords () const;
+
+    /**
+     * \brief Rebuilds an LSDB entry, installed as if it had kept aging since
+     * the checkpoint was taken.
+     */
+    lsdbEntry GetLsdbEntry (uint32_t index, Time now) const;
+    nTableEntry GetNeighborEntry (uint32_t index, Time now) const;
+    rTableEntry GetRouteEntry (uint32_t index) const;
+
+  private:
+    // Time elapsed since the checkpoint, zero for a checkpoint of an earlier run
+    Time Elapsed (Time now) const;
+
+    const uint8_t *m_data;
+    size_t m_length;
+};
+
+#endif
@@ -0,0 +1,186 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/node-address-directory.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdlib.h>
+
+NodeAddressDirectory::NodeAddressDirectory ()
+  : m_slots (2, 0),
+    m_slotBits (1)
+{
+}
+
+NodeAddressDirectory::NodeAddressDirectory (const std::map<uint32_t, Ipv4Address> &nodeAddressMap,
+                                            const std::map<Ipv4Address, uint32_t> &addressNodeMap)
+{
+  BuildNodes (nodeAddressMap);
+  BuildAddresses (addressNodeMap);
+}
+
+void
+NodeAddressDirectory::BuildNodes (const std::map<uint32_t, Ipv4Address> &nodeAddressMap)
+{
+  m_nodeNumbers.clear ();
+  m_nodeAddresses.clear ();
+  m_nodeNames.clear ();
+  m_nodeNumbers.reserve (nodeAddressMap.size ());
+  m_nodeAddresses.reserve (nodeAddressMap.size ());
+  m_nodeNames.reserve (nodeAddressMap.size ());
+  // Map order is ascending node number
+  for (std::map<uint32_t, Ipv4Address>::const_iterator iter = nodeAddressMap.begin ();
+       iter != nodeAddressMap.end (); iter++)
+    {
+      std::ostringstream name;
+      name << iter->first;
+      m_nodeNumbers.push_back (iter->first);
+      m_nodeAddresses.push_back (iter->second);
+      m_nodeNames.push_back (name.str ());
+    }
+}
+
+void
+NodeAddressDirectory::BuildAddresses (const std::map<Ipv4Address, uint32_t> &addressNodeMap)
+{
+  m_addresses.clear ();
+  m_addressNodes.clear ();
+  m_addresses.reserve (addressNodeMap.size ());
+  m_addressNodes.reserve (addressNodeMap.size ());
+  for (std::map<Ipv4Address, uint32_t>::const_iterator iter = addressNodeMap.begin ();
+       iter != addressNodeMap.end (); iter++)
+    {
+      m_addresses.push_back (iter->first);
+      m_addressNodes.push_back (iter->second);
+    }
+  // At most half full, so probe sequences stay short
+  m_slotBits = 1;
+  while (((uint32_t) 1 << m_slotBits) < 2 * m_addresses.size ())
+    {
+      m_slotBits++;
+    }
+  m_slots.assign ((uint32_t) 1 << m_slotBits, 0);
+  uint32_t mask = m_slots.size () - 1;
+  for (uint32_t i = 0; i < m_addresses.size (); i++)
+    {
+      uint32_t slot = HashAddress (m_addresses[i].Get ());
+      while (m_slots[slot] != 0)
+        {
+          slot = (slot + 1) & mask;
+        }
+      m_slots[slot] = i + 1;
+    }
+}
+
+uint32_t
+NodeAddressDirectory::FindNode (uint32_t nodeNumber) const
+{
+  // Topologies number their nodes 0 .. N-1, where a node is its own index
+  if (nodeNumber < m_nodeNumbers.size () && m_nodeNumbers[nodeNumber] == nodeNumber)
+    {
+      return nodeNumber;
+    }
+  std::vector<uint32_t>::const_iterator iter = std::lower_bound (m_nodeNumbers.begin (), m_nodeNumbers.end (), nodeNumber);
+  if (iter == m_nodeNumbers.end () || *iter != nodeNumber)
+    {
+      return m_nodeNumbers.size ();
+    }
+  return iter - m_nodeNumbers.begin ();
+}
+
+uint32_t
+NodeAddressDirectory::HashAddress (uint32_t address) const
+{
+  // Multiplicative hashing; the high bits are the well mixed ones
+  return (address * 2654435761U) >> (32 - m_slotBits);
+}
+
+Ipv4Address
+NodeAddressDirectory::Resolve (uint32_t nodeNumber) const
+{
+  uint32_t index = FindNode (nodeNumber);
+  if (index == m_nodeNumbers.size ())
+    {
+      return Ipv4Address::GetAny ();
+    }
+  return m_nodeAddresses[index];
+}
+
+Ipv4Address
+NodeAddressDirectory::Resolve (const std::string &nodeId) const
+{
+  char *end;
+  unsigned long nodeNumber = strtoul (nodeId.c_str (), &end, 10);
+  if (nodeId.empty () || *end != '\0')
+    {
+      return Ipv4Address::GetAny ();
+    }
+  return Resolve ((uint32_t) nodeNumber);
+}
+
+bool
+NodeAddressDirectory::LookupNodeNumber (Ipv4Address address, uint32_t &nodeNumber) const
+{
+  uint32_t mask = m_slots.size () - 1;
+  for (uint32_t slot = HashAddress (address.Get ()); m_slots[slot] != 0; slot = (slot + 1) & mask)
+    {
+      uint32_t index = m_slots[slot] - 1;
+      if (m_addresses[index] == address)
+        {
+          nodeNumber = m_addressNodes[index];
+          return true;
+        }
+    }
+  return false;
+}
+
+std::string
+NodeAddressDirectory::ReverseLookup (Ipv4Address address) const
+{
+  uint32_t nodeNumber;
+  if (!LookupNodeNumber (address, nodeNumber))
+    {
+      return "Unknown";
+    }
+  uint32_t index = FindNode (nodeNumber);
+  if (index != m_nodeNumbers.size ())
+    {
+      return m_nodeNames[index];
+    }
+  // An interface of a node without a main address
+  std::ostringstream name;
+  name << nodeNumber;
+  return name.str ();
+}
+
+uint32_t
+NodeAddressDirectory::GetSize () const
+{
+  return m_nodeNumbers.size ();
+}
+
+uint32_t
+NodeAddressDirectory::GetNodeNumber (uint32_t index) const
+{
+  return m_nodeNumbers[index];
+}
+
+Ipv4Address
+NodeAddressDirectory::GetAddress (uint32_t index) const
+{
+  return m_nodeAddresses[index];
+}
@@ -0,0 +1,106 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NODE_ADDRESS_DIRECTORY_H
+#define NODE_ADDRESS_DIRECTORY_H
+
+#include "ns3/ipv4-address.h"
+#include "ns3/ptr.h"
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include <string>
+
+using namespace ns3;
+
+/**
+ * \brief Inet topology node numbers and IP addresses, in both directions.
+ *
+ * Node numbers are kept in a sorted array with their main addresses and
+ * decimal names alongside, and are found by direct index when they are
+ * dense (0 .. N-1), else by binary search. Addresses are found through an
+ * open-addressing hash table. A directory never changes once handed out:
+ * the routing and application helpers build one from the topology maps and
+ * give it to every protocol and application they create, instead of each
+ * holding its own copy of the maps.
+ */
+class NodeAddressDirectory : public SimpleRefCount<NodeAddressDirectory>
+{
+  public:
+    /**
+     * \brief An empty directory; nothing resolves.
+     */
+    NodeAddressDirectory ();
+    /**
+     * \param addressNodeMap May hold every interface address of a node.
+     */
+    NodeAddressDirectory (const std::map<uint32_t, Ipv4Address> &nodeAddressMap,
+                          const std::map<Ipv4Address, uint32_t> &addressNodeMap);
+
+    /**
+     * \brief Replaces the node numbers, or the addresses, of a directory
+     * not yet handed out.
+     */
+    void BuildNodes (const std::map<uint32_t, Ipv4Address> &nodeAddressMap);
+    void BuildAddresses (const std::map<Ipv4Address, uint32_t> &addressNodeMap);
+
+    /**
+     * \returns the main address of nodeNumber, or Ipv4Address::GetAny ()
+     * if it is unknown.
+     */
+    Ipv4Address Resolve (uint32_t nodeNumber) const;
+    /**
+     * \brief As above, for a node number written in decimal.
+     */
+    Ipv4Address Resolve (const std::string &nodeId) const;
+    /**
+     * \returns false if address is unknown.
+     */
+    bool LookupNodeNumber (Ipv4Address address, uint32_t &nodeNumber) const;
+    /**
+     * \returns the decimal node number using address, or "Unknown".
+     */
+    std::string ReverseLookup (Ipv4Address address) const;
+
+    /**
+     * \returns the number of nodes; GetNodeNumber and GetAddress take
+     * indices below it, in ascending node number.
+     */
+    uint32_t GetSize () const;
+    uint32_t GetNodeNumber (uint32_t index) const;
+    Ipv4Address GetAddress (uint32_t index) const;
+
+  private:
+    /**
+     * \returns the index of nodeNumber, or GetSize () if it is unknown.
+     */
+    uint32_t FindNode (uint32_t nodeNumber) const;
+    uint32_t HashAddress (uint32_t address) const;
+
+    // Sorted node numbers, with their main addresses and names
+    std::vector<uint32_t> m_nodeNumbers;
+    std::vector<Ipv4Address> m_nodeAddresses;
+    std::vector<std::string> m_nodeNames;
+    // Every known address in ascending order, with its node number
+    std::vector<Ipv4Address> m_addresses;
+    std::vector<uint32_t> m_addressNodes;
+    // Index into m_addresses + 1, 0 for an empty slot; a power of two long
+    std::vector<uint32_t> m_slots;
+    uint32_t m_slotBits;
+};
+
+#endif
@@ -0,0 +1,421 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/request-tracker.h"
+#include "ns3/simulator.h"
+#include "ns3/log.h"
+
+#include <algorithm>
+
+using namespace ns3;
+
+#define INDEX_EMPTY 0xFFFFFFFF
+#define INDEX_INITIAL_SIZE 64
+
+static inline uint32_t
+HashTransactionId (uint32_t transactionId)
+{
+  // Multiplicative hashing keeps sequential ids spread over the table
+  return transactionId * 2654435761U;
+}
+
+RequestTracker::RequestTracker ()
+  : m_indexMask (INDEX_INITIAL_SIZE - 1),
+    m_size (0),
+    m_timeout (MilliSeconds (2000)),
+    m_expiryTimer (Timer::CANCEL_ON_DESTROY)
+{
+  m_indexKeys.resize (INDEX_INITIAL_SIZE, 0);
+  m_indexSlots.resize (INDEX_INITIAL_SIZE, INDEX_EMPTY);
+  m_expiryTimer.SetFunction (&RequestTracker::Expire, this);
+}
+
+RequestTracker::~RequestTracker ()
+{
+}
+
+void
+RequestTracker::SetTimeout (Time timeout)
+{
+  m_timeout = timeout;
+}
+
+Time
+RequestTracker::GetTimeout () const
+{
+  return m_timeout;
+}
+
+void
+RequestTracker::SetRetryCallback (RetryCallback retryFn)
+{
+  m_retryFn = retryFn;
+}
+
+void
+RequestTracker::SetCompletionCallback (CompletionCallback completionFn)
+{
+  m_completionFn = completionFn;
+}
+
+bool
+RequestTracker::Track (uint32_t transactionId, Ipv4Address destinationAddress, std::string message,
+                       uint8_t retries, uint32_t context)
+{
+  return Track (transactionId, destinationAddress, message, retries, context, m_completionFn);
+}
+
+bool
+RequestTracker::Track (uint32_t transactionId, Ipv4Address destinationAddress, std::string message,
+                       uint8_t retries, uint32_t context, CompletionCallback completionFn)
+{
+  if (IndexFind (transactionId) != INDEX_EMPTY)
+    {
+      return false;
+    }
+  uint32_t slot = AllocateSlot ();
+  Request &request = m_slots[slot].request;
+  request.transactionId = transactionId;
+  request.timestamp = Simulator::Now ();
+  request.lastSent = request.timestamp;
+  request.deadline = request.timestamp + m_timeout;
+  request.destinationAddress = destinationAddress;
+  request.destinationPort = 0;
+  request.message = message;
+  request.context = context;
+  request.retriesLeft = retries;
+  request.attempts = 1;
+  m_slots[slot].completionFn = completionFn;
+
+  IndexInsert (transactionId, slot);
+  PushDeadline (slot);
+  ArmTimer ();
+  return true;
+}
+
+bool
+RequestTracker::SetDestinationPort (uint32_t transactionId, uint16_t port)
+{
+  uint32_t slot = IndexFind (transactionId);
+  if (slot == INDEX_EMPTY)
+    {
+      return false;
+    }
+  m_slots[slot].request.destinationPort = port;
+  return true;
+}
+
+bool
+RequestTracker::MarkSent (uint32_t transactionId)
+{
+  uint32_t slot = IndexFind (transactionId);
+  if (slot == INDEX_EMPTY)
+    {
+      return false;
+    }
+  m_slots[slot].request.lastSent = Simulator::Now ();
+  return true;
+}
+
+const RequestTracker::Request*
+RequestTracker::Find (uint32_t transactionId) const
+{
+  uint32_t slot = IndexFind (transactionId);
+  if (slot == INDEX_EMPTY)
+    {
+      return 0;
+    }
+  return &m_slots[slot].request;
+}
+
+bool
+RequestTracker::Complete (uint32_t transactionId)
+{
+  uint32_t slot = IndexFind (transactionId);
+  if (slot == INDEX_EMPTY)
+    {
+      return false;
+    }
+  // Release first so the callback may track new requests
+  Request request = m_slots[slot].request;
+  CompletionCallback completionFn = m_slots[slot].completionFn;
+  IndexErase (transactionId);
+  ReleaseSlot (slot);
+  if (!completionFn.IsNull ())
+    {
+      completionFn (request, true);
+    }
+  return true;
+}
+
+bool
+RequestTracker::Cancel (uint32_t transactionId)
+{
+  uint32_t slot = IndexFind (transactionId);
+  if (slot == INDEX_EMPTY)
+    {
+      return false;
+    }
+  IndexErase (transactionId);
+  ReleaseSlot (slot);
+  return true;
+}
+
+void
+RequestTracker::Clear ()
+{
+  m_expiryTimer.Cancel ();
+  m_slots.clear ();
+  m_freeSlots.clear ();
+  m_heap.clear ();
+  m_indexKeys.assign (INDEX_INITIAL_SIZE, 0);
+  m_indexSlots.assign (INDEX_INITIAL_SIZE, INDEX_EMPTY);
+  m_indexMask = INDEX_INITIAL_SIZE - 1;
+  m_size = 0;
+}
+
+uint32_t
+RequestTracker::GetSize () const
+{
+  return m_size;
+}
+
+uint32_t
+RequestTracker::AllocateSlot ()
+{
+  uint32_t slot;
+  if (!m_freeSlots.empty ())
+    {
+      slot = m_freeSlots.back ();
+      m_freeSlots.pop_back ();
+    }
+  else
+    {
+      slot = m_slots.size ();
+      m_slots.push_back (Slot ());
+      m_slots[slot].generation = 0;
+    }
+  m_slots[slot].inUse = true;
+  m_size++;
+  return slot;
+}
+
+void
+RequestTracker::ReleaseSlot (uint32_t slot)
+{
+  // Bumping the generation invalidates any deadline still in the heap
+  m_slots[slot].inUse = false;
+  m_slots[slot].generation++;
+  m_slots[slot].completionFn = CompletionCallback ();
+  m_slots[slot].request.message.clear ();
+  m_freeSlots.push_back (slot);
+  m_size--;
+}
+
+void
+RequestTracker::PushDeadline (uint32_t slot)
+{
+  Deadline entry;
+  entry.deadline = m_slots[slot].request.deadline;
+  entry.slot = slot;
+  entry.generation = m_slots[slot].generation;
+  m_heap.push_back (entry);
+  std::push_heap (m_heap.begin (), m_heap.end ());
+  if (m_heap.size () > 2 * m_size + INDEX_INITIAL_SIZE)
+    {
+      CompactHeap ();
+    }
+}
+
+void
+RequestTracker::CompactHeap ()
+{
+  std::vector<Deadline> live;
+  live.reserve (m_size);
+  for (std::vector<Deadline>::const_iterator iter = m_heap.begin (); iter != m_heap.end (); iter++)
+    {
+      const Slot &slot = m_slots[iter->slot];
+      if (slot.inUse && slot.generation == iter->generation)
+        {
+          live.push_back (*iter);
+        }
+    }
+  std::make_heap (live.begin (), live.end ());
+  m_heap.swap (live);
+}
+
+void
+RequestTracker::ArmTimer ()
+{
+  // Drop deadlines of requests that have already completed
+  while (!m_heap.empty ())
+    {
+      const Deadline &top = m_heap.front ();
+      if (m_slots[top.slot].inUse && m_slots[top.slot].generation == top.generation)
+        {
+          break;
+        }
+      std::pop_heap (m_heap.begin (), m_heap.end ());
+      m_heap.pop_back ();
+    }
+  if (m_heap.empty ())
+    {
+      m_expiryTimer.Cancel ();
+      return;
+    }
+  Time next = m_heap.front ().deadline;
+  if (m_expiryTimer.IsRunning () && m_armedDeadline <= next)
+    {
+      return;
+    }
+  m_expiryTimer.Cancel ();
+  Time now = Simulator::Now ();
+  m_armedDeadline = next;
+  m_expiryTimer.Schedule (next > now ? next - now : Time ());
+}
+
+void
+RequestTracker::Expire ()
+{
+  Time now = Simulator::Now ();
+  while (!m_heap.empty () && m_heap.front ().deadline <= now)
+    {
+      Deadline top = m_heap.front ();
+      std::pop_heap (m_heap.begin (), m_heap.end ());
+      m_heap.pop_back ();
+      if (!m_slots[top.slot].inUse || m_slots[top.slot].generation != top.generation)
+        {
+          continue;
+        }
+      Request &request = m_slots[top.slot].request;
+      if (request.retriesLeft > 0 && !m_retryFn.IsNull ())
+        {
+          request.retriesLeft--;
+          request.attempts++;
+          request.lastSent = now;
+          request.deadline = now + m_timeout;
+          Request retry = request;
+          PushDeadline (top.slot);
+          m_retryFn (retry);
+        }
+      else
+        {
+          Request expired = request;
+          CompletionCallback completionFn = m_slots[top.slot].completionFn;
+          IndexErase (expired.transactionId);
+          ReleaseSlot (top.slot);
+          if (!completionFn.IsNull ())
+            {
+              completionFn (expired, false);
+            }
+        }
+    }
+  ArmTimer ();
+}
+
+uint32_t
+RequestTracker::IndexFind (uint32_t transactionId) const
+{
+  uint32_t pos = HashTransactionId (transactionId) & m_indexMask;
+  while (m_indexSlots[pos] != INDEX_EMPTY)
+    {
+      if (m_indexKeys[pos] == transactionId)
+        {
+          return m_indexSlots[pos];
+        }
+      pos = (pos + 1) & m_indexMask;
+    }
+  return INDEX_EMPTY;
+}
+
+void
+RequestTracker::IndexInsert (uint32_t transactionId, uint32_t slot)
+{
+  // Keep the load factor at or below one half
+  if (2 * (m_size + 1) > m_indexMask + 1)
+    {
+      IndexGrow ();
+    }
+  uint32_t pos = HashTransactionId (transactionId) & m_indexMask;
+  while (m_indexSlots[pos] != INDEX_EMPTY)
+    {
+      pos = (pos + 1) & m_indexMask;
+    }
+  m_indexKeys[pos] = transactionId;
+  m_indexSlots[pos] = slot;
+}
+
+void
+RequestTracker::IndexErase (uint32_t transactionId)
+{
+  uint32_t pos = HashTransactionId (transactionId) & m_indexMask;
+  while (m_indexSlots[pos] != INDEX_EMPTY && m_indexKeys[pos] != transactionId)
+    {
+      pos = (pos + 1) & m_indexMask;
+    }
+  if (m_indexSlots[pos] == INDEX_EMPTY)
+    {
+      return;
+    }
+  // Backward-shift deletion keeps probe chains intact without tombstones
+  uint32_t hole = pos;
+  uint32_t next = pos;
+  while (true)
+    {
+      next = (next + 1) & m_indexMask;
+      if (m_indexSlots[next] == INDEX_EMPTY)
+        {
+          break;
+        }
+      uint32_t home = HashTransactionId (m_indexKeys[next]) & m_indexMask;
+      // Move the entry back unless its home lies cyclically in (hole, next]
+      bool inRange = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+      if (!inRange)
+        {
+          m_indexKeys[hole] = m_indexKeys[next];
+          m_indexSlots[hole] = m_indexSlots[next];
+          hole = next;
+        }
+    }
+  m_indexSlots[hole] = INDEX_EMPTY;
+}
+
+void
+RequestTracker::IndexGrow ()
+{
+  std::vector<uint32_t> oldKeys;
+  std::vector<uint32_t> oldSlots;
+  oldKeys.swap (m_indexKeys);
+  oldSlots.swap (m_indexSlots);
+  uint32_t capacity = (m_indexMask + 1) * 2;
+  m_indexKeys.assign (capacity, 0);
+  m_indexSlots.assign (capacity, INDEX_EMPTY);
+  m_indexMask = capacity - 1;
+  for (uint32_t i = 0; i < oldSlots.size (); i++)
+    {
+      if (oldSlots[i] == INDEX_EMPTY)
+        {
+          continue;
+        }
+      uint32_t pos = HashTransactionId (oldKeys[i]) & m_indexMask;
+      while (m_indexSlots[pos] != INDEX_EMPTY)
+        {
+          pos = (pos + 1) & m_indexMask;
+        }
+      m_indexKeys[pos] = oldKeys[i];
+      m_indexSlots[pos] = oldSlots[i];
+    }
+}
@@ -0,0 +1,184 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef REQUEST_TRACKER_H
+#define REQUEST_TRACKER_H
+
+#include "ns3/ipv4-address.h"
+#include "ns3/nstime.h"
+#include "ns3/timer.h"
+#include "ns3/callback.h"
+
+#include <vector>
+#include <string>
+
+using namespace ns3;
+
+/**
+ * \brief Tracks outstanding requests (pings, lookups, ...) by transaction id.
+ *
+ * Request records live in a pooled slab that is reused as requests complete,
+ * and are found in O(1) through an open-addressing index on the transaction
+ * id. Expiry is driven by a min-heap of deadlines with a single timer armed
+ * for the earliest one, so outstanding requests are never scanned
+ * periodically.
+ */
+class RequestTracker
+{
+  public:
+    struct Request
+      {
+        uint32_t transactionId;
+        // Time of the first transmission
+        Time timestamp;
+        // Time of the most recent (re)transmission
+        Time lastSent;
+        Time deadline;
+        Ipv4Address destinationAddress;
+        // 0 unless set through SetDestinationPort ()
+        uint16_t destinationPort;
+        std::string message;
+        // Caller defined tag (request kind, finger index, ...)
+        uint32_t context;
+        uint8_t retriesLeft;
+        uint8_t attempts;
+      };
+
+    /**
+     * \brief Invoked once per request, with true on Complete () and false
+     * when the request expired after its last retry.
+     */
+    typedef Callback <void, const Request &, bool> CompletionCallback;
+    /**
+     * \brief Invoked on each timeout that still has retries left; the
+     * request has already been re-armed and should be resent.
+     */
+    typedef Callback <void, const Request &> RetryCallback;
+
+    RequestTracker ();
+    ~RequestTracker ();
+
+    void SetTimeout (Time timeout);
+    Time GetTimeout () const;
+    void SetRetryCallback (RetryCallback retryFn);
+    /**
+     * \brief Sets the callback used for requests tracked without their own.
+     */
+    void SetCompletionCallback (CompletionCallback completionFn);
+
+    /**
+     * \brief Starts tracking a request sent now.
+     *
+     * \param transactionId Transaction id of the request.
+     * \param destinationAddress Destination the request was sent to.
+     * \param message Payload string reported back on completion.
+     * \param retries Number of retransmissions before the request expires.
+     * \param context Caller defined tag returned with the request.
+     * \returns false if the transaction id is already being tracked.
+     */
+    bool Track (uint32_t transactionId, Ipv4Address destinationAddress, std::string message,
+                uint8_t retries = 0, uint32_t context = 0);
+    bool Track (uint32_t transactionId, Ipv4Address destinationAddress, std::string message,
+                uint8_t retries, uint32_t context, CompletionCallback completionFn);
+
+    /**
+     * \brief Records the port the request went to, for callers that talk to
+     * several endpoints on one address.
+     * \returns false if the transaction id is unknown.
+     */
+    bool SetDestinationPort (uint32_t transactionId, uint16_t port);
+
+    /**
+     * \brief Records that a request tracked earlier left only now, for
+     * callers that hold requests back before sending them. The deadline is
+     * left as is.
+     * \returns false if the transaction id is unknown.
+     */
+    bool MarkSent (uint32_t transactionId);
+
+    /**
+     * \returns the tracked request or 0. The pointer stays valid until the
+     * next call to Track ().
+     */
+    const Request* Find (uint32_t transactionId) const;
+
+    /**
+     * \brief Completes a request successfully and releases its record.
+     * \returns false if the transaction id is unknown.
+     */
+    bool Complete (uint32_t transactionId);
+
+    /**
+     * \brief Releases a request without invoking any callback.
+     */
+    bool Cancel (uint32_t transactionId);
+
+    /**
+     * \brief Releases all requests and stops the expiry timer.
+     */
+    void Clear ();
+
+    uint32_t GetSize () const;
+
+  private:
+    struct Slot
+      {
+        Request request;
+        CompletionCallback completionFn;
+        uint32_t generation;
+        bool inUse;
+      };
+
+    struct Deadline
+      {
+        Time deadline;
+        uint32_t slot;
+        uint32_t generation;
+        // Min-heap ordering for std::push_heap / std::pop_heap
+        bool operator< (const Deadline &other) const
+          {
+            return deadline > other.deadline;
+          }
+      };
+
+    uint32_t AllocateSlot ();
+    void ReleaseSlot (uint32_t slot);
+    void PushDeadline (uint32_t slot);
+    void ArmTimer ();
+    void CompactHeap ();
+    void Expire ();
+
+    // Open-addressing index from transaction id to slot
+    uint32_t IndexFind (uint32_t transactionId) const;
+    void IndexInsert (uint32_t transactionId, uint32_t slot);
+    void IndexErase (uint32_t transactionId);
+    void IndexGrow ();
+
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_freeSlots;
+    std::vector<Deadline> m_heap;
+    std::vector<uint32_t> m_indexKeys;
+    std::vector<uint32_t> m_indexSlots;
+    uint32_t m_indexMask;
+    uint32_t m_size;
+    Time m_timeout;
+    Time m_armedDeadline;
+    Timer m_expiryTimer;
+    RetryCallback m_retryFn;
+    CompletionCallback m_completionFn;
+};
+
+#endif
@@ -35,10 +35,11 @@ nTableEntry::nTableEntry(Ipv4Address nAdd, Ipv4Address iAdd, uint32_t nNum, Time
   NeighborAddress = nAdd;
   InterfaceAddress = iAdd;
   tStamp = time;
+  metric = 1;
 }
 
 nTableEntry::nTableEntry()
-{ }
+{ metric = 1; }
 
 
 rTableEntry::rTableEntry()
@@ -89,3 +90,147 @@ routeTable::at(int pos) const
   return table.at(pos);
 }
 
+void routeTable::clear ()
+{
+  table.clear();
+  size = 0;
+}
+
+bool neighborTable::nTableUpdate (nTableEntry entry)
+{
+  for(int i = 0; i < size; i++){
+	if(table.at(i).NeighborAddress == entry.NeighborAddress && table.at(i).InterfaceAddress == entry.InterfaceAddress) {
+		table.at(i).tStamp = entry.tStamp;
+		return false;
+	}
+  }
+  nTableInsert(entry);
+  return true;
+}
+
+nTableEntry*
+neighborTable::find (Ipv4Address neighborAddress, Ipv4Address interfaceAddress)
+{
+  for(int i = 0; i < size; i++){
+	if(table.at(i).NeighborAddress == neighborAddress && table.at(i).InterfaceAddress == interfaceAddress)
+		return &table.at(i);
+  }
+  return 0;
+}
+
+std::vector<nTableEntry>
+neighborTable::purge (Time cutoff)
+{
+  std::vector<nTableEntry> expired;
+  std::vector<nTableEntry> live;
+  for(int i = 0; i < size; i++){
+	if(table.at(i).tStamp <= cutoff)
+		expired.push_back(table.at(i));
+	else
+		live.push_back(table.at(i));
+  }
+  table.swap(live);
+  size = table.size();
+  return expired;
+}
+
+bool sequenceNumberNewer (uint32_t a, uint32_t b)
+{
+  // a is newer if it lies less than half the sequence space ahead of b
+  return a != b && (int32_t)(a - b) > 0;
+}
+
+lsdbEntry::lsdbEntry()
+{
+  originatorNumber = 0;
+  sequenceNumber = 0;
+}
+
+bool lsdbEntry::hasNeighbor (uint32_t nodeNumber) const
+{
+  for(size_t i = 0; i < links.size(); i++){
+	if(links[i].nodeNumber == nodeNumber)
+		return true;
+  }
+  return false;
+}
+
+lsdbLink::lsdbLink()
+{
+  nodeNumber = 0;
+  metric = 1;
+}
+
+lsdbLink::lsdbLink(uint32_t nNum, uint16_t cost)
+{
+  nodeNumber = nNum;
+  metric = cost;
+}
+
+bool lsdbLink::operator< (const lsdbLink &other) const
+{
+  return nodeNumber < other.nodeNumber;
+}
+
+linkStateDatabase::linkStateDatabase()
+{ size = 0; }
+
+bool linkStateDatabase::isNewer (uint32_t originatorNumber, uint32_t sequenceNumber) const
+{
+  std::map<uint32_t, lsdbEntry>::const_iterator iter = table.find(originatorNumber);
+  if(iter == table.end())
+	return true;
+  return sequenceNumberNewer(sequenceNumber, iter->second.sequenceNumber);
+}
+
+bool linkStateDatabase::lsdbUpdate (lsdbEntry entry)
+{
+  if(!isNewer(entry.originatorNumber, entry.sequenceNumber))
+	return false;
+  table[entry.originatorNumber] = entry;
+  size = table.size();
+  return true;
+}
+
+const lsdbEntry*
+linkStateDatabase::find (uint32_t originatorNumber) const
+{
+  std::map<uint32_t, lsdbEntry>::const_iterator iter = table.find(originatorNumber);
+  if(iter == table.end())
+	return 0;
+  return &iter->second;
+}
+
+std::vector<lsdbEntry>
+linkStateDatabase::purge (Time cutoff)
+{
+  std::vector<lsdbEntry> expired;
+  for(std::map<uint32_t, lsdbEntry>::iterator iter = table.begin(); iter != table.end();){
+	if(iter->second.installed <= cutoff){
+		expired.push_back(iter->second);
+		table.erase(iter++);
+	}
+	else
+		++iter;
+  }
+  size = table.size();
+  return expired;
+}
+
+linkStateDatabase::const_iterator
+linkStateDatabase::begin () const
+{
+  return table.begin();
+}
+
+linkStateDatabase::const_iterator
+linkStateDatabase::end () const
+{
+  return table.end();
+}
+
+linkStateDatabase::const_iterator
+linkStateDatabase::lower_bound (uint32_t originatorNumber) const
+{
+  return table.lower_bound(originatorNumber);
+}
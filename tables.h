@@ -4,6 +4,7 @@
 #include "ns3/ipv4.h"
 #include <ns3/nstime.h>
 #include <vector>
+#include <map>
 
 using namespace ns3;
 
@@ -13,6 +14,10 @@ struct nTableEntry
    Ipv4Address NeighborAddress;
    Ipv4Address InterfaceAddress;
    Time tStamp;
+   // Smoothed ND round-trip time (zero until measured)
+   Time rtt;
+   // Metric of this link as advertised in our LSP
+   uint16_t metric;
    nTableEntry();
    nTableEntry(Ipv4Address, Ipv4Address, uint32_t, Time);
 //   ~nTableEntry();
@@ -31,11 +36,38 @@ struct rTableEntry
    rTableEntry(uint32_t, Ipv4Address, Ipv4Address);
 };
 
+struct lsdbLink
+{
+   uint32_t nodeNumber;
+   uint16_t metric;
+   lsdbLink();
+   lsdbLink(uint32_t, uint16_t);
+   bool operator< (const lsdbLink &) const;
+};
+
+struct lsdbEntry
+{
+   uint32_t originatorNumber;
+   Ipv4Address originatorAddress;
+   uint32_t sequenceNumber;
+   Time installed;
+   std::vector<lsdbLink> links;
+   lsdbEntry();
+   bool hasNeighbor(uint32_t) const;
+};
+
+/*
+ * Serial number arithmetic (RFC 1982) for 32-bit LSP sequence numbers:
+ * true if a was issued after b, also across wraparound.
+ */
+bool sequenceNumberNewer(uint32_t a, uint32_t b);
+
 class routeTable
 {
    public:
      void rTableInsert (rTableEntry entry);
      bool isNew(rTableEntry);
+     void clear();
      routeTable();
      int size;
      rTableEntry at(int) const;
@@ -47,6 +79,9 @@ class neighborTable
 {
   public:
    void nTableInsert (nTableEntry entry);
+   bool nTableUpdate (nTableEntry entry);
+   nTableEntry* find (Ipv4Address neighborAddress, Ipv4Address interfaceAddress);
+   std::vector<nTableEntry> purge (Time cutoff);
 //   void checkNeighborTableEntry();
    neighborTable();
 //   ~neighborTable();
@@ -58,4 +93,28 @@ class neighborTable
   
 };
 
+/*
+ * Link state database: the latest LSP of every originator, keyed by node
+ * number. Entries are aged lazily; purge() drops the ones installed before
+ * the cutoff and is called whenever the database is about to be used.
+ */
+class linkStateDatabase
+{
+  public:
+   typedef std::map<uint32_t, lsdbEntry>::const_iterator const_iterator;
+   linkStateDatabase();
+   bool isNewer(uint32_t originatorNumber, uint32_t sequenceNumber) const;
+   bool lsdbUpdate(lsdbEntry entry);
+   const lsdbEntry* find(uint32_t originatorNumber) const;
+   std::vector<lsdbEntry> purge(Time cutoff);
+   const_iterator begin() const;
+   const_iterator end() const;
+   // First entry whose originator is not below originatorNumber
+   const_iterator lower_bound(uint32_t originatorNumber) const;
+   int size;
+
+  private:
+   std::map<uint32_t, lsdbEntry> table;
+};
+
 #endif